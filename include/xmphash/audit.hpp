@@ -0,0 +1,53 @@
+#ifndef MJI_AUDIT_HPP_INCLUDED_
+#define MJI_AUDIT_HPP_INCLUDED_
+
+#include <cstdint>
+
+/*******************************************************************************
+Statistical audit:
+Rather than rehashing everything, an audit verifies a random sample of the
+blocks recorded by the <algo>@<bs> fields of a manifest. Whether a block is in
+the sample depends only on the seed, the path, the block size and the block
+index, so a run can be reproduced exactly by passing the same seed (the
+selection is not drawn from a sequential RNG, which would depend on the order
+and content of the manifest).
+*******************************************************************************/
+
+namespace mji::xmph {
+
+struct AuditOptions {
+    /// Fraction of blocks to verify, in (0, 1]
+    double fraction = 0.01;
+    std::uint64_t seed = 0;
+    char terminator = '\n';
+};
+
+struct AuditReport {
+    std::uint64_t files = 0;
+    std::uint64_t totalBlocks = 0;
+    std::uint64_t sampledBlocks = 0;
+    std::uint64_t sampledBytes = 0;
+    std::uint64_t failedBlocks = 0;
+    /// Files which could not be opened or whose size changed
+    std::uint64_t failedFiles = 0;
+};
+
+/// Verifies the sampled blocks of every file in the manifest, printing each
+/// failure to stdout as it is found. Returns false if the manifest itself
+/// could not be read.
+bool runAudit(const char* manifestPath, const AuditOptions& options, AuditReport& report);
+
+/// Prints the totals and the confidence statement for a finished audit
+void printAuditReport(const AuditReport& report, const AuditOptions& options);
+
+/// Given that all of sampledBlocks blocks verified, returns the fraction of
+/// corrupt blocks that can be ruled out at the given confidence level
+double auditCorruptionBound(std::uint64_t sampledBlocks, double confidence);
+
+/// Returns whether the block is part of the sample
+bool auditSelectsBlock(std::uint64_t pathKey, std::uint64_t blockSize,
+    std::uint64_t blockIndex, const AuditOptions& options);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_AUDIT_HPP_INCLUDED_
@@ -0,0 +1,42 @@
+#ifndef MJI_BENCHMARK_HPP_INCLUDED_
+#define MJI_BENCHMARK_HPP_INCLUDED_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mji::xmph {
+
+struct BenchmarkOptions {
+    /// Timed passes over each file per path; the fastest is kept
+    unsigned int rounds = 3;
+};
+
+/// Throughput of the hashing paths on one file. The file is read once
+/// before timing, so both paths hash from the page cache and the figures
+/// compare the hashing rather than the disk.
+struct BenchmarkResult {
+    std::string path;
+    std::uint64_t size = 0;
+    /// Through fread() and the OpenSSL (EVP) hashers
+    double streamSeconds = 0.0;
+    /// Through the kernel crypto API; empty if the kernel could not hash it
+    std::optional<double> kernelSeconds;
+    /// Whether the two paths produced the same digests
+    bool digestsMatch = true;
+};
+
+/// Times each path on every file with the given streaming algorithms.
+/// Prints a message and returns false if an algorithm is unknown or a file
+/// cannot be hashed.
+bool runBenchmark(const std::vector<std::string>& algoNames,
+    const std::vector<std::string>& paths, const BenchmarkOptions& options,
+    std::vector<BenchmarkResult>& results);
+
+/// Prints a table of the results, in MiB/s, to stdout
+void printBenchmarkReport(const std::vector<BenchmarkResult>& results);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_BENCHMARK_HPP_INCLUDED_
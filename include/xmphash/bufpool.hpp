@@ -0,0 +1,56 @@
+#ifndef MJI_BUFPOOL_HPP_INCLUDED_
+#define MJI_BUFPOOL_HPP_INCLUDED_
+
+#include <cstddef>
+
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+Read buffer pool:
+Buffers are the size of one huge page and aligned to it, so each needs a
+single TLB entry where huge pages are available, and any part of one at a
+block-aligned offset is suitable for direct I/O. Allocating them means a
+system call, so released buffers are kept on a free list owned by the thread
+that released them and handed back out to that thread. Since every worker
+acquires and releases its own buffers, the lists need no locking. Each list
+keeps a few buffers; the rest are returned to the system, as is the whole
+list when its thread exits.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+constexpr std::size_t pool_buffer_size = mji::xplat::large_page_size;
+
+/// A pool buffer of pool_buffer_size bytes, returned to the pool when
+/// destroyed
+class PooledBuffer final {
+public:
+    /// An empty buffer
+    PooledBuffer();
+    ~PooledBuffer();
+
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+    PooledBuffer(PooledBuffer&& other);
+    PooledBuffer& operator=(PooledBuffer&& other);
+
+    /// Takes a buffer from the calling thread's free list, or allocates one.
+    /// Returns an empty buffer if that fails, so that a worker can fail the
+    /// file rather than the process.
+    static PooledBuffer acquire();
+
+    /// Null for an empty buffer
+    unsigned char* data() const;
+    /// Returns the buffer to the calling thread's free list, leaving this
+    /// empty
+    void release();
+
+private:
+    unsigned char* data_;
+
+    explicit PooledBuffer(unsigned char* data);
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_BUFPOOL_HPP_INCLUDED_
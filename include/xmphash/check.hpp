@@ -0,0 +1,60 @@
+#ifndef MJI_CHECK_HPP_INCLUDED_
+#define MJI_CHECK_HPP_INCLUDED_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <xmphash/fingerprint.hpp>
+#include <xmphash/membudget.hpp>
+#include <xmphash/pathfilter.hpp>
+#include <xmphash/prefetch.hpp>
+
+namespace mji::xmph {
+
+struct CheckOptions {
+    char terminator = '\n';
+    bool binaryMode = true;
+    unsigned int jobs = 1;
+    FingerprintParams fingerprintParams;
+    /// Passed on to the HashEngine
+    MemoryBudget* memoryBudget = nullptr;
+    PrefetchOptions prefetch;
+    bool cacheFirst = false;
+    /// Left off by the command line: verifying content must read it, not
+    /// infer a digest from the extent layout of a reflink copy
+    bool reuseSharedExtents = false;
+    /// If set, applied when walking roots: files it does not keep are
+    /// neither checked nor reported as missing
+    const PathFilter* filter = nullptr;
+};
+
+struct CheckReport {
+    std::uint64_t ok = 0;
+    std::uint64_t failed = 0;
+    /// Listed in the manifest but not found under the roots
+    std::uint64_t missing = 0;
+    /// Found under the roots but not listed in the manifest
+    std::uint64_t unlisted = 0;
+    /// Files which could not be read
+    std::uint64_t errors = 0;
+};
+
+/// Rehashes files and compares them with the records of a manifest, printing
+/// "path: OK" or "path: FAILED" for each. Every digest field of a record that
+/// can be recomputed is compared, along with the size.
+///
+/// With no roots the files are checked in manifest order. Otherwise the roots
+/// are walked and each file found is looked up in a perfect hash index of the
+/// manifest paths; files not in the manifest are reported as "NOT LISTED" and
+/// records never reached as "MISSING". Returns false if the manifest could
+/// not be loaded or the memory budget cannot hold a single worker.
+///
+/// Records of directory digests from computeDirHash are checked by hashing
+/// the directories they name again, whether or not roots are given.
+bool runCheck(const char* manifestPath, const std::vector<std::string>& roots,
+    const CheckOptions& options, CheckReport& report);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_CHECK_HPP_INCLUDED_
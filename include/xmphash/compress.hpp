@@ -0,0 +1,124 @@
+#ifndef MJI_COMPRESS_HPP_INCLUDED_
+#define MJI_COMPRESS_HPP_INCLUDED_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <xmphash/manifest.hpp>
+
+/*******************************************************************************
+Compressed manifests:
+With --compress a manifest is written as a sequence of independent zstd
+frames, each holding whole records (about compressed_frame_size bytes of
+them). The frames are compressed and written on a thread of their own, so
+the workers and the sink never wait on the compressor unless it falls more
+than max_queued_frames behind. The result is an ordinary zstd file that
+zstd -d (or zstdcat) reads.
+
+Every reader recognizes the zstd magic number and decompresses as it goes.
+Check mode goes further: since each frame decodes on its own, it maps the
+manifest and decompresses and parses a batch of frames on several threads
+at once. Frames from other tools need not end on a record boundary, so
+records split between frames are stitched back together before they are
+parsed. A file holding a single frame (what zstd itself writes) gains
+nothing from this, but is read correctly.
+
+zstd support is compiled in only when the library is found at build time
+(XMPHASH_WITH_ZSTD); otherwise compressed manifests are reported as such
+and refused.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+constexpr int default_compression_level = 3;
+/// Uncompressed bytes of records per frame
+constexpr std::size_t compressed_frame_size = 4 << 20;
+
+/// Whether this build can read and write compressed manifests
+bool compressionSupported();
+
+/// Whether the data begins with a zstd frame
+bool isCompressed(const void* data, std::size_t size);
+/// Whether the file at path begins with a zstd frame; false if it cannot
+/// be read
+bool isCompressedFile(const char* path);
+
+/// Compresses chunks of a stream into independent frames on a background
+/// thread, writing them to out in the order they were given
+class FrameCompressor final {
+public:
+    /// The stream is not owned
+    FrameCompressor(std::FILE* out, int level);
+    ~FrameCompressor();
+
+    FrameCompressor(const FrameCompressor&) = delete;
+    FrameCompressor& operator=(const FrameCompressor&) = delete;
+
+    /// Queues the content of one frame, blocking while the compressor is
+    /// max_queued_frames behind. Returns false once a frame has failed.
+    bool write(std::string content);
+    /// Waits for every queued frame to be written. Returns false if any
+    /// could not be compressed or written.
+    bool finish();
+
+private:
+    static constexpr std::size_t max_queued_frames = 2;
+
+    std::FILE* out_;
+    int level_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::string> queue_;
+    bool finishing_;
+    bool failed_;
+    std::thread thread_;
+
+    void run();
+};
+
+/// Decompresses a zstd stream from a file as it is read
+class StreamDecompressor final {
+public:
+    StreamDecompressor();
+    ~StreamDecompressor();
+
+    StreamDecompressor(const StreamDecompressor&) = delete;
+    StreamDecompressor& operator=(const StreamDecompressor&) = delete;
+
+    /// Input already read from the stream, to be decompressed first
+    void prime(const char* data, std::size_t size);
+    /// Decompresses up to size bytes into buf. Returns the bytes produced,
+    /// 0 at the end of the stream, or -1 on a read error or corrupt input.
+    std::int64_t read(std::FILE* fp, char* buf, std::size_t size);
+
+private:
+    struct Context;
+
+    std::unique_ptr<Context> context_;
+    std::vector<char> in_;
+    std::size_t inPos_;
+    bool inputEnded_;
+};
+
+/// Decompresses a whole compressed manifest held in memory. Prints a
+/// message and returns false if it is corrupt.
+bool decompressManifest(const char* data, std::size_t size, std::string& out);
+
+/// Reads every record of a compressed manifest into entries, decompressing
+/// and parsing batches of frames on up to `jobs` threads. On a malformed
+/// record, sets badRecord to its 1-based number and returns false; on any
+/// other failure prints a message, leaves badRecord 0 and returns false.
+bool readCompressedManifest(const char* path, char terminator, unsigned int jobs,
+    std::vector<ManifestEntry>& entries, std::uint64_t& badRecord);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_COMPRESS_HPP_INCLUDED_
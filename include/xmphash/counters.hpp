@@ -0,0 +1,60 @@
+#ifndef MJI_COUNTERS_HPP_INCLUDED_
+#define MJI_COUNTERS_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+Hardware counters:
+With --counters each thread that hashes opens a group of hardware counters
+for itself (cycles, instructions, cache misses and branch misses; see
+xplat::PerfCounters) the first time it consumes data. Every consume call of
+a streaming or block hasher is bracketed by two reads of the group, and the
+difference is charged to the hasher's algorithm along with the bytes
+consumed, so the report at exit gives cycles and instructions per byte and
+misses per KiB for each algorithm, measured on the real inputs of the run.
+Only user space is counted: the kernel's share (reads, page faults) is not
+the hasher's.
+
+Each read is a system call, so counting costs a few microseconds per
+consume call; with the usual read sizes that is well under 1% of the run.
+Where perf events are not permitted (perf_event_paranoid above 2, a
+seccomp filter in a container, no PMU in a VM) the first thread to try
+says so once and the run continues uncounted. Counts come from threads
+only while they are on a processor, and are scaled up if the kernel had to
+multiplex the counters.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+/// Turns counting on. Call before starting work.
+void setCounterTracking(bool enabled);
+bool counterTracking();
+
+/// Charges the counts of its lifetime on the calling thread, and the bytes,
+/// to an algorithm
+class CountedSection final {
+public:
+    CountedSection(const char* algoName, std::size_t bytes);
+    ~CountedSection();
+
+    CountedSection(const CountedSection&) = delete;
+    CountedSection& operator=(const CountedSection&) = delete;
+
+private:
+    const char* algoName_;
+    std::size_t bytes_;
+    bool active_;
+    std::uint64_t start_[mji::xplat::perf_event_count];
+};
+
+/// Prints the derived metrics for each algorithm, or why nothing was
+/// counted. Call once work is done.
+void printCounterReport(std::FILE* out);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_COUNTERS_HPP_INCLUDED_
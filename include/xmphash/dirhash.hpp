@@ -0,0 +1,70 @@
+#ifndef MJI_DIRHASH_HPP_INCLUDED_
+#define MJI_DIRHASH_HPP_INCLUDED_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <xmphash/engine.hpp>
+#include <xmphash/pathfilter.hpp>
+
+/*******************************************************************************
+Directory digests:
+The digest of a directory is a Merkle hash of everything beneath it. Each
+entry of a directory (regular file, subdirectory or symbolic link) is encoded
+as one line
+
+    <type> <mode> <name length>:<name> <payload length>:<payload>\n
+
+where type is 'f', 'd' or 'l', mode is the permission bits as four octal
+digits (0000 for symbolic links, whose mode is not portable), lengths are
+decimal byte counts, and the payload is the hex digest of the file's content,
+the hex digest of the subdirectory, or the link target. The lines are sorted
+bytewise by name and hashed with the same algorithm, and that digest is the
+directory's. Owners, timestamps and the root's own name and mode are left
+out, so the same tree gives the same digest on any host, and file contents
+are hashed in parallel but combined in a fixed order, so it does not depend
+on the number of jobs. Other kinds of entry (devices, FIFOs, sockets) are
+skipped with a warning.
+
+With a git object ID algorithm ("git-sha1" or "git-sha256") the directory
+digests are git tree IDs instead; see gitobj.hpp.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+/// Prefix of the manifest field holding a directory digest, as in
+/// "dirhash-sha256"
+constexpr std::string_view dirhash_field_prefix = "dirhash-";
+
+struct DirHashOptions {
+    /// A streaming algorithm, used for both file contents and directories,
+    /// or a git object ID algorithm
+    std::string algoName;
+    /// For hashing the files; its algorithms and block size are overridden
+    HashEngineOptions engine;
+    /// If set, entries it does not keep are left out of the digests (a
+    /// symbolic link is kept or not by its path alone)
+    const PathFilter* filter = nullptr;
+};
+
+struct DirDigest {
+    /// Relative to the root, '/'-separated; empty for the root
+    std::string path;
+    std::string digest;
+    /// Regular files and their total size beneath the directory
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+};
+
+/// Computes the digest of root and of every directory beneath it, in
+/// bytewise path order (the root first). Prints a message and returns false
+/// if the algorithm cannot be used, or if any entry cannot be read, since
+/// the digest would then not describe the tree.
+bool computeDirHash(const std::string& root, const DirHashOptions& options,
+    std::vector<DirDigest>& out);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_DIRHASH_HPP_INCLUDED_
@@ -0,0 +1,88 @@
+#ifndef MJI_ENGINE_HPP_INCLUDED_
+#define MJI_ENGINE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <xmphash/fingerprint.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/membudget.hpp>
+#include <xmphash/prefetch.hpp>
+
+namespace mji::xmph {
+
+/// Calls fn(index, worker) for every index in [0, count) from `jobs` threads
+/// (worker is in [0, jobs)). Indices are handed out in increasing order.
+/// With one job everything runs on the calling thread.
+void runParallel(std::size_t count, unsigned int jobs,
+    const std::function<void(std::size_t, unsigned int)>& fn);
+
+struct HashEngineOptions {
+    std::vector<std::string> algoNames;
+    std::uint64_t blockSize = 0;
+    FingerprintParams fingerprintParams;
+    bool binaryMode = true;
+    unsigned int jobs = 1;
+    /// Optional checkpointing of long files (see CheckpointHooks).
+    /// saveCheckpoint is called from the worker threads with the index of the
+    /// file; resumePoint may return null.
+    std::uint64_t checkpointInterval = 0;
+    std::function<void(std::size_t, const StreamCheckpoint&)> saveCheckpoint;
+    std::function<const StreamCheckpoint*(std::size_t)> resumePoint;
+    /// If set, each worker's hasher and every result waiting to be handed
+    /// to the sink is charged to it. Workers are not started if their
+    /// hashers do not fit, and a worker blocks before hashing a file whose
+    /// result would not fit until the results before it have been drained.
+    /// Only the next result to be drained may go over the limit, so that
+    /// one large result cannot deadlock the run.
+    MemoryBudget* memoryBudget = nullptr;
+    /// Reading ahead of the workers; see Prefetcher
+    PrefetchOptions prefetch;
+    /// Probe how much of each file is in the page cache first, and hash the
+    /// mostly cached files on half of the workers (all of them once the
+    /// other files are done) while the rest read the other files from disk.
+    /// Only with more than one job.
+    bool cacheFirst = false;
+    /// Do not hash files whose data is entirely in extents shared with an
+    /// earlier file of the run with the same layout (reflink copies), but
+    /// hand out the earlier file's result for them
+    bool reuseSharedExtents = false;
+};
+
+struct HashResult {
+    bool ok = false;
+    FileDigests digests;
+};
+
+/// Hashes many files on a pool of worker threads, each with its own
+/// FileHasher, and hands the results back in input order.
+class HashEngine final {
+public:
+    /// Throws std::invalid_argument if an algorithm name is not recognized
+    explicit HashEngine(const HashEngineOptions& options);
+
+    /// Hashes every path, calling sink(index, result) on the calling thread
+    /// in index order while the workers continue. If sink returns false, no
+    /// further files are started and run() returns false. Also prints a
+    /// message and returns false, hashing nothing, if not even one worker's
+    /// hasher fits in the memory budget.
+    bool run(const std::vector<std::string>& paths,
+        const std::function<bool(std::size_t, HashResult&)>& sink);
+
+private:
+    HashEngineOptions options_;
+    // used by the first worker, and to validate the options up front
+    FileHasher fileHasher_;
+
+    /// Records the file's latency when tracking it (see latency.hpp)
+    bool hashOne(FileHasher& hasher, const std::string& path, std::size_t idx, FileDigests& out);
+    bool hashOneUntimed(FileHasher& hasher, const std::string& path, std::size_t idx,
+        FileDigests& out);
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_ENGINE_HPP_INCLUDED_
@@ -0,0 +1,45 @@
+#ifndef MJI_FINGERPRINT_HPP_INCLUDED_
+#define MJI_FINGERPRINT_HPP_INCLUDED_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <xmphash/hasher.hpp>
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+Quick fingerprints:
+The algorithm "fp-<algo>" does not read the whole file. It feeds <algo> a
+header (tag, file size, edge size and sample count, as little-endian 64-bit
+integers), then the first and last edgeSize bytes and `samples` evenly spaced
+interior regions of sampleSize bytes, in offset order. Files no longer than the
+regions combined are hashed whole (after the same header). Because the
+parameters are part of the input, fingerprints taken with different settings
+never compare equal. A fingerprint only says two files are probably the same;
+it is meant as a cache key or dedup pre-filter, not as an integrity check.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+constexpr std::string_view fingerprint_prefix = "fp-";
+
+struct FingerprintParams {
+    static constexpr std::uint64_t sampleSize = 4096;
+
+    std::uint64_t edgeSize = 64 * 1024;
+    std::uint64_t samples = 16;
+};
+
+/// Whether the algorithm name denotes a fingerprint
+bool isFingerprintAlgo(std::string_view name);
+
+/// Computes a fingerprint of an open file with the given inner hasher, which
+/// is reset first. Returns an empty optional on a read or hasher failure.
+std::optional<std::string> computeFingerprint(const mji::xplat::InFile& file,
+    std::uint64_t size, Hasher& inner, const FingerprintParams& params);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_FINGERPRINT_HPP_INCLUDED_
@@ -0,0 +1,115 @@
+#ifndef MJI_FUZZY_HPP_INCLUDED_
+#define MJI_FUZZY_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <xmphash/hasher.hpp>
+
+/*******************************************************************************
+Note about similarity digests:
+SsdeepHasher follows the context triggered piecewise hashing algorithm of
+ssdeep/libfuzzy (Kornblum, "Identifying almost identical files using context
+triggered piecewise hashing", 2006) and produces the same digests as
+`ssdeep` for files up to 3*2^30*64 bytes. TlshHasher follows the TLSH
+reference implementation (Oliver et al., "TLSH - A Locality Sensitive Hash",
+2013) with 128 buckets and a 1-byte checksum, and produces the same "T1"
+digests as the reference library. Inputs shorter than 50 bytes, longer than
+4 GiB - 1, or with too little variation give "TNULL", as in TLSH itself.
+Both digests are text, so their digest bytes are a NUL-terminated string.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+class SsdeepHasher final : public Hasher {
+public:
+    static constexpr std::size_t spamsum_length = 64;
+    static constexpr std::size_t num_blockhashes = 31;
+    static constexpr std::size_t max_result = 2 * spamsum_length + 20;
+
+    SsdeepHasher();
+    ~SsdeepHasher() = default;
+
+    SsdeepHasher(const SsdeepHasher& other) = default;
+    SsdeepHasher(SsdeepHasher&& other) = default;
+    SsdeepHasher& operator=(const SsdeepHasher& other) = default;
+    SsdeepHasher& operator=(SsdeepHasher&& other) = default;
+
+private:
+    static constexpr std::size_t rolling_window = 7;
+
+    struct BlockhashContext {
+        unsigned int dindex;
+        char digest[spamsum_length];
+        char halfdigest;
+        unsigned char h;
+        unsigned char halfh;
+    };
+
+    std::uint64_t totalSize_;
+    unsigned int bhStart_;
+    unsigned int bhEnd_;
+    bool needLastHash_;
+    unsigned char lastHash_;
+    BlockhashContext bh_[num_blockhashes];
+
+    // rolling hash state
+    unsigned char window_[rolling_window];
+    std::uint32_t h1_;
+    std::uint32_t h2_;
+    std::uint32_t h3_;
+    std::uint32_t windowIdx_;
+
+    void tryForkBlockhash();
+    void tryReduceBlockhash();
+
+    bool consumeImpl(const void* data, std::size_t count) override;
+    bool finalizeImpl(void* buf) override;
+    bool resetImpl() override;
+    std::size_t getDigestSizeImpl() const override;
+    const char* getNameImpl() const override;
+    std::string formatDigestImpl(const unsigned char* buf) const override;
+};
+
+class TlshHasher final : public Hasher {
+public:
+    /// "T1" + 35 bytes as hex + NUL
+    static constexpr std::size_t max_result = 2 + 70 + 1;
+
+    TlshHasher();
+    ~TlshHasher() = default;
+
+    TlshHasher(const TlshHasher& other) = default;
+    TlshHasher(TlshHasher&& other) = default;
+    TlshHasher& operator=(const TlshHasher& other) = default;
+    TlshHasher& operator=(TlshHasher&& other) = default;
+
+private:
+    static constexpr std::size_t num_buckets = 256;
+    static constexpr std::size_t eff_buckets = 128;
+    static constexpr std::size_t code_size = eff_buckets / 4;
+
+    std::uint32_t buckets_[num_buckets];
+    std::uint64_t dataLen_;
+    unsigned char checksum_;
+    // the four bytes preceding the next one, most recent first
+    unsigned char w1_;
+    unsigned char w2_;
+    unsigned char w3_;
+    unsigned char w4_;
+
+    bool consumeImpl(const void* data, std::size_t count) override;
+    bool finalizeImpl(void* buf) override;
+    bool resetImpl() override;
+    std::size_t getDigestSizeImpl() const override;
+    const char* getNameImpl() const override;
+    std::string formatDigestImpl(const unsigned char* buf) const override;
+};
+
+static_assert(SsdeepHasher::max_result <= hash_max_custom_digest_size);
+static_assert(TlshHasher::max_result <= hash_max_custom_digest_size);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_FUZZY_HPP_INCLUDED_
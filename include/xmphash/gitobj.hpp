@@ -0,0 +1,49 @@
+#ifndef MJI_GITOBJ_HPP_INCLUDED_
+#define MJI_GITOBJ_HPP_INCLUDED_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <xmphash/hasher.hpp>
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+Git object IDs:
+The algorithms "git-sha1" and "git-sha256" give the ID git assigns a file's
+content as a blob in a repository of the sha1 or sha256 object format (what
+`git hash-object` prints): the hash of "blob <size>\0" followed by the
+content. The header needs the size before the content, so, like fs-verity,
+these read the file by position rather than sharing the stream.
+
+With --dirhash they give git tree IDs instead of the canonical encoding:
+each directory is hashed as "tree <size>\0" followed by an entry per child,
+"<mode> <name>\0" and the child's raw ID, in git's order (names compared
+bytewise, as though each subdirectory's ended in '/'). The modes are 100644,
+100755 (owner may execute), 120000 (symbolic link, whose blob is the link
+target) and 40000 (subdirectory). As in git, directories with nothing to
+record are left out of their parents, and ".git" directories are skipped.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+constexpr std::string_view git_algo_prefix = "git-";
+
+/// The hash ("sha1" or "sha256") behind a git object ID algorithm, or an
+/// empty optional if the name is not one
+std::optional<std::string> gitInnerAlgo(std::string_view name);
+
+/// Computes the git blob ID of an open file of the given size with the
+/// given inner hasher, which is reset first. Returns an empty optional on a
+/// read or hasher failure, or if the file is shorter than size.
+std::optional<std::string> computeGitBlobId(const mji::xplat::InFile& file,
+    std::uint64_t size, Hasher& hasher);
+
+/// Hashes an object ("blob", "tree", ...) held in memory
+std::optional<std::string> hashGitObject(std::string_view type, std::string_view content,
+    Hasher& hasher);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_GITOBJ_HPP_INCLUDED_
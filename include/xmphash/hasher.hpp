@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
@@ -22,7 +23,7 @@ Network Graphics (PNG) Specification (Second Edition)
 
 namespace mji::xmph {
 
-constexpr std::size_t hash_max_custom_digest_size = 4;  // CRC32
+constexpr std::size_t hash_max_custom_digest_size = 148;  // ssdeep
 constexpr auto hash_max_digest_size = std::max<std::size_t>(
     EVP_MAX_MD_SIZE,
     hash_max_custom_digest_size
@@ -41,6 +42,14 @@ public:
     // the returned pointer should not be used past the lifetime of this object
     const char* getName() const;
     bool reset();
+    /// Renders a digest produced by finalize() for display; hex by default
+    std::string formatDigest(const unsigned char* buf) const;
+    /// Serializes the running state so that hashing can be continued later,
+    /// possibly in another process. Returns false if the algorithm does not
+    /// support it.
+    bool exportState(std::vector<unsigned char>& out) const;
+    /// Restores a state produced by exportState() of the same algorithm
+    bool importState(const unsigned char* data, std::size_t count);
 
 private:
     bool isFinalized_;
@@ -50,6 +59,9 @@ private:
     virtual bool resetImpl() = 0;
     virtual std::size_t getDigestSizeImpl() const = 0;
     virtual const char* getNameImpl() const = 0;
+    virtual std::string formatDigestImpl(const unsigned char* buf) const;
+    virtual bool exportStateImpl(std::vector<unsigned char>& out) const;
+    virtual bool importStateImpl(const unsigned char* data, std::size_t count);
 };
 
 /// Lookup table to speed up CRC32
@@ -104,6 +116,8 @@ private:
     bool resetImpl() override;
     std::size_t getDigestSizeImpl() const override;
     const char* getNameImpl() const override;
+    bool exportStateImpl(std::vector<unsigned char>& out) const override;
+    bool importStateImpl(const unsigned char* data, std::size_t count) override;
 };
 
 // RAII
@@ -149,12 +163,24 @@ private:
     void initContext();
 };
 
+/// Constructs a hasher for the named algorithm. "crc32", "ssdeep" and "tlsh"
+/// are handled internally and everything else is looked up as an OpenSSL
+/// digest. Throws
+/// std::invalid_argument if the name is not recognized.
+std::unique_ptr<Hasher> makeHasher(const std::string& name);
+
 /// Converts a string of hexadecimal digits into a byte vector. The string must
 /// have an even number of characters and each character must be a valid hex
 /// digit (this will produce a byte vector of length sv.length()/2). Returns an
 /// empty optional on failure.
 std::optional<std::vector<unsigned char>> strToBytes(std::string_view sv);
-std::string bytesToStr(unsigned char* buf, std::size_t count);
+std::string bytesToStr(const unsigned char* buf, std::size_t count);
+
+/// 64-bit FNV-1a. Used where a hash must be identical across hosts and
+/// runs, e.g. for sampling and partitioning decisions; not for digests.
+std::uint64_t stableHash64(std::string_view sv);
+/// The splitmix64 finalizer, a cheap bijective bit mixer
+std::uint64_t mix64(std::uint64_t x);
 
 /// The returned vector always has size >= 1
 std::vector<std::string> splitOnChar(const char* s, char delim);
@@ -0,0 +1,193 @@
+#ifndef MJI_HASHFILE_HPP_INCLUDED_
+#define MJI_HASHFILE_HPP_INCLUDED_
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <xmphash/fingerprint.hpp>
+#include <xmphash/hasher.hpp>
+#include <xmphash/manifest.hpp>
+#include <xmphash/membudget.hpp>
+
+namespace mji::xmph {
+
+class CFileWrapper final {
+public:
+    std::FILE* fp;
+
+    CFileWrapper(std::FILE* fp)
+    : fp(fp)
+    {}
+
+    CFileWrapper(const CFileWrapper&) = delete;
+    CFileWrapper& operator=(const CFileWrapper&) = delete;
+
+    CFileWrapper(CFileWrapper&& other)
+    : fp(other.fp)
+    {
+        other.fp = nullptr;
+    }
+
+    CFileWrapper& operator=(CFileWrapper&& other)
+    {
+        fp = other.fp;
+        other.fp = nullptr;
+        return *this;
+    }
+
+    int close() {
+        if (fp != nullptr) {
+            int ret = std::fclose(fp);
+            fp = nullptr;
+            return ret;
+        } else {
+            return EOF;
+        }
+    }
+
+    ~CFileWrapper() {
+        close();
+    }
+};
+
+/// Digests of a single input, parallel to the algorithm list of the
+/// FileHasher that produced them
+struct FileDigests {
+    std::uint64_t size = 0;
+    std::vector<std::string> digests;
+    /// Parallel to the streaming algorithms; empty unless block digests were
+    /// requested
+    std::vector<std::vector<std::string>> blockDigests;
+};
+
+/// How far a stream had been hashed, with the exported state of each
+/// streaming hasher at that point
+struct StreamCheckpoint {
+    std::uint64_t offset = 0;
+    std::vector<std::vector<unsigned char>> states;
+};
+
+/// Optional checkpointing of a long stream. Only used in binary mode, and
+/// only when every streaming algorithm can export its state.
+struct CheckpointHooks {
+    /// Bytes between calls to save; 0 disables saving
+    std::uint64_t interval = 0;
+    std::function<void(const StreamCheckpoint&)> save;
+    /// Continue from here instead of the start of the file, if not null
+    const StreamCheckpoint* resumeFrom = nullptr;
+};
+
+/// Owns one hasher per requested algorithm (plus a second set for per-block
+/// digests when a block size is given) and runs inputs through all of them in
+/// a single pass. Fingerprint algorithms ("fp-<algo>"), "fsverity" and git
+/// object IDs ("git-<algo>") are kept apart, since they read the file by
+/// position (or not at all) and so cannot share the stream.
+class FileHasher final {
+public:
+    /// A blockSize of 0 disables block digests. Throws std::invalid_argument
+    /// if an algorithm name is not recognized, or if block digests are asked
+    /// of a similarity digest (ssdeep, tlsh).
+    FileHasher(const std::vector<std::string>& algoNames, std::uint64_t blockSize,
+        const FingerprintParams& fingerprintParams = {});
+
+    /// Whether any algorithm needs the whole content streamed through it
+    bool needsStream() const;
+    /// Whether any algorithm reads the file by position
+    bool hasPositional() const;
+
+    /// Hashes the stream to EOF with every streaming algorithm, leaving the
+    /// fingerprint digests untouched. On failure, prints a message mentioning
+    /// displayName to stderr and returns false.
+    bool hashStream(std::FILE* fp, const char* displayName, FileDigests& out,
+        const CheckpointHooks* hooks = nullptr);
+
+    /// Computes the fingerprint, fs-verity and git digests of the named file,
+    /// leaving the other digests untouched. Fails for inputs that cannot be
+    /// read by position, such as standard input.
+    bool hashPositional(const char* path, FileDigests& out);
+
+    /// Hashes the named file ("-" for standard input) with every algorithm,
+    /// opening it in binary or text mode. Prints a message and returns false
+    /// on failure.
+    bool hashFile(const std::string& path, bool binaryMode, FileDigests& out,
+        const CheckpointHooks* hooks = nullptr);
+
+    /// Lets fs-verity digests be computed on up to `threads` threads (1 by
+    /// default), charging the read buffers of all but the first to budget if
+    /// it is not null
+    void setPositionalThreads(unsigned int threads, MemoryBudget* budget);
+
+    /// Whether streams can be checkpointed: every streaming algorithm
+    /// supports exporting its state and no block digests are requested
+    bool canCheckpoint() const;
+
+    const std::vector<std::string>& algoNames() const;
+    std::uint64_t blockSize() const;
+
+    /// Rough size of the memory held by this hasher: its read buffer and the
+    /// state of each algorithm
+    std::size_t workingSetSize() const;
+    /// Rough size of the digests of a file of the given size, which is
+    /// dominated by the block digests when those are requested
+    std::uint64_t digestsSize(std::uint64_t fileSize) const;
+
+private:
+    /// Bytes read at a time into a pool buffer: large enough to amortize the
+    /// read calls, small enough to stay in cache while each hasher consumes
+    /// the chunk in turn
+    static constexpr std::size_t readSize = 256 << 10;
+    /// How often the pages of a stream already hashed are dropped from the
+    /// cache in low-impact mode
+    static constexpr std::uint64_t dropCacheInterval = 8 << 20;
+    /// Allowance for the state of one hasher, for workingSetSize()
+    static constexpr std::size_t hasherStateSize = 1024;
+
+    std::vector<std::string> algoNames_;
+    /// Index into algoNames_ of each of hashers_
+    std::vector<std::size_t> streamIdx_;
+    std::vector<std::unique_ptr<Hasher>> hashers_;
+    std::vector<std::unique_ptr<Hasher>> blockHashers_;
+    /// Index into algoNames_ of each of fingerprintHashers_
+    std::vector<std::size_t> fingerprintIdx_;
+    std::vector<std::unique_ptr<Hasher>> fingerprintHashers_;
+    /// Index into algoNames_ of each "fsverity"
+    std::vector<std::size_t> verityIdx_;
+    /// Index into algoNames_ of each of gitHashers_
+    std::vector<std::size_t> gitIdx_;
+    std::vector<std::unique_ptr<Hasher>> gitHashers_;
+    /// Kernel crypto API names of hashers_, if the kernel knows them all
+    std::optional<std::vector<std::string>> kernelNames_;
+    FingerprintParams fingerprintParams_;
+    std::uint64_t blockSize_;
+    bool canCheckpoint_;
+    unsigned int positionalThreads_;
+    MemoryBudget* memoryBudget_;
+
+    bool consumeAll(const unsigned char* data, std::size_t count, const char* displayName);
+    bool finishBlock(FileDigests& out, const char* displayName);
+    bool resumeStream(std::FILE* fp, const StreamCheckpoint& checkpoint, FileDigests& out);
+    void saveCheckpoint(const CheckpointHooks& hooks, std::uint64_t offset);
+    /// Hashes the named file with every streaming algorithm through the
+    /// kernel crypto API. Returns false, with nothing reported, if the kernel
+    /// could not, so that the caller can fall back to the stream.
+    bool hashKernel(const char* path, FileDigests& out);
+};
+
+/// Finalizes a hasher and returns its digest as a string, or an empty
+/// optional if finalization failed
+std::optional<std::string> finalizeToStr(Hasher& hasher);
+
+/// Builds the manifest record for a file hashed by a FileHasher of the given
+/// algorithms and block size. Needs no hasher, so results can be formatted
+/// while a HashEngine is running.
+ManifestEntry toManifestEntry(const std::vector<std::string>& algoNames, std::uint64_t blockSize,
+    const FileDigests& digests, std::string path);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_HASHFILE_HPP_INCLUDED_
@@ -0,0 +1,88 @@
+#ifndef MJI_JOURNAL_HPP_INCLUDED_
+#define MJI_JOURNAL_HPP_INCLUDED_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <xmphash/hashfile.hpp>
+
+/*******************************************************************************
+Progress journal:
+A journal lets an interrupted run be resumed without redoing finished work.
+It is a sequence of NUL-terminated records:
+
+    H <run key>                         the algorithms and options of the run
+    D <manifest record>                 a file that has been completely hashed
+    C <offset> <state>[:<state>...] <path>
+                                        progress through a file that was still
+                                        being hashed, with the hex-encoded state
+                                        of each hasher (see Hasher::exportState)
+
+Since inputs are hashed and reported in traversal order, the D records also
+give the traversal position. D records are buffered and made durable in
+batches (one fsync per batch, not per file); a checkpoint is synced as soon as
+it is written, along with any buffered D records. A record torn by a crash
+lacks its terminator and is ignored on resume, at the cost of redoing that
+file. Resuming rewrites the journal without superseded and torn records.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+/// Bytes hashed between checkpoints of a file in progress
+constexpr std::uint64_t journal_checkpoint_interval = 256ull << 20;
+
+class Journal final {
+public:
+    Journal();
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /// Starts a journal for a run described by runKey. With resume, an
+    /// existing journal is loaded first, and must have the same run key;
+    /// otherwise any existing journal is discarded.
+    bool open(const char* path, const std::string& runKey, bool resume);
+
+    /// The manifest record of a file completed by an earlier run, or null
+    const std::string* completedRecord(const std::string& path) const;
+    /// The last checkpoint of an earlier run for a file it did not complete,
+    /// or null
+    const StreamCheckpoint* checkpoint(const std::string& path) const;
+
+    /// Records a completed file. The record becomes durable at the next
+    /// commit, which happens automatically every few hundred records or
+    /// about once a second.
+    bool recordCompleted(const std::string& record);
+    /// Durably records progress through a file. May be called from any
+    /// thread.
+    bool recordCheckpoint(const std::string& path, const StreamCheckpoint& checkpoint);
+    /// Makes every record written so far durable
+    bool commit();
+
+private:
+    static constexpr std::size_t commit_records = 256;
+    static constexpr std::chrono::milliseconds commit_interval{1000};
+
+    std::mutex mutex_;
+    std::FILE* fp_;
+    std::string path_;
+    // loaded by open() and not changed afterwards
+    std::unordered_map<std::string, std::string> completed_;
+    std::unordered_map<std::string, StreamCheckpoint> checkpoints_;
+    std::string pending_;
+    std::size_t pendingRecords_;
+    std::chrono::steady_clock::time_point lastCommit_;
+
+    bool load(const std::string& runKey);
+    bool rewrite(const std::string& runKey);
+    bool commitLocked();
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_JOURNAL_HPP_INCLUDED_
@@ -0,0 +1,42 @@
+#ifndef MJI_KCRYPTO_HPP_INCLUDED_
+#define MJI_KCRYPTO_HPP_INCLUDED_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+/*******************************************************************************
+Kernel crypto offload:
+On Linux the kernel crypto API can hash a file through AF_ALG sockets. The
+file's pages are spliced from the page cache into a pipe and from the pipe
+into one socket per algorithm, so the data never passes through a user space
+buffer, and where the kernel has a hardware driver for the algorithm the
+hashing itself is offloaded as well. Whether this beats OpenSSL depends on
+the host: the kernel's generic implementations are often slower than
+OpenSSL's, and each splice is a system call, so `xmphash --benchmark`
+measures both paths on given files before it is turned on.
+
+The kernel path is only taken when it would produce exactly what the stream
+would: a regular file opened in binary mode, no block digests, no
+checkpoints, and every streaming algorithm known to the kernel. Anything
+else, including a kernel without AF_ALG, falls back to the stream.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+/// Enables hashing through the kernel crypto API where possible. Not
+/// thread-safe; call before starting work.
+void setKernelHashing(bool enabled);
+bool kernelHashing();
+
+/// The kernel crypto API name of an algorithm, or an empty optional if the
+/// kernel path does not support it
+std::optional<std::string> kernelHashName(const std::string& algoName);
+
+/// Kernel names for all of algoNames, or an empty optional if any is missing
+std::optional<std::vector<std::string>> kernelHashNames(
+    const std::vector<std::string>& algoNames);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_KCRYPTO_HPP_INCLUDED_
@@ -0,0 +1,71 @@
+#ifndef MJI_KNOWNSET_HPP_INCLUDED_
+#define MJI_KNOWNSET_HPP_INCLUDED_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+Known set index format:
+A known set is a set of digests of one algorithm (e.g. a known-good or
+known-bad list), stored so it can be memory-mapped and queried in place. All
+integers are little-endian.
+
+    offset 0    magic "XMPHKSET"
+           8    u32 format version (1)
+          12    u32 digest size in bytes
+          16    u64 digest count
+          24    u64 Bloom filter block count
+          32    algorithm name, NUL-padded to 32 bytes
+          64    Bloom filter, 64 bytes per block
+                sorted, deduplicated digests
+
+The Bloom filter is blocked: each digest sets bloom_hashes bits within a
+single 64-byte block, so a negative lookup costs one cache line and never
+touches the digest array. Positive (and the ~1% false positive) lookups then
+interpolation-search the digest array. Digests are close to uniformly
+distributed, so the search converges in a couple of probes instead of the
+log2(count) of a binary search, keeping a lookup to a few page touches even
+for sets of hundreds of millions of entries.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+/// Builds a known set index for algoName from a text list with one hex digest
+/// at the start of each line (an optional leading '"' is skipped, so the first
+/// column of a quoted CSV such as an NSRL hash file also works). Lines that do
+/// not start with a digest of the right length are skipped and counted.
+bool buildKnownSet(const char* listPath, const std::string& algoName, const char* indexPath);
+
+class KnownSet final {
+public:
+    KnownSet();
+
+    KnownSet(const KnownSet&) = delete;
+    KnownSet& operator=(const KnownSet&) = delete;
+
+    /// Maps and validates an index written by buildKnownSet
+    bool open(const char* path);
+
+    const std::string& algoName() const;
+    std::uint64_t count() const;
+
+    bool contains(const unsigned char* digest) const;
+    /// Returns false for strings that are not a hex digest of the right size
+    bool containsHex(std::string_view hex) const;
+
+private:
+    mji::xplat::MappedFile file_;
+    std::string algoName_;
+    std::size_t digestSize_;
+    std::uint64_t count_;
+    std::uint64_t bloomBlocks_;
+    const unsigned char* bloom_;
+    const unsigned char* digests_;
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_KNOWNSET_HPP_INCLUDED_
@@ -0,0 +1,84 @@
+#ifndef MJI_LATENCY_HPP_INCLUDED_
+#define MJI_LATENCY_HPP_INCLUDED_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+/*******************************************************************************
+Latency tracking:
+With --latency-report every file hashed by the engine is timed from open to
+finalize, and every read of file data (stream or positioned) is timed on its
+own, leaving out any wait for --rate. Each thread records into histograms of
+its own, created the first time it records and never shared while work is
+in progress, so recording is a few relaxed atomic increments with no locks
+or contended cache lines. Each thread also keeps its slowest files. At exit
+the histograms are merged and p50, p99 and p99.9 reported, with the slowest
+files overall, their sizes and throughput. The few pathological files that
+dominate a run (huge, fragmented, or on a failing disk) stand out there
+where an average would hide them.
+
+The histograms are HDR-style: values below 64 ns have buckets of their own,
+and each power of two above has 32 linear sub-buckets, so any value is
+reported to within about 3% over the whole range up to hours, in a fixed
+15 KiB per histogram.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+constexpr std::size_t default_slow_file_count = 10;
+
+/// Counts of nanosecond values in log-linear buckets. Recording may race with
+/// reading; a reader sees some consistent subset of the values.
+class LatencyHistogram final {
+public:
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(std::uint64_t nanos);
+    /// Adds the counts of another histogram to this one
+    void merge(const LatencyHistogram& other);
+
+    std::uint64_t count() const;
+    std::uint64_t max() const;
+    /// The smallest value that at least a fraction q of the values do not
+    /// exceed, to within the bucket precision; 0 if there are none
+    std::uint64_t quantile(double q) const;
+
+private:
+    static constexpr unsigned int sub_bucket_bits = 5;
+    static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+    static constexpr std::size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> counts_;
+    std::atomic<std::uint64_t> total_;
+    std::atomic<std::uint64_t> max_;
+
+    static std::size_t indexOf(std::uint64_t nanos);
+    /// The middle of the range of values of a bucket
+    static std::uint64_t valueAt(std::size_t index);
+};
+
+/// Turns tracking on, keeping the given number of slowest files. Call before
+/// starting work.
+void setLatencyTracking(std::size_t slowFileCount);
+bool latencyTracking();
+
+/// A timestamp to pass to the record functions, or 0 if tracking is off
+std::uint64_t latencyStart();
+/// Records a read that began at start; does nothing if start is 0
+void recordReadLatency(std::uint64_t start);
+/// Records a file hashed from start until now
+void recordFileLatency(std::uint64_t start, const std::string& path, std::uint64_t size);
+
+/// Prints the percentiles and the slowest files. Call once work is done.
+void printLatencyReport(std::FILE* out);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_LATENCY_HPP_INCLUDED_
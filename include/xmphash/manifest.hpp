@@ -0,0 +1,128 @@
+#ifndef MJI_MANIFEST_HPP_INCLUDED_
+#define MJI_MANIFEST_HPP_INCLUDED_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*******************************************************************************
+Manifest format:
+A manifest is a sequence of records, one per file, each ended by a terminator
+('\n', or '\0' when zero-terminated). A record is a comma-separated list of
+name=value fields, a single space, and then the path, which runs to the end of
+the record:
+
+    size=5,crc32=3610a686,sha256@4=<hex>:<hex> path/to/file
+
+Field names are:
+    size            file size in bytes, decimal (for --dirhash, the total
+                    size of the files beneath a directory)
+    <algo>          whole-file digest, hex
+    <algo>@<bs>     digests of consecutive <bs>-byte blocks, hex, separated by
+                    ':' (the final block may be short)
+    known           1 if the file's digest is in the --known set, else 0
+    files           number of files beneath a directory (--dirhash)
+    dirhash-<algo>  directory digest, hex (see dirhash.hpp); the path is "."
+                    for the root of the tree
+Records starting with '#' are comments and are skipped by the reader.
+A manifest may also be zstd-compressed (see compress.hpp); readers detect
+this and decompress it.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+class FrameCompressor;
+class StreamDecompressor;
+
+struct ManifestEntry {
+    std::vector<std::pair<std::string, std::string>> fields;
+    std::string path;
+
+    /// Returns nullptr if there is no field with the given name
+    const std::string* findField(std::string_view name) const;
+};
+
+/// Formats an entry without its terminator
+std::string formatManifestEntry(const ManifestEntry& entry);
+
+/// Parses a single record (without its terminator). Returns an empty optional
+/// if the record is malformed.
+std::optional<ManifestEntry> parseManifestRecord(std::string_view record);
+
+/// Splits a block field name "<algo>@<bs>" into the algorithm name and block
+/// size. Returns an empty optional for anything else.
+std::optional<std::pair<std::string, std::uint64_t>>
+parseBlockFieldName(std::string_view name);
+
+class ManifestReader final {
+public:
+    explicit ManifestReader(char terminator);
+    ~ManifestReader();
+
+    ManifestReader(const ManifestReader&) = delete;
+    ManifestReader& operator=(const ManifestReader&) = delete;
+
+    /// A path of "-" reads standard input. Compressed input is recognized
+    /// and decompressed.
+    bool open(const char* path);
+
+    /// Reads the next record. Returns false at the end of input or if a
+    /// record could not be read or parsed; failed() tells these apart.
+    bool next(ManifestEntry& entry);
+    bool failed() const;
+    /// 1-based number of the record most recently returned by next()
+    std::uint64_t recordNumber() const;
+
+private:
+    static constexpr std::size_t bufSize = 1 << 16;
+
+    std::FILE* fp_;
+    bool ownsFile_;
+    char terminator_;
+    bool failed_;
+    bool eof_;
+    std::uint64_t recordNumber_;
+    std::unique_ptr<char[]> buf_;
+    std::size_t bufPos_;
+    std::size_t bufLen_;
+    std::string record_;
+    std::unique_ptr<StreamDecompressor> decompressor_;
+
+    bool readRecord();
+};
+
+class ManifestWriter final {
+public:
+    /// The stream is not owned. With a compression level, records are
+    /// written as independent zstd frames, compressed on another thread.
+    ManifestWriter(std::FILE* fp, char terminator,
+        std::optional<int> compressionLevel = std::nullopt);
+    ~ManifestWriter();
+
+    ManifestWriter(const ManifestWriter&) = delete;
+    ManifestWriter& operator=(const ManifestWriter&) = delete;
+
+    /// Returns false on a write error, or if the path contains the terminator
+    /// and so cannot be represented.
+    bool write(const ManifestEntry& entry);
+    /// Writes out any records still held for compression; nothing may be
+    /// written after. Returns false on a write error. Called by the
+    /// destructor.
+    bool finish();
+
+private:
+    std::FILE* fp_;
+    char terminator_;
+    std::unique_ptr<FrameCompressor> compressor_;
+    /// Records not yet handed to the compressor
+    std::string pending_;
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_MANIFEST_HPP_INCLUDED_
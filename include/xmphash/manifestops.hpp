@@ -0,0 +1,107 @@
+#ifndef MJI_MANIFESTOPS_HPP_INCLUDED_
+#define MJI_MANIFESTOPS_HPP_INCLUDED_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <xmphash/compress.hpp>
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+Sorted manifest operations:
+Diff and merge are single streaming passes over manifests sorted bytewise by
+path (the order hash mode writes them in), reading the inputs through memory
+mappings. Inputs that turn out not to be sorted are first put through an
+external merge sort: runs of at most sortMemory bytes of records are sorted in
+memory and spilled to temporary files, which are then merged. Memory use is
+therefore bounded by sortMemory and the number of inputs, never by the size of
+a manifest. Compressed manifests are decompressed as they are read, a window
+of about a MiB at a time, so the same bound holds for them.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+struct ManifestOpsOptions {
+    char terminator = '\n';
+    std::uint64_t sortMemory = 256ull << 20;
+    /// Empty means the system temporary directory
+    std::string tempDir;
+};
+
+/// Hands out the records of a memory-mapped manifest in file order, skipping
+/// comments and empty records. Views stay valid while the object lives.
+/// A compressed manifest is instead decompressed as it is read, a window at a
+/// time, and its views only stay valid until the next call to next().
+class MappedManifest final {
+public:
+    explicit MappedManifest(char terminator);
+
+    bool open(const char* path);
+    /// False at the end of the manifest, or once reading has failed
+    bool next(std::string_view& record);
+    /// False once decompressing a compressed manifest has failed, with a
+    /// message printed
+    bool ok() const;
+    /// Whether views stay valid while the object lives
+    bool keepsRecords() const;
+
+    /// The path part of a record (everything after the first space)
+    static std::string_view recordPath(std::string_view record);
+
+private:
+    /// Decompressed bytes read into the window at a time
+    static constexpr std::size_t inflate_size = 1 << 20;
+
+    mji::xplat::MappedFile file_;
+    /// The compressed manifest, if it is one, and its path for messages
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> stream_;
+    std::string streamPath_;
+    std::unique_ptr<StreamDecompressor> decompressor_;
+    /// The decompressed records from pos_ on, and the start of the next
+    std::string window_;
+    /// The mapping, or the window
+    std::string_view content_;
+    char terminator_;
+    std::size_t pos_;
+    bool streamEnded_;
+    bool failed_;
+
+    /// Drops the records already handed out and appends more decompressed
+    /// text. Returns false at the end of the stream or on failure.
+    bool refill();
+};
+
+/// Whether the records are in nondecreasing path order
+bool isManifestSorted(const char* path, char terminator);
+
+/// Writes the records of the manifest to out sorted by path, spilling sorted
+/// runs to temporary files when it does not fit in options.sortMemory
+bool sortManifest(const char* path, std::FILE* out, const ManifestOpsOptions& options);
+
+struct ManifestDiffReport {
+    std::uint64_t added = 0;
+    std::uint64_t removed = 0;
+    std::uint64_t changed = 0;
+    std::uint64_t unchanged = 0;
+};
+
+/// Prints "added:", "removed:" and "changed:" lines for the paths that differ
+/// between two manifests. A record is changed if a field present on both
+/// sides has different values (or, with no common fields, if the records
+/// differ at all).
+bool diffManifests(const char* oldPath, const char* newPath,
+    const ManifestOpsOptions& options, ManifestDiffReport& report);
+
+/// k-way merges manifests into one sorted manifest on out. When a path
+/// occurs in several inputs the record from the earliest input is kept, with
+/// a warning if the others differ from it.
+bool mergeManifests(const std::vector<std::string>& paths, std::FILE* out,
+    const ManifestOpsOptions& options);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_MANIFESTOPS_HPP_INCLUDED_
@@ -0,0 +1,46 @@
+#ifndef MJI_MEMBUDGET_HPP_INCLUDED_
+#define MJI_MEMBUDGET_HPP_INCLUDED_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace mji::xmph {
+
+/// A byte budget shared by the stages of a run. Stages reserve what they are
+/// about to allocate and block while the budget is exhausted, which pushes
+/// back on whatever is producing work for them.
+class MemoryBudget final {
+public:
+    explicit MemoryBudget(std::uint64_t limit);
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    /// Reserves bytes, blocking until they fit in the budget or mayExceed()
+    /// returns true. mayExceed is how a stage that must make progress (for
+    /// example the result everyone else is waiting for) avoids deadlock; it
+    /// is re-evaluated whenever memory is released or wake() is called.
+    void acquire(std::uint64_t bytes, const std::function<bool()>& mayExceed);
+    /// Reserves bytes only if they fit right now
+    bool tryAcquire(std::uint64_t bytes);
+    void release(std::uint64_t bytes);
+    /// Re-evaluates the mayExceed conditions of blocked acquirers
+    void wake();
+
+    std::uint64_t limit() const;
+    /// The most ever reserved at once
+    std::uint64_t peak() const;
+
+private:
+    std::uint64_t limit_;
+    std::uint64_t inUse_;
+    std::uint64_t peak_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_MEMBUDGET_HPP_INCLUDED_
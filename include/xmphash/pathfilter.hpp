@@ -0,0 +1,158 @@
+#ifndef MJI_PATHFILTER_HPP_INCLUDED_
+#define MJI_PATHFILTER_HPP_INCLUDED_
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*******************************************************************************
+Path filters:
+Include and exclude globs are matched against the path of each entry below
+a walk root, written with a leading '/' ("/src/main.c"). In a glob, '*'
+matches any run of bytes, '/' included (as with find -path), '?' any one
+byte, "[...]" one byte of a set ("[!...]" or "[^...]" for the complement)
+and '\' escapes the next byte. A glob with no '/' is matched against the
+name of every entry, so none of its wildcards match a '/' ("*.tmp" matches
+"/a/b.tmp" but not "/a.tmp.d/b", and "a*b" does not match "/a/b"); one
+with a '/' is matched against the whole path, anchored at the root unless
+it starts with '*'. A trailing '/' is ignored. A directory matched by a
+glob takes everything beneath it with it. An entry is kept if it matches
+no exclude and, when there are includes, matches one (or lies beneath a
+directory that does); files must also be within the size range.
+
+All the globs are compiled together into one DFA over byte classes, whose
+states record which kinds of glob have matched. A walk carries the state of
+each directory and feeds only "/<name>" for each entry, so each byte of a
+path is examined once however many globs there are. The DFA is built lazily,
+a state and its transitions as walks first need them, since building it up
+front can take exponential time for globs with several stars. A directory
+is skipped without being read when its state shows that nothing beneath it
+could be kept: an exclude is certain to match every path below (as with
+an exclude of "node_modules"), or no include can match any longer.
+
+A filter may also keep only one of N shards. Each entry directly below the
+root (with everything beneath it) belongs to the shard chosen by a stable
+hash of its name, so every host computes the same partition without
+coordinating, whatever the mount point, and a directory of another shard is
+not read at all. The shards' manifests together list exactly the files of
+an unsharded run.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+class PathFilter final {
+public:
+    /// Where a walk is: the DFA state of an entry's path, whether a
+    /// directory above it matched an include, whether it is below the root,
+    /// and whether its top-level entry belongs to another shard
+    struct Cursor {
+        std::uint32_t state;
+        bool included;
+        bool belowRoot;
+        bool otherShard;
+    };
+
+    PathFilter();
+
+    /// Adds a glob. Prints a message and returns false if it is malformed.
+    bool addInclude(std::string_view glob);
+    bool addExclude(std::string_view glob);
+    /// Keeps only files of minSize to maxSize bytes, inclusive
+    void setSizeRange(std::uint64_t minSize, std::uint64_t maxSize);
+    /// Keeps only the shard with the given 0-based index of count shards
+    void setShard(std::uint32_t index, std::uint32_t count);
+
+    /// Prepares the globs added so far for matching
+    void compile();
+
+    /// Whether the filter keeps everything
+    bool empty() const;
+    /// Whether a shard has been set
+    bool sharded() const;
+    /// Whether a top-level name (or a walk root given as a file) is in the
+    /// shard kept
+    bool inShard(std::string_view key) const;
+
+    /// The cursor of a walk root
+    Cursor root() const;
+    /// The cursor of an entry of the directory at dir
+    Cursor child(Cursor dir, std::string_view name) const;
+    /// Whether nothing beneath the directory at the cursor can be kept
+    bool prunesDir(Cursor dir) const;
+    /// Whether the globs keep the entry at the cursor
+    bool keepsEntry(Cursor entry) const;
+    /// Whether the file at the cursor is kept: its path and its size
+    bool keepsFile(Cursor file, std::uint64_t size) const;
+    /// Whether the file at the given root-relative, '/'-separated path is
+    /// kept, checking each directory on the way
+    bool keepsPath(std::string_view relPath, std::uint64_t size) const;
+
+private:
+    enum class Kind : unsigned char { include, exclude };
+
+    /// A compiled glob: one byte set per position, or a star, which repeats
+    /// over its set
+    struct Glob {
+        Kind kind;
+        std::vector<std::bitset<256>> sets;
+        std::vector<bool> stars;
+    };
+
+    struct State {
+        /// Glob positions reached, sorted; see positionGlob_
+        std::vector<std::uint32_t> positions;
+        bool acceptsInclude = false;
+        bool acceptsExclude = false;
+        /// An exclude matches every non-empty continuation
+        bool excludesAll = false;
+        /// Some include could still match a continuation
+        bool mayInclude = false;
+    };
+
+    /// The states built so far. Shared by concurrent walks of one filter.
+    struct Dfa {
+        std::mutex mutex;
+        std::vector<State> states;
+        std::map<std::vector<std::uint32_t>, std::uint32_t> ids;
+        /// transitions[state * classCount + class], unknown_state until built
+        std::vector<std::uint32_t> transitions;
+    };
+
+    static constexpr std::uint32_t unknown_state = 0xffffffffu;
+
+    std::vector<Glob> globs_;
+    bool hasIncludes_;
+    std::uint64_t minSize_;
+    std::uint64_t maxSize_;
+    std::uint32_t shardIndex_;
+    std::uint32_t shardCount_;
+
+    /// The glob of each position, and the position of each glob's first
+    /// element; position base + size is the glob's match
+    std::vector<std::uint32_t> positionGlob_;
+    std::vector<std::uint32_t> globBase_;
+    /// Byte class of each byte, and a byte of each class
+    unsigned char classOf_[256];
+    unsigned char classByte_[256];
+    std::size_t classCount_;
+    std::unique_ptr<Dfa> dfa_;
+
+    bool addGlob(std::string_view glob, Kind kind);
+    /// Adds the closure of the positions as a state if it is new. Called
+    /// with the DFA locked.
+    std::uint32_t intern(std::vector<std::uint32_t> positions) const;
+    /// Called with the DFA locked
+    std::uint32_t step(std::uint32_t state, unsigned char c) const;
+    /// A copy of a state's flags
+    State flags(std::uint32_t state) const;
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_PATHFILTER_HPP_INCLUDED_
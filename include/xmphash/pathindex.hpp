@@ -0,0 +1,70 @@
+#ifndef MJI_PATHINDEX_HPP_INCLUDED_
+#define MJI_PATHINDEX_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*******************************************************************************
+Path index:
+A minimal perfect hash over a fixed set of paths, built with the "hash and
+displace" method. Keys are hashed once into a bucket (about bucket_load keys
+each); buckets are then placed largest first, each trying successive
+displacement values (pilots) until all of its keys land on free slots of a
+table of exactly as many slots as keys. Buckets with a single key are placed
+last and simply take the next free slot, which is recorded in the pilot
+directly (flagged by the top bit), so the nearly-full tail of the table never
+has to be searched.
+
+A lookup is one hash, one pilot read, one slot read and one key comparison to
+reject paths that are not in the set.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+class PathIndex final {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    enum class BuildResult : unsigned char {
+        ok,
+        /// A path occurs more than once
+        duplicatePath,
+        /// More paths than a pilot can address directly
+        tooManyPaths,
+        /// No displacement placed every bucket, even after reseeding
+        unplaceable
+    };
+
+    PathIndex();
+
+    /// Builds the index over paths, which must not contain duplicates.
+    /// Anything but BuildResult::ok leaves the index empty; on
+    /// duplicatePath, duplicate (if given) is set to the repeated path.
+    BuildResult build(std::vector<std::string> paths, std::string* duplicate = nullptr);
+
+    /// The position of path in the vector given to build(), or npos
+    std::size_t find(std::string_view path) const;
+
+    std::size_t size() const;
+    const std::string& path(std::size_t idx) const;
+
+private:
+    static constexpr std::uint32_t direct_flag = 0x80000000u;
+
+    std::vector<std::string> paths_;
+    std::vector<std::uint32_t> pilots_;
+    /// Index into paths_ of the key placed in each slot
+    std::vector<std::uint32_t> slots_;
+    std::uint64_t seed_;
+
+    std::uint64_t keyHash(std::string_view path) const;
+    std::size_t bucketOf(std::uint64_t hash) const;
+    std::size_t slotOf(std::uint64_t hash, std::uint32_t pilot) const;
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_PATHINDEX_HPP_INCLUDED_
@@ -0,0 +1,66 @@
+#ifndef MJI_PREFETCH_HPP_INCLUDED_
+#define MJI_PREFETCH_HPP_INCLUDED_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mji::xmph {
+
+struct PrefetchOptions {
+    /// How many files ahead of the workers to prefetch; 0 disables
+    unsigned int depth = 0;
+    /// Upper bound on the bytes prefetched but not yet being hashed
+    std::uint64_t byteBudget = 64ull << 20;
+};
+
+/// Runs ahead of the workers of a multi-file run on a thread of its own,
+/// asking the kernel to read the start of each upcoming file into the page
+/// cache (see xplat::prefetchFile), so that workers do not stall on the
+/// first read of every file. Each file gets at most an equal share of the
+/// byte budget; once a worker is reading a file, sequential readahead takes
+/// over.
+class Prefetcher final {
+public:
+    /// order lists the indices into paths in the order the workers will
+    /// start them. Does nothing if options.depth is 0. The paths must
+    /// outlive this.
+    Prefetcher(const std::vector<std::string>& paths, std::vector<std::size_t> order,
+        const PrefetchOptions& options);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    /// Called as a worker starts on the file at the given position of the
+    /// order. Files up to it no longer count against the window.
+    void started(std::size_t pos);
+
+private:
+    const std::vector<std::string>& paths_;
+    std::vector<std::size_t> order_;
+    PrefetchOptions options_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    bool stopping_;
+    /// Positions in order_: files before this have been started by a worker
+    std::size_t started_;
+    /// Next file to prefetch
+    std::size_t ahead_;
+    /// Position and bytes of each file prefetched and not yet started
+    std::deque<std::pair<std::size_t, std::uint64_t>> outstanding_;
+    std::uint64_t outstandingBytes_;
+
+    void run();
+    void retireStarted();
+};
+
+}  // namespace mji::xmph
+
+#endif  // MJI_PREFETCH_HPP_INCLUDED_
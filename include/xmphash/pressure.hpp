@@ -0,0 +1,67 @@
+#ifndef MJI_PRESSURE_HPP_INCLUDED_
+#define MJI_PRESSURE_HPP_INCLUDED_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+/*******************************************************************************
+Pressure-aware backoff:
+While a PressureMonitor is running, a background thread samples the
+system-wide pressure stall totals for I/O and CPU (/proc/pressure/io and
+/proc/pressure/cpu) and works out the fraction of each interval in which some
+task was stalled. When
+either fraction is above the threshold, the number of workers allowed to
+start new files is halved and read sizes are halved (down to an eighth);
+once both are below half the threshold, read sizes grow back first and then
+workers are added back one per interval. This additive-increase,
+multiplicative-decrease scheme backs off quickly when other work suffers and
+creeps back to full speed when the machine is idle.
+
+Workers only block before starting a file, so a file in progress is never
+left half-read. Worker 0 is never blocked.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+struct PressureOptions {
+    /// Stall fraction (0-1) above which to back off
+    double threshold = 0.10;
+    std::chrono::milliseconds interval{1000};
+    unsigned int maxWorkers = 1;
+};
+
+class PressureMonitor final {
+public:
+    PressureMonitor();
+    ~PressureMonitor();
+
+    PressureMonitor(const PressureMonitor&) = delete;
+    PressureMonitor& operator=(const PressureMonitor&) = delete;
+
+    /// Returns false if pressure information is not available
+    bool start(const PressureOptions& options);
+    void stop();
+
+private:
+    PressureOptions options_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable stopRequested_;
+    bool stopping_;
+
+    void run();
+};
+
+/// Blocks while the given worker is beyond the number currently allowed
+void waitForWorkerSlot(unsigned int worker);
+
+/// Scales a read size down while the system is under pressure. Never returns
+/// less than minSize (or maxSize, if smaller).
+std::size_t pressureReadSize(std::size_t maxSize, std::size_t minSize = 4096);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_PRESSURE_HPP_INCLUDED_
@@ -0,0 +1,39 @@
+#ifndef MJI_THROTTLE_HPP_INCLUDED_
+#define MJI_THROTTLE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+Read throttling:
+All reads of input data go through a single process-wide token bucket, so the
+limit holds for the sum of all workers whichever read path they use (fread
+streams or positioned reads). Each read is charged in full when it is
+submitted and the unused part refunded when it returns short, so what is
+accounted is what was actually read. The bucket may go into debt: a read
+larger than the available tokens is let through after sleeping off the debt,
+which keeps the long-run rate exact without splitting reads.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+/// Limits input reads to bytesPerSecond on average, allowing bursts of up to
+/// burst bytes. A rate of 0 removes the limit. Not thread-safe with respect
+/// to concurrent reads; call before starting work.
+void setReadRateLimit(std::uint64_t bytesPerSecond, std::uint64_t burst);
+
+/// Blocks until count bytes may be read
+void throttleRead(std::uint64_t count);
+
+/// Returns tokens charged by throttleRead() for bytes that were not read
+void refundRead(std::uint64_t count);
+
+/// InFile::readAt with throttling
+std::int64_t throttledReadAt(const mji::xplat::InFile& file, void* buf, std::size_t count,
+    std::uint64_t offset);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_THROTTLE_HPP_INCLUDED_
@@ -0,0 +1,39 @@
+#ifndef MJI_TREEDIFF_HPP_INCLUDED_
+#define MJI_TREEDIFF_HPP_INCLUDED_
+
+#include <cstdint>
+#include <string>
+
+#include <xmphash/membudget.hpp>
+#include <xmphash/pathfilter.hpp>
+
+namespace mji::xmph {
+
+struct TreeDiffOptions {
+    unsigned int jobs = 1;
+    /// If set, the read buffers are sized (and the workers limited) to fit
+    MemoryBudget* memoryBudget = nullptr;
+    /// If set, applied to both trees
+    const PathFilter* filter = nullptr;
+};
+
+struct TreeDiffReport {
+    std::uint64_t added = 0;
+    std::uint64_t removed = 0;
+    std::uint64_t changed = 0;
+    std::uint64_t identical = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t bytesRead = 0;
+};
+
+/// Compares the regular files of two trees. Both trees are walked at once;
+/// files present on both sides are compared only if their sizes match, by
+/// reading both in lockstep chunks and stopping at the first chunk that
+/// differs. Prints "added:", "removed:" and "changed:" lines to stdout in
+/// path order. Returns false if either root cannot be read.
+bool runTreeDiff(const std::string& oldRoot, const std::string& newRoot,
+    const TreeDiffOptions& options, TreeDiffReport& report);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_TREEDIFF_HPP_INCLUDED_
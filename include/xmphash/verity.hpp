@@ -0,0 +1,47 @@
+#ifndef MJI_VERITY_HPP_INCLUDED_
+#define MJI_VERITY_HPP_INCLUDED_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <xmphash/membudget.hpp>
+#include <xmphash/xplat.hpp>
+
+/*******************************************************************************
+fs-verity digests:
+The algorithm "fsverity" is the file digest that fs-verity reports for a file
+hashed with SHA-256, 4096-byte blocks and no salt (the defaults of
+fsverity-utils). The file is split into 4096-byte blocks, the last one zero
+padded, and each block is hashed. Those hashes are packed 128 to a block, the
+last block zero padded, and hashed again, level by level, until a level fits
+in one block; the hash of that block is the root hash. A file of one block
+has no tree, and the hash of its data block is the root hash; an empty file
+has a root hash of all zeros. The file digest is the SHA-256 of a 256-byte
+descriptor holding the version (1), hash algorithm (1), log2 of the block
+size (12), salt size (0), the file size as a little-endian 64-bit integer and
+the root hash, with the rest zero.
+
+If the file has fs-verity enabled with these parameters, the kernel already
+knows the digest, and it is reported without reading the file. Otherwise the
+tree is computed from positional reads: each run of 128 data blocks, whose
+hashes fill one block of the first level, is hashed on its own, several runs
+at once, and the few levels above are hashed afterwards.
+*******************************************************************************/
+
+namespace mji::xmph {
+
+constexpr std::string_view fsverity_algo_name = "fsverity";
+
+/// Computes the fs-verity digest of an open file of the given size, asking
+/// the kernel first. Hashes with up to `threads` threads, charging the read
+/// buffers of all but the first to budget if it is not null (and using fewer
+/// threads if they do not fit). Returns an empty optional on a read or hasher
+/// failure.
+std::optional<std::string> computeFsVerityDigest(const mji::xplat::InFile& file,
+    std::uint64_t size, unsigned int threads, MemoryBudget* budget = nullptr);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_VERITY_HPP_INCLUDED_
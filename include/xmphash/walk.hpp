@@ -0,0 +1,33 @@
+#ifndef MJI_WALK_HPP_INCLUDED_
+#define MJI_WALK_HPP_INCLUDED_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <xmphash/pathfilter.hpp>
+
+namespace mji::xmph {
+
+struct WalkEntry {
+    /// Relative to the walk root, '/'-separated
+    std::string path;
+    std::uint64_t size;
+};
+
+/// Lists the regular files under root, recursively, sorted bytewise by path
+/// (the same order as a sorted manifest). Symbolic links are not followed or
+/// listed. If root is itself a regular file the result is that one file, with
+/// an empty path. Unreadable entries below the root are reported on stderr
+/// and skipped; returns false only if the root itself cannot be read. If a
+/// filter is given, only the files below the root that it keeps are listed,
+/// and directories it prunes are not read.
+bool walkTree(const std::string& root, std::vector<WalkEntry>& out,
+    const PathFilter* filter = nullptr);
+
+/// Joins a walk root and a relative path from walkTree
+std::string joinWalkPath(const std::string& root, const std::string& relPath);
+
+}  // namespace mji::xmph
+
+#endif  // MJI_WALK_HPP_INCLUDED_
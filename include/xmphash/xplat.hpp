@@ -1,10 +1,220 @@
 #ifndef MJI_XPLAT_HPP_INCLUDED_
 #define MJI_XPLAT_HPP_INCLUDED_
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace mji::xplat {
 
 bool reopenStdinAsBinary();
 
+/// Flushes the stream and waits until its data has reached the disk
+bool syncFile(std::FILE* fp);
+
+/// Seeks to an absolute offset, which may exceed the range of long
+bool seekFile(std::FILE* fp, std::uint64_t offset);
+
+/// Process-wide switch for low-impact input I/O: inputs are opened without
+/// updating their access times where permitted (O_NOATIME), and dropCache()
+/// releases the cached pages of data already hashed. Set before opening any
+/// inputs.
+void setLowImpactIo(bool enabled);
+
+/// Opens an input file as a stdio stream, in binary or text mode
+std::FILE* openInputStream(const char* path, bool binaryMode);
+
+/// In low-impact mode, advises the kernel that the range of the stream's file
+/// will not be needed again; otherwise does nothing
+void dropCache(std::FILE* fp, std::uint64_t offset, std::uint64_t length);
+
+/// The fraction (0-1) of the file's pages currently in the page cache, from
+/// cachestat(2) where the kernel has it and mincore(2) on a mapping
+/// otherwise. Empty if the file cannot be probed or the platform has no way
+/// to tell.
+std::optional<double> cachedFraction(const char* path);
+
+/// A run of a file stored contiguously on its device
+struct FileExtent {
+    std::uint64_t logical;
+    std::uint64_t physical;
+    std::uint64_t length;
+};
+
+/// Where a file's data lives. Two files with the same layout have the same
+/// content.
+struct FileLayout {
+    std::uint64_t device;
+    std::uint64_t size;
+    std::vector<FileExtent> extents;
+};
+
+/// The layout of a regular file whose data is entirely in extents shared
+/// with other files (reflink copies, snapshots), from FIEMAP after flushing
+/// pending writes. Empty if any extent is unshared or has no stable address
+/// (delayed allocation, compressed, inline or encrypted data, unwritten
+/// space), if the file has more than maxExtents extents, or if the platform
+/// cannot tell.
+std::optional<FileLayout> sharedLayout(const char* path, std::size_t maxExtents);
+
+/// Asks the kernel to start reading up to maxLength bytes from the start of
+/// the file into the page cache without waiting for them. Returns the number
+/// of bytes requested, or 0 if the file could not be opened or the platform
+/// has no way to do this.
+std::uint64_t prefetchFile(const char* path, std::uint64_t maxLength);
+
+/// Lowers the CPU and I/O scheduling priority of the process to the idle
+/// class (inherited by threads created afterwards). Prints a warning for each
+/// part that is not permitted and returns false if any failed.
+bool lowerProcessPriority();
+
+/// Cumulative microseconds during which some task stalled on the resource
+/// ("io", "cpu" or "memory"), from Linux pressure stall information. Empty
+/// if unavailable (older kernels, or other platforms).
+std::optional<std::uint64_t> pressureStallTotal(const char* resource);
+
+/// Size and alignment of the buffers returned by allocateLargePages
+constexpr std::size_t large_page_size = 2 << 20;
+
+/// Allocates size bytes (rounded up to a multiple of large_page_size),
+/// aligned to large_page_size so that they also satisfy the alignment rules
+/// of direct I/O. Explicit huge pages are used if any are reserved, then
+/// transparent huge pages where supported. Returns null on failure.
+void* allocateLargePages(std::size_t size);
+/// Frees memory from allocateLargePages; size is as passed to it
+void freeLargePages(void* p, std::size_t size);
+
+/// A read-only file opened in binary mode which supports positioned reads
+/// (pread on Linux, overlapped ReadFile on Windows). Positioned reads do not
+/// move a shared file offset, so they may be issued from several threads.
+class InFile final {
+public:
+    InFile();
+    ~InFile();
+
+    InFile(const InFile&) = delete;
+    InFile& operator=(const InFile&) = delete;
+    InFile(InFile&& other);
+    InFile& operator=(InFile&& other);
+
+    bool open(const char* path);
+    bool isOpen() const;
+    void close();
+
+    /// Returns an empty optional on failure
+    std::optional<std::uint64_t> size() const;
+
+    /// Reads up to count bytes starting at offset. The result is only short
+    /// at end of file. Returns -1 on error.
+    std::int64_t readAt(void* buf, std::size_t count, std::uint64_t offset) const;
+
+    /// Like xplat::dropCache, for a range of this file
+    void dropCache(std::uint64_t offset, std::uint64_t length) const;
+
+    /// The underlying descriptor or handle, for platform-specific calls
+#ifdef _WIN32
+    void* nativeHandle() const;
+#else
+    int nativeHandle() const;
+#endif
+
+private:
+#ifdef _WIN32
+    void* handle_;
+#else
+    int fd_;
+#endif
+};
+
+/// The kernel's fs-verity measurement of a file, and the parameters of its
+/// Merkle tree
+struct VerityMeasurement {
+    /// 1 for SHA-256, 2 for SHA-512
+    unsigned int hashAlgorithm;
+    unsigned int logBlockSize;
+    unsigned int saltSize;
+    std::vector<unsigned char> digest;
+};
+
+/// Empty unless the file has fs-verity enabled and the kernel can report
+/// both the digest and the tree parameters (Linux 5.12 and later)
+std::optional<VerityMeasurement> measureVerity(const InFile& file);
+
+/// Hashes a whole file with the kernel crypto API (AF_ALG sockets on Linux).
+/// The file's pages are spliced from the page cache into a pipe, teed to one
+/// pipe per algorithm and spliced on into its hash socket, so the data is
+/// never copied through user space. kernelNames are crypto API names such as
+/// "sha256"; digests receives the raw digest of each. beforeChunk(length) is
+/// called before each splice with the most it may move, and
+/// onChunk(offset, length) after each chunk has been hashed with what it did
+/// move. Returns the number of bytes hashed, or an empty optional if the
+/// kernel cannot hash this way (no AF_ALG, an unknown algorithm, an
+/// unspliceable file) or a read failed.
+std::optional<std::uint64_t> kernelHashFile(const InFile& file,
+    const std::vector<std::string>& kernelNames,
+    std::vector<std::vector<unsigned char>>& digests,
+    const std::function<void(std::size_t)>& beforeChunk,
+    const std::function<void(std::uint64_t, std::uint64_t)>& onChunk);
+/// Whether the kernel crypto API offers the named hash
+bool kernelHashSupported(const std::string& kernelName);
+
+/// Hardware events counted by PerfCounters, in this order
+enum class PerfEvent : unsigned char { cycles, instructions, cacheMisses, branchMisses };
+constexpr std::size_t perf_event_count = 4;
+
+/// Hardware performance counters of the calling thread, in user space only,
+/// opened as one group so that they are always scheduled together
+/// (perf_event_open on Linux). Must be read from the thread that opened it.
+class PerfCounters final {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /// Returns false with errno set if not even cycles can be counted.
+    /// Events the processor lacks are left out.
+    bool open();
+    /// Whether the event is being counted
+    bool counts(PerfEvent event) const;
+    /// Reads the counts so far, scaled up for any time the group was not on
+    /// the processor. Events not counted read as 0.
+    bool read(std::uint64_t (&values)[perf_event_count]) const;
+
+private:
+    /// The file descriptor of each event, or -1; cycles leads the group
+    int fds_[perf_event_count];
+    /// The events in the order the kernel reports them
+    PerfEvent order_[perf_event_count];
+    std::size_t opened_;
+};
+
+/// A read-only memory mapping of a whole file, advised for sequential access
+class MappedFile final {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// An empty file opens successfully with a null data pointer
+    bool open(const char* path);
+    void close();
+
+    const char* data() const;
+    std::size_t size() const;
+
+private:
+    const char* data_;
+    std::size_t size_;
+};
+
 }
 
 #endif  // MJI_XPLAT_HPP_INCLUDED_
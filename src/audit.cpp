@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <xmphash/audit.hpp>
+#include <xmphash/hasher.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/manifest.hpp>
+#include <xmphash/pressure.hpp>
+#include <xmphash/throttle.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr std::size_t auditReadSize = 1 << 20;
+
+/// The block digests recorded for one algorithm
+struct BlockField {
+    std::string algoName;
+    std::vector<std::string> digests;
+};
+
+/// A block chosen for verification
+struct SampledBlock {
+    std::uint64_t offset;
+    std::uint64_t length;
+    std::uint64_t blockSize;
+    std::uint64_t index;
+};
+
+bool digestsEqual(const std::string& a, const std::string& b) {
+    auto bytesA = strToBytes(a);
+    auto bytesB = strToBytes(b);
+    return bytesA && bytesB && *bytesA == *bytesB;
+}
+
+}  // namespace
+
+bool auditSelectsBlock(std::uint64_t pathKey, std::uint64_t blockSize,
+    std::uint64_t blockIndex, const AuditOptions& options)
+{
+    if (options.fraction >= 1.0) {
+        return true;
+    }
+    // 2^64 as a double; the product is always below it
+    auto threshold = static_cast<std::uint64_t>(options.fraction * 18446744073709551616.0);
+    std::uint64_t key = mix64(options.seed ^ mix64(pathKey ^ mix64(blockSize ^ mix64(blockIndex))));
+    return key < threshold;
+}
+
+double auditCorruptionBound(std::uint64_t sampledBlocks, double confidence) {
+    if (sampledBlocks == 0) {
+        return 1.0;
+    }
+    // P(no corrupt block drawn | corrupt fraction p) = (1 - p)^n
+    return 1.0 - std::pow(1.0 - confidence, 1.0 / static_cast<double>(sampledBlocks));
+}
+
+bool runAudit(const char* manifestPath, const AuditOptions& options, AuditReport& report) {
+    ManifestReader reader(options.terminator);
+    if (!reader.open(manifestPath)) {
+        std::fprintf(stderr, "Unable to open manifest \"%s\"\n", manifestPath);
+        return false;
+    }
+
+    std::map<std::string, std::unique_ptr<Hasher>> hashers;
+    auto readBuf = std::make_unique<unsigned char[]>(auditReadSize);
+
+    ManifestEntry entry;
+    while (reader.next(entry)) {
+        std::optional<std::uint64_t> expectedSize;
+        if (const std::string* sizeStr = entry.findField("size")) {
+            expectedSize = std::strtoull(sizeStr->c_str(), nullptr, 10);
+        }
+
+        std::map<std::uint64_t, std::vector<BlockField>> fieldsByBlockSize;
+        for (const auto& field : entry.fields) {
+            auto blockName = parseBlockFieldName(field.first);
+            if (!blockName) {
+                continue;
+            }
+            BlockField blockField;
+            blockField.algoName = blockName->first;
+            if (!field.second.empty()) {
+                blockField.digests = splitOnChar(field.second.c_str(), ':');
+            }
+            if (hashers.count(blockField.algoName) == 0) {
+                try {
+                    hashers[blockField.algoName] = makeHasher(blockField.algoName);
+                } catch (const std::invalid_argument& e) {
+                    std::fprintf(stderr, "%s\n", e.what());
+                    return false;
+                }
+            }
+            fieldsByBlockSize[blockName->second].push_back(std::move(blockField));
+        }
+        if (fieldsByBlockSize.empty()) {
+            continue;
+        }
+        report.files++;
+
+        // choose the sample up front so the reads can be issued in offset order
+        std::uint64_t pathKey = stableHash64(entry.path);
+        std::vector<SampledBlock> sample;
+        for (const auto& [blockSize, fields] : fieldsByBlockSize) {
+            std::size_t blockCount = 0;
+            for (const auto& field : fields) {
+                blockCount = std::max(blockCount, field.digests.size());
+            }
+            report.totalBlocks += blockCount;
+            for (std::size_t i = 0; i < blockCount; i++) {
+                if (!auditSelectsBlock(pathKey, blockSize, i, options)) {
+                    continue;
+                }
+                std::uint64_t offset = static_cast<std::uint64_t>(i) * blockSize;
+                std::uint64_t length = blockSize;
+                if (expectedSize) {
+                    length = std::min(blockSize, *expectedSize - std::min(*expectedSize, offset));
+                }
+                sample.push_back({offset, length, blockSize, i});
+            }
+        }
+        std::sort(sample.begin(), sample.end(),
+            [](const SampledBlock& a, const SampledBlock& b) {
+                return a.offset < b.offset || (a.offset == b.offset && a.blockSize < b.blockSize);
+            });
+        if (sample.empty()) {
+            continue;
+        }
+
+        mji::xplat::InFile file;
+        if (!file.open(entry.path.c_str())) {
+            std::printf("%s: FAILED open\n", entry.path.c_str());
+            report.failedFiles++;
+            continue;
+        }
+        auto actualSize = file.size();
+        if (expectedSize && actualSize != expectedSize) {
+            std::printf("%s: FAILED size\n", entry.path.c_str());
+            report.failedFiles++;
+            continue;
+        }
+
+        for (const SampledBlock& block : sample) {
+            const auto& fields = fieldsByBlockSize[block.blockSize];
+            for (const auto& field : fields) {
+                hashers[field.algoName]->reset();
+            }
+
+            bool readOk = true;
+            std::uint64_t done = 0;
+            while (done < block.length) {
+                auto want = static_cast<std::size_t>(
+                    std::min<std::uint64_t>(block.length - done, pressureReadSize(auditReadSize)));
+                std::int64_t got = throttledReadAt(file, readBuf.get(), want, block.offset + done);
+                if (got <= 0) {
+                    readOk = false;
+                    break;
+                }
+                for (const auto& field : fields) {
+                    hashers[field.algoName]->consume(readBuf.get(), static_cast<std::size_t>(got));
+                }
+                done += static_cast<std::uint64_t>(got);
+            }
+            file.dropCache(block.offset, done);
+            report.sampledBlocks++;
+            report.sampledBytes += done;
+
+            bool blockOk = readOk;
+            for (const auto& field : fields) {
+                if (block.index >= field.digests.size()) {
+                    continue;
+                }
+                auto digest = finalizeToStr(*hashers[field.algoName]);
+                if (!readOk || !digest || !digestsEqual(*digest, field.digests[block.index])) {
+                    std::printf("%s: FAILED block %llu offset %llu (%s@%llu)\n",
+                        entry.path.c_str(),
+                        static_cast<unsigned long long>(block.index),
+                        static_cast<unsigned long long>(block.offset),
+                        field.algoName.c_str(),
+                        static_cast<unsigned long long>(block.blockSize));
+                    blockOk = false;
+                }
+            }
+            if (!blockOk) {
+                report.failedBlocks++;
+            }
+        }
+    }
+
+    if (reader.failed()) {
+        std::fprintf(stderr, "Malformed manifest record %llu in \"%s\"\n",
+            static_cast<unsigned long long>(reader.recordNumber()), manifestPath);
+        return false;
+    }
+    return true;
+}
+
+void printAuditReport(const AuditReport& report, const AuditOptions& options) {
+    std::printf("audited %llu of %llu blocks (%llu bytes) in %llu files, seed %llu\n",
+        static_cast<unsigned long long>(report.sampledBlocks),
+        static_cast<unsigned long long>(report.totalBlocks),
+        static_cast<unsigned long long>(report.sampledBytes),
+        static_cast<unsigned long long>(report.files),
+        static_cast<unsigned long long>(options.seed));
+
+    if (report.failedBlocks == 0 && report.failedFiles == 0) {
+        double fraction95 = auditCorruptionBound(report.sampledBlocks, 0.95);
+        double fraction99 = auditCorruptionBound(report.sampledBlocks, 0.99);
+        std::printf("no failures; fraction of corrupt blocks is below %.4g%% "
+            "with 95%% confidence, below %.4g%% with 99%% confidence\n",
+            fraction95 * 100.0, fraction99 * 100.0);
+    } else {
+        std::printf("%llu blocks failed, %llu files failed\n",
+            static_cast<unsigned long long>(report.failedBlocks),
+            static_cast<unsigned long long>(report.failedFiles));
+        if (report.sampledBlocks != 0) {
+            double rate = static_cast<double>(report.failedBlocks)
+                / static_cast<double>(report.sampledBlocks);
+            std::printf("estimated corrupt block fraction %.4g%% (about %.0f blocks)\n",
+                rate * 100.0, rate * static_cast<double>(report.totalBlocks));
+        }
+    }
+}
+
+}  // namespace mji::xmph
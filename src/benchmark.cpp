@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <xmphash/benchmark.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/kcrypto.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Hashes the file through the stream, returning the seconds taken
+std::optional<double> timeStream(FileHasher& hasher, const std::string& path, FileDigests& out) {
+    errno = 0;
+    CFileWrapper inFile{mji::xplat::openInputStream(path.c_str(), true)};
+    if (inFile.fp == nullptr) {
+        std::fprintf(stderr, "%s: unable to open file: %s\n", path.c_str(), std::strerror(errno));
+        return {};
+    }
+    auto start = Clock::now();
+    if (!hasher.hashStream(inFile.fp, path.c_str(), out)) {
+        return {};
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Hashes the file through the kernel, returning the seconds taken, or an
+/// empty optional if the kernel could not
+std::optional<double> timeKernel(const std::vector<std::string>& kernelNames,
+    const std::string& path, std::vector<std::vector<unsigned char>>& digests)
+{
+    mji::xplat::InFile file;
+    if (!file.open(path.c_str())) {
+        return {};
+    }
+    auto start = Clock::now();
+    if (!mji::xplat::kernelHashFile(file, kernelNames, digests, [](std::size_t) {},
+        [](std::uint64_t, std::uint64_t) {}))
+    {
+        return {};
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double mibPerSecond(std::uint64_t size, double seconds) {
+    return seconds > 0.0 ? static_cast<double>(size) / (1 << 20) / seconds : 0.0;
+}
+
+}  // namespace
+
+bool runBenchmark(const std::vector<std::string>& algoNames,
+    const std::vector<std::string>& paths, const BenchmarkOptions& options,
+    std::vector<BenchmarkResult>& results)
+{
+    std::vector<std::unique_ptr<Hasher>> formatters;
+    try {
+        for (const auto& algoName : algoNames) {
+            formatters.push_back(makeHasher(algoName));
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return false;
+    }
+    FileHasher hasher(algoNames, 0);
+    if (hasher.hasPositional()) {
+        std::fprintf(stderr, "Only streaming algorithms can be benchmarked\n");
+        return false;
+    }
+    auto kernelNames = kernelHashNames(algoNames);
+    if (!kernelNames) {
+        std::fprintf(stderr, "Not every algorithm is offered by the kernel crypto API; "
+            "timing the stream only\n");
+    }
+
+    unsigned int rounds = std::max(options.rounds, 1u);
+    for (const auto& path : paths) {
+        BenchmarkResult result;
+        result.path = path;
+
+        // the first pass brings the file into the page cache
+        FileDigests streamDigests;
+        if (!timeStream(hasher, path, streamDigests)) {
+            return false;
+        }
+        result.size = streamDigests.size;
+        result.streamSeconds = -1.0;
+        for (unsigned int i = 0; i < rounds; i++) {
+            auto seconds = timeStream(hasher, path, streamDigests);
+            if (!seconds) {
+                return false;
+            }
+            if (result.streamSeconds < 0.0 || *seconds < result.streamSeconds) {
+                result.streamSeconds = *seconds;
+            }
+        }
+
+        std::vector<std::vector<unsigned char>> raw;
+        for (unsigned int i = 0; kernelNames && i < rounds; i++) {
+            auto seconds = timeKernel(*kernelNames, path, raw);
+            if (!seconds) {
+                result.kernelSeconds.reset();
+                break;
+            }
+            if (!result.kernelSeconds || *seconds < *result.kernelSeconds) {
+                result.kernelSeconds = seconds;
+            }
+        }
+        if (result.kernelSeconds) {
+            for (std::size_t i = 0; i < formatters.size(); i++) {
+                if (raw[i].size() != formatters[i]->getDigestSize()
+                    || formatters[i]->formatDigest(raw[i].data()) != streamDigests.digests[i])
+                {
+                    result.digestsMatch = false;
+                }
+            }
+        }
+        results.push_back(std::move(result));
+    }
+    return true;
+}
+
+void printBenchmarkReport(const std::vector<BenchmarkResult>& results) {
+    std::printf("%14s %14s %14s  %s\n", "bytes", "openssl MiB/s", "kernel MiB/s", "path");
+    for (const auto& result : results) {
+        std::printf("%14llu %14.1f ", static_cast<unsigned long long>(result.size),
+            mibPerSecond(result.size, result.streamSeconds));
+        if (result.kernelSeconds) {
+            std::printf("%14.1f", mibPerSecond(result.size, *result.kernelSeconds));
+        } else {
+            std::printf("%14s", "-");
+        }
+        std::printf("  %s%s\n", result.path.c_str(),
+            result.digestsMatch ? "" : " (DIGESTS DIFFER)");
+    }
+    bool anyKernel = std::any_of(results.begin(), results.end(),
+        [](const auto& result) { return result.kernelSeconds.has_value(); });
+    if (!results.empty() && !anyKernel) {
+        std::printf("The kernel crypto API (AF_ALG) could not hash these files on this host\n");
+    }
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,99 @@
+#include <vector>
+
+#include <xmphash/bufpool.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+/// Buffers kept per thread beyond those in use
+constexpr std::size_t max_free_buffers = 4;
+
+struct FreeList;
+
+// trivially destructible, so still readable while other thread-local
+// objects (such as a buffer held by one) are being destroyed
+thread_local FreeList* threadFreeList = nullptr;
+
+struct FreeList {
+    std::vector<unsigned char*> buffers;
+
+    FreeList()
+    : buffers()
+    {
+        // so that release(), which runs in destructors, never allocates
+        buffers.reserve(max_free_buffers);
+        threadFreeList = this;
+    }
+
+    ~FreeList() {
+        threadFreeList = nullptr;
+        for (unsigned char* buffer : buffers) {
+            mji::xplat::freeLargePages(buffer, pool_buffer_size);
+        }
+    }
+};
+
+FreeList& freeList() {
+    thread_local FreeList list;
+    return list;
+}
+
+}  // namespace
+
+PooledBuffer::PooledBuffer()
+: data_(nullptr)
+{}
+
+PooledBuffer::PooledBuffer(unsigned char* data)
+: data_(data)
+{}
+
+PooledBuffer::~PooledBuffer() {
+    release();
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other)
+: data_(other.data_)
+{
+    other.data_ = nullptr;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) {
+    if (this != &other) {
+        release();
+        data_ = other.data_;
+        other.data_ = nullptr;
+    }
+    return *this;
+}
+
+PooledBuffer PooledBuffer::acquire() {
+    FreeList& list = freeList();
+    if (!list.buffers.empty()) {
+        unsigned char* buffer = list.buffers.back();
+        list.buffers.pop_back();
+        return PooledBuffer(buffer);
+    }
+    void* buffer = mji::xplat::allocateLargePages(pool_buffer_size);
+    return PooledBuffer(static_cast<unsigned char*>(buffer));
+}
+
+unsigned char* PooledBuffer::data() const {
+    return data_;
+}
+
+void PooledBuffer::release() {
+    if (data_ == nullptr) {
+        return;
+    }
+    FreeList* list = threadFreeList;
+    if (list != nullptr && list->buffers.size() < max_free_buffers) {
+        list->buffers.push_back(data_);
+    } else {
+        mji::xplat::freeLargePages(data_, pool_buffer_size);
+    }
+    data_ = nullptr;
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include <xmphash/check.hpp>
+#include <xmphash/compress.hpp>
+#include <xmphash/dirhash.hpp>
+#include <xmphash/engine.hpp>
+#include <xmphash/hasher.hpp>
+#include <xmphash/manifest.hpp>
+#include <xmphash/pathindex.hpp>
+#include <xmphash/walk.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+/// Fields that describe a file but are not recomputed from its content
+bool isInformationalField(const std::string& name) {
+    return name == "size" || name == "known";
+}
+
+bool digestsEqual(const std::string& a, const std::string& b) {
+    if (a == b) {
+        return true;
+    }
+    // hex digests may differ in case
+    auto bytesA = strToBytes(a);
+    auto bytesB = strToBytes(b);
+    return bytesA && bytesB && *bytesA == *bytesB;
+}
+
+/// Collects every algorithm named by the records, and the first block size
+void collectAlgorithms(const std::vector<ManifestEntry>& entries,
+    std::vector<std::string>& algoNames, std::uint64_t& blockSize)
+{
+    for (const auto& entry : entries) {
+        for (const auto& field : entry.fields) {
+            if (isInformationalField(field.first)) {
+                continue;
+            }
+            std::string algoName = field.first;
+            if (auto block = parseBlockFieldName(field.first)) {
+                if (blockSize == 0) {
+                    blockSize = block->second;
+                }
+                algoName = block->first;
+            }
+            if (std::find(algoNames.begin(), algoNames.end(), algoName) == algoNames.end()) {
+                algoNames.push_back(std::move(algoName));
+            }
+        }
+    }
+}
+
+/// Whether every recomputed field matches the record. Fields that were not
+/// recomputed (block digests of another block size) are skipped.
+bool entryMatches(const ManifestEntry& expected, const ManifestEntry& actual) {
+    std::size_t compared = 0;
+    for (const auto& field : expected.fields) {
+        if (field.first == "known") {
+            continue;
+        }
+        const std::string* value = actual.findField(field.first);
+        if (value == nullptr) {
+            continue;
+        }
+        if (!digestsEqual(field.second, *value)) {
+            return false;
+        }
+        if (field.first != "size") {
+            compared++;
+        }
+    }
+    return compared > 0;
+}
+
+/// Whether the record is a directory digest from --dirhash
+bool isDirRecord(const ManifestEntry& entry) {
+    return std::any_of(entry.fields.begin(), entry.fields.end(), [](const auto& field) {
+        return field.first.compare(0, dirhash_field_prefix.size(), dirhash_field_prefix) == 0;
+    });
+}
+
+/// Whether path is dir or lies below it. "." is the directory of every
+/// relative path.
+bool isBelowDir(const std::string& path, const std::string& dir) {
+    return dir == "." || path == dir
+        || (path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0
+            && path[dir.size()] == '/');
+}
+
+/// Checks the records of --dirhash by recomputing the digests of the
+/// directories they name. Each algorithm's topmost directories are hashed
+/// once, which gives the digests of everything below them too.
+void checkDirRecords(const std::vector<ManifestEntry>& entries, const CheckOptions& options,
+    CheckReport& report)
+{
+    std::vector<std::string> algoNames;
+    for (const auto& entry : entries) {
+        for (const auto& field : entry.fields) {
+            std::string_view name(field.first);
+            if (name.compare(0, dirhash_field_prefix.size(), dirhash_field_prefix) == 0) {
+                std::string algoName(name.substr(dirhash_field_prefix.size()));
+                if (std::find(algoNames.begin(), algoNames.end(), algoName) == algoNames.end()) {
+                    algoNames.push_back(std::move(algoName));
+                }
+            }
+        }
+    }
+
+    // recomputed digests, by field name and then path
+    std::map<std::string, std::map<std::string, DirDigest>> computed;
+    // directories which could not be hashed, by field name
+    std::map<std::string, std::vector<std::string>> unreadable;
+    for (const auto& algoName : algoNames) {
+        std::string fieldName = std::string(dirhash_field_prefix) + algoName;
+        std::vector<std::string> dirs;
+        for (const auto& entry : entries) {
+            if (entry.findField(fieldName) != nullptr) {
+                dirs.push_back(entry.path);
+            }
+        }
+        std::sort(dirs.begin(), dirs.end());
+        // "." sorts before the relative paths it contains
+        auto dot = std::find(dirs.begin(), dirs.end(), ".");
+        if (dot != dirs.end()) {
+            std::rotate(dirs.begin(), dot, dot + 1);
+        }
+
+        DirHashOptions dirOptions;
+        dirOptions.algoName = algoName;
+        dirOptions.engine.jobs = options.jobs;
+        dirOptions.engine.memoryBudget = options.memoryBudget;
+        dirOptions.engine.prefetch = options.prefetch;
+        dirOptions.engine.cacheFirst = options.cacheFirst;
+        dirOptions.filter = options.filter;
+        std::vector<std::string> tops;
+        for (const auto& dir : dirs) {
+            if (std::any_of(tops.begin(), tops.end(),
+                [&](const std::string& top) { return isBelowDir(dir, top); }))
+            {
+                continue;
+            }
+            const std::string& top = tops.emplace_back(dir);
+            std::vector<DirDigest> digests;
+            if (!computeDirHash(top, dirOptions, digests)) {
+                unreadable[fieldName].push_back(top);
+                continue;
+            }
+            for (auto& digest : digests) {
+                std::string path = digest.path.empty() ? top
+                    : (top == "." ? digest.path : joinWalkPath(top, digest.path));
+                computed[fieldName][path] = std::move(digest);
+            }
+        }
+    }
+
+    for (const auto& entry : entries) {
+        bool matches = true;
+        bool readable = true;
+        for (const auto& field : entry.fields) {
+            std::string_view name(field.first);
+            if (name.compare(0, dirhash_field_prefix.size(), dirhash_field_prefix) != 0) {
+                continue;
+            }
+            const auto& dirs = computed[field.first];
+            auto found = dirs.find(entry.path);
+            if (found == dirs.end()) {
+                const auto& failed = unreadable[field.first];
+                readable = readable && std::none_of(failed.begin(), failed.end(),
+                    [&](const std::string& dir) { return isBelowDir(entry.path, dir); });
+                matches = false;
+                continue;
+            }
+            const std::string* files = entry.findField("files");
+            const std::string* size = entry.findField("size");
+            matches = matches && digestsEqual(field.second, found->second.digest)
+                && (files == nullptr || *files == std::to_string(found->second.files))
+                && (size == nullptr || *size == std::to_string(found->second.bytes));
+        }
+        if (!readable) {
+            std::printf("%s: FAILED open or read\n", entry.path.c_str());
+            report.errors++;
+        } else if (matches) {
+            std::printf("%s: OK\n", entry.path.c_str());
+            report.ok++;
+        } else {
+            std::printf("%s: FAILED\n", entry.path.c_str());
+            report.failed++;
+        }
+    }
+}
+
+/// Whether the record lies below one of the walk roots but the filter does
+/// not keep it, so that the walk could not have found it
+bool filteredOut(const ManifestEntry& entry, const std::vector<std::string>& roots,
+    const PathFilter* filter)
+{
+    if (filter == nullptr) {
+        return false;
+    }
+    const std::string* sizeField = entry.findField("size");
+    std::uint64_t size = sizeField != nullptr ? std::strtoull(sizeField->c_str(), nullptr, 10) : 0;
+    for (const auto& root : roots) {
+        // the root as it begins the paths below it
+        std::string prefix = joinWalkPath(root, "x");
+        prefix.pop_back();
+        if (entry.path.size() > prefix.size()
+            && entry.path.compare(0, prefix.size(), prefix) == 0
+            && !filter->keepsPath(std::string_view(entry.path).substr(prefix.size()), size))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+bool runCheck(const char* manifestPath, const std::vector<std::string>& roots,
+    const CheckOptions& options, CheckReport& report)
+{
+    std::vector<ManifestEntry> entries;
+    if (options.jobs > 1 && std::strcmp(manifestPath, "-") != 0
+        && compressionSupported() && isCompressedFile(manifestPath))
+    {
+        // independent frames are decompressed and parsed in parallel
+        std::uint64_t badRecord = 0;
+        if (!readCompressedManifest(manifestPath, options.terminator, options.jobs,
+            entries, badRecord))
+        {
+            if (badRecord != 0) {
+                std::fprintf(stderr, "%s: unreadable record %llu\n", manifestPath,
+                    static_cast<unsigned long long>(badRecord));
+            }
+            return false;
+        }
+    } else {
+        ManifestReader reader(options.terminator);
+        if (!reader.open(manifestPath)) {
+            std::fprintf(stderr, "Unable to open manifest \"%s\"\n", manifestPath);
+            return false;
+        }
+        ManifestEntry entry;
+        while (reader.next(entry)) {
+            entries.push_back(std::move(entry));
+        }
+        if (reader.failed()) {
+            std::fprintf(stderr, "%s: unreadable record %llu\n", manifestPath,
+                static_cast<unsigned long long>(reader.recordNumber()));
+            return false;
+        }
+    }
+
+    // directory records are checked apart from the files
+    auto firstDir = std::stable_partition(entries.begin(), entries.end(),
+        [](const ManifestEntry& entry) { return !isDirRecord(entry); });
+    std::vector<ManifestEntry> dirEntries(std::make_move_iterator(firstDir),
+        std::make_move_iterator(entries.end()));
+    entries.erase(firstDir, entries.end());
+
+    HashEngineOptions engineOptions;
+    collectAlgorithms(entries, engineOptions.algoNames, engineOptions.blockSize);
+    if (engineOptions.algoNames.empty() && dirEntries.empty()) {
+        std::fprintf(stderr, "%s: no digests to check\n", manifestPath);
+        return false;
+    }
+    checkDirRecords(dirEntries, options, report);
+    if (entries.empty()) {
+        return true;
+    }
+    engineOptions.fingerprintParams = options.fingerprintParams;
+    engineOptions.binaryMode = options.binaryMode;
+    engineOptions.jobs = options.jobs;
+    engineOptions.memoryBudget = options.memoryBudget;
+    engineOptions.prefetch = options.prefetch;
+    engineOptions.cacheFirst = options.cacheFirst;
+    engineOptions.reuseSharedExtents = options.reuseSharedExtents;
+    std::optional<HashEngine> engine;
+    try {
+        engine.emplace(engineOptions);
+    } catch (const std::invalid_argument& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return false;
+    }
+
+    // the files to hash, and the record each is checked against
+    std::vector<std::string> paths;
+    std::vector<std::size_t> entryIdx;
+    if (roots.empty()) {
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            paths.push_back(entries[i].path);
+            entryIdx.push_back(i);
+        }
+    } else {
+        std::vector<std::string> entryPaths;
+        entryPaths.reserve(entries.size());
+        for (const auto& e : entries) {
+            entryPaths.push_back(e.path);
+        }
+        PathIndex index;
+        std::string duplicate;
+        switch (index.build(std::move(entryPaths), &duplicate)) {
+        case PathIndex::BuildResult::ok:
+            break;
+        case PathIndex::BuildResult::duplicatePath:
+            std::fprintf(stderr, "%s: \"%s\" is listed more than once\n", manifestPath,
+                duplicate.c_str());
+            return false;
+        case PathIndex::BuildResult::tooManyPaths:
+            std::fprintf(stderr, "%s: too many paths to index (%llu)\n", manifestPath,
+                static_cast<unsigned long long>(entries.size()));
+            return false;
+        case PathIndex::BuildResult::unplaceable:
+            std::fprintf(stderr, "%s: unable to build a perfect hash index of %llu paths\n",
+                manifestPath, static_cast<unsigned long long>(entries.size()));
+            return false;
+        }
+
+        std::vector<bool> seen(entries.size(), false);
+        for (const auto& root : roots) {
+            std::vector<WalkEntry> walked;
+            if (!walkTree(root, walked, options.filter)) {
+                report.errors++;
+                continue;
+            }
+            for (const auto& walkEntry : walked) {
+                std::string path = joinWalkPath(root, walkEntry.path);
+                std::size_t idx = index.find(path);
+                if (idx == PathIndex::npos) {
+                    std::printf("%s: NOT LISTED\n", path.c_str());
+                    report.unlisted++;
+                } else if (!seen[idx]) {
+                    seen[idx] = true;
+                    paths.push_back(std::move(path));
+                    entryIdx.push_back(idx);
+                }
+            }
+        }
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            if (!seen[i] && !filteredOut(entries[i], roots, options.filter)) {
+                std::printf("%s: MISSING\n", entries[i].path.c_str());
+                report.missing++;
+            }
+        }
+    }
+
+    // the sink never stops the run, so it only fails if the memory budget
+    // cannot hold a worker
+    return engine->run(paths, [&](std::size_t idx, HashResult& result) {
+        const ManifestEntry& expected = entries[entryIdx[idx]];
+        if (!result.ok) {
+            std::printf("%s: FAILED open or read\n", paths[idx].c_str());
+            report.errors++;
+        } else if (entryMatches(expected,
+            toManifestEntry(engineOptions.algoNames, engineOptions.blockSize, result.digests,
+                std::string())))
+        {
+            std::printf("%s: OK\n", paths[idx].c_str());
+            report.ok++;
+        } else {
+            std::printf("%s: FAILED\n", paths[idx].c_str());
+            report.failed++;
+        }
+        return true;
+    });
+}
+
+}  // namespace mji::xmph
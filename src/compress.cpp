@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#ifdef XMPHASH_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <xmphash/compress.hpp>
+#include <xmphash/engine.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr unsigned char zstd_magic[4] = {0x28, 0xb5, 0x2f, 0xfd};
+
+}  // namespace
+
+#ifdef XMPHASH_WITH_ZSTD
+
+namespace {
+
+/// The records of a run of whole records, parsed
+struct ParsedRun {
+    std::vector<ManifestEntry> entries;
+    /// Records seen, comments and blank records included
+    std::uint64_t records = 0;
+    /// 1-based within the run; 0 if every record parsed
+    std::uint64_t badRecord = 0;
+};
+
+/// Parses text made of whole records, the last of which may lack its
+/// terminator. Skips comments and blank records as ManifestReader does.
+void parseRun(std::string_view text, char terminator, ParsedRun& out) {
+    while (!text.empty()) {
+        std::size_t end = text.find(terminator);
+        std::string_view record = text.substr(0, end);
+        text.remove_prefix((end == std::string_view::npos) ? text.size() : end + 1);
+        out.records++;
+        if (record.empty() || record[0] == '#') {
+            continue;
+        }
+        if (terminator == '\n' && record.back() == '\r') {
+            record.remove_suffix(1);
+        }
+        auto parsed = parseManifestRecord(record);
+        if (!parsed) {
+            out.badRecord = out.records;
+            return;
+        }
+        out.entries.push_back(std::move(*parsed));
+    }
+}
+
+}  // namespace
+
+bool compressionSupported() {
+    return true;
+}
+
+// FrameCompressor
+
+FrameCompressor::FrameCompressor(std::FILE* out, int level)
+: out_(out),
+  level_(level),
+  mutex_(),
+  changed_(),
+  queue_(),
+  finishing_(false),
+  failed_(false),
+  thread_([this] { run(); })
+{}
+
+FrameCompressor::~FrameCompressor() {
+    finish();
+}
+
+bool FrameCompressor::write(std::string content) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return queue_.size() < max_queued_frames || failed_; });
+    if (failed_ || finishing_) {
+        return false;
+    }
+    queue_.push_back(std::move(content));
+    changed_.notify_all();
+    return true;
+}
+
+bool FrameCompressor::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    return !failed_ && std::fflush(out_) == 0;
+}
+
+void FrameCompressor::run() {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    bool ok = cctx != nullptr
+        && !ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level_));
+    std::string frame;
+    while (ok) {
+        std::string content;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] { return !queue_.empty() || finishing_; });
+            if (queue_.empty()) {
+                break;
+            }
+            content = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        // the writer may be waiting for room
+        changed_.notify_all();
+
+        frame.resize(ZSTD_compressBound(content.size()));
+        std::size_t size = ZSTD_compress2(cctx, frame.data(), frame.size(),
+            content.data(), content.size());
+        if (ZSTD_isError(size)) {
+            std::fprintf(stderr, "Unable to compress manifest: %s\n", ZSTD_getErrorName(size));
+            ok = false;
+        } else if (std::fwrite(frame.data(), 1, size, out_) != size) {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed_ = true;
+        queue_.clear();
+    }
+    changed_.notify_all();
+    ZSTD_freeCCtx(cctx);
+}
+
+// StreamDecompressor
+
+struct StreamDecompressor::Context {
+    ZSTD_DCtx* dctx = nullptr;
+    /// The last result of ZSTD_decompressStream; 0 when a frame is complete
+    std::size_t lastResult = 0;
+};
+
+StreamDecompressor::StreamDecompressor()
+: context_(std::make_unique<Context>()),
+  in_(),
+  inPos_(0),
+  inputEnded_(false)
+{
+    context_->dctx = ZSTD_createDCtx();
+}
+
+StreamDecompressor::~StreamDecompressor() {
+    ZSTD_freeDCtx(context_->dctx);
+}
+
+void StreamDecompressor::prime(const char* data, std::size_t size) {
+    in_.insert(in_.end(), data, data + size);
+}
+
+std::int64_t StreamDecompressor::read(std::FILE* fp, char* buf, std::size_t size) {
+    if (context_->dctx == nullptr) {
+        return -1;
+    }
+    for (;;) {
+        if (inPos_ == in_.size() && !inputEnded_) {
+            in_.resize(ZSTD_DStreamInSize());
+            in_.resize(std::fread(in_.data(), 1, in_.size(), fp));
+            inPos_ = 0;
+            if (in_.empty()) {
+                if (std::ferror(fp)) {
+                    return -1;
+                }
+                inputEnded_ = true;
+            }
+        }
+
+        bool inputLeft = inPos_ < in_.size();
+        if (!inputLeft && context_->lastResult == 0) {
+            // between frames, so the stream may end here
+            return 0;
+        }
+
+        ZSTD_inBuffer in = {in_.data(), in_.size(), inPos_};
+        ZSTD_outBuffer out = {buf, size, 0};
+        // with no input left, this still flushes what the context holds
+        std::size_t result = ZSTD_decompressStream(context_->dctx, &out, &in);
+        inPos_ = in.pos;
+        if (ZSTD_isError(result)) {
+            std::fprintf(stderr, "Corrupt compressed manifest: %s\n", ZSTD_getErrorName(result));
+            return -1;
+        }
+        context_->lastResult = result;
+        if (out.pos != 0) {
+            return static_cast<std::int64_t>(out.pos);
+        }
+        if (!inputLeft && inputEnded_) {
+            std::fprintf(stderr, "Compressed manifest is truncated\n");
+            return -1;
+        }
+    }
+}
+
+bool decompressManifest(const char* data, std::size_t size, std::string& out) {
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    if (dctx == nullptr) {
+        return false;
+    }
+    ZSTD_inBuffer in = {data, size, 0};
+    std::size_t result = 0;
+    out.clear();
+    while (in.pos < in.size || result != 0) {
+        std::size_t done = out.size();
+        out.resize(done + ZSTD_DStreamOutSize());
+        ZSTD_outBuffer buf = {out.data() + done, out.size() - done, 0};
+        result = ZSTD_decompressStream(dctx, &buf, &in);
+        out.resize(done + buf.pos);
+        if (ZSTD_isError(result)) {
+            std::fprintf(stderr, "Corrupt compressed manifest: %s\n", ZSTD_getErrorName(result));
+            break;
+        }
+        if (in.pos == in.size && buf.pos == 0 && result != 0) {
+            std::fprintf(stderr, "Compressed manifest is truncated\n");
+            result = 1;
+            break;
+        }
+    }
+    ZSTD_freeDCtx(dctx);
+    return !ZSTD_isError(result) && result == 0;
+}
+
+bool readCompressedManifest(const char* path, char terminator, unsigned int jobs,
+    std::vector<ManifestEntry>& entries, std::uint64_t& badRecord)
+{
+    badRecord = 0;
+    xplat::MappedFile file;
+    if (!file.open(path)) {
+        std::fprintf(stderr, "Unable to open manifest \"%s\"\n", path);
+        return false;
+    }
+
+    // each frame is decompressed on its own, a batch at a time, to bound
+    // how much decompressed text is held at once
+    const std::size_t batchSize = std::max<std::size_t>(4 * jobs, 1);
+    std::vector<std::string_view> frames;
+    std::vector<std::string> texts;
+    std::vector<ParsedRun> runs;
+    std::string carry;
+    std::uint64_t recordBase = 0;
+    std::size_t pos = 0;
+    while (pos < file.size() || !carry.empty()) {
+        frames.clear();
+        while (pos < file.size() && frames.size() < batchSize) {
+            std::size_t frameSize = ZSTD_findFrameCompressedSize(file.data() + pos, file.size() - pos);
+            if (ZSTD_isError(frameSize)) {
+                std::fprintf(stderr, "%s: corrupt compressed manifest: %s\n",
+                    path, ZSTD_getErrorName(frameSize));
+                return false;
+            }
+            frames.emplace_back(file.data() + pos, frameSize);
+            pos += frameSize;
+        }
+
+        texts.assign(frames.size(), std::string());
+        std::vector<char> decoded(frames.size(), 0);
+        runParallel(frames.size(), jobs, [&](std::size_t idx, unsigned int) {
+            decoded[idx] = decompressManifest(frames[idx].data(), frames[idx].size(), texts[idx]);
+        });
+        for (char ok : decoded) {
+            if (!ok) {
+                std::fprintf(stderr, "%s: unable to decompress manifest\n", path);
+                return false;
+            }
+        }
+
+        // move each frame's trailing partial record to the front of the next
+        for (std::string& text : texts) {
+            std::size_t last = text.rfind(terminator);
+            std::string tail;
+            if (last == std::string::npos) {
+                carry += text;
+                text.clear();
+                continue;
+            }
+            tail.assign(text, last + 1, std::string::npos);
+            text.resize(last + 1);
+            text.insert(0, carry);
+            carry = std::move(tail);
+        }
+        if (pos == file.size() && !carry.empty()) {
+            texts.push_back(std::move(carry));
+            carry.clear();
+        }
+
+        runs.assign(texts.size(), ParsedRun());
+        runParallel(texts.size(), jobs, [&](std::size_t idx, unsigned int) {
+            parseRun(texts[idx], terminator, runs[idx]);
+        });
+        for (auto& run : runs) {
+            if (run.badRecord != 0) {
+                badRecord = recordBase + run.badRecord;
+                return false;
+            }
+            recordBase += run.records;
+            std::move(run.entries.begin(), run.entries.end(), std::back_inserter(entries));
+        }
+    }
+    return true;
+}
+
+#else  // XMPHASH_WITH_ZSTD
+
+namespace {
+
+void reportUnsupported() {
+    std::fprintf(stderr, "Compressed manifests are not supported (built without zstd)\n");
+}
+
+}  // namespace
+
+bool compressionSupported() {
+    return false;
+}
+
+FrameCompressor::FrameCompressor(std::FILE* out, int level)
+: out_(out),
+  level_(level),
+  mutex_(),
+  changed_(),
+  queue_(),
+  finishing_(false),
+  failed_(true),
+  thread_()
+{}
+
+FrameCompressor::~FrameCompressor() = default;
+
+bool FrameCompressor::write(std::string) {
+    reportUnsupported();
+    return false;
+}
+
+bool FrameCompressor::finish() {
+    return false;
+}
+
+void FrameCompressor::run() {}
+
+struct StreamDecompressor::Context {};
+
+StreamDecompressor::StreamDecompressor()
+: context_(),
+  in_(),
+  inPos_(0),
+  inputEnded_(false)
+{}
+
+StreamDecompressor::~StreamDecompressor() = default;
+
+void StreamDecompressor::prime(const char*, std::size_t) {}
+
+std::int64_t StreamDecompressor::read(std::FILE*, char*, std::size_t) {
+    reportUnsupported();
+    return -1;
+}
+
+bool decompressManifest(const char*, std::size_t, std::string&) {
+    reportUnsupported();
+    return false;
+}
+
+bool readCompressedManifest(const char*, char, unsigned int,
+    std::vector<ManifestEntry>&, std::uint64_t& badRecord)
+{
+    badRecord = 0;
+    reportUnsupported();
+    return false;
+}
+
+#endif  // XMPHASH_WITH_ZSTD
+
+bool isCompressed(const void* data, std::size_t size) {
+    return size >= sizeof(zstd_magic) && std::memcmp(data, zstd_magic, sizeof(zstd_magic)) == 0;
+}
+
+bool isCompressedFile(const char* path) {
+    std::FILE* fp = std::fopen(path, "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    unsigned char magic[sizeof(zstd_magic)];
+    std::size_t got = std::fread(magic, 1, sizeof(magic), fp);
+    std::fclose(fp);
+    return isCompressed(magic, got);
+}
+
+}  // namespace mji::xmph
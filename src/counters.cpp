@@ -0,0 +1,193 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <xmphash/counters.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+using mji::xplat::PerfEvent;
+using mji::xplat::perf_event_count;
+
+struct AlgoTotals {
+    std::string algoName;
+    std::uint64_t bytes = 0;
+    std::uint64_t values[perf_event_count] = {};
+};
+
+/// What one thread counted, kept after the thread exits
+struct ThreadTotals {
+    std::vector<AlgoTotals> algos;
+    bool counts[perf_event_count] = {};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadTotals>> threads;
+    std::atomic<bool> enabled{false};
+    /// Why counters could not be opened, from the first thread to fail
+    std::atomic<bool> failureReported{false};
+    std::string failure;
+};
+
+Registry registry;
+
+/// The calling thread's counters, opened on first use and closed as the
+/// thread exits
+struct ThreadCounters {
+    mji::xplat::PerfCounters perf;
+    bool tried = false;
+    ThreadTotals* totals = nullptr;
+
+    bool ready() {
+        if (!tried) {
+            tried = true;
+            if (perf.open()) {
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                registry.threads.push_back(std::make_unique<ThreadTotals>());
+                totals = registry.threads.back().get();
+                for (std::size_t i = 0; i < perf_event_count; i++) {
+                    totals->counts[i] = perf.counts(static_cast<PerfEvent>(i));
+                }
+            } else {
+                reportFailure(errno);
+            }
+        }
+        return totals != nullptr;
+    }
+
+    static void reportFailure(int error) {
+        if (registry.failureReported.exchange(true)) {
+            return;
+        }
+        std::string reason = std::strerror(error);
+        if (error == EACCES || error == EPERM) {
+            reason += "; see kernel.perf_event_paranoid";
+        } else if (error == ENOENT || error == EOPNOTSUPP || error == ENODEV) {
+            reason += "; no hardware counters (virtual machine?)";
+        }
+        std::fprintf(stderr, "Hardware counters are not available (%s); --counters ignored\n",
+            reason.c_str());
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.failure = std::move(reason);
+    }
+};
+
+thread_local ThreadCounters threadCounters;
+
+AlgoTotals& totalsFor(ThreadTotals& totals, const char* algoName) {
+    for (auto& algo : totals.algos) {
+        if (algo.algoName == algoName) {
+            return algo;
+        }
+    }
+    totals.algos.emplace_back();
+    totals.algos.back().algoName = algoName;
+    return totals.algos.back();
+}
+
+/// Formats count / per, or "-" if the event was not counted
+std::string formatRatio(bool counted, std::uint64_t count, double per) {
+    if (!counted || per <= 0.0) {
+        return "-";
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(count) / per);
+    return buf;
+}
+
+}  // namespace
+
+void setCounterTracking(bool enabled) {
+    registry.enabled = enabled;
+}
+
+bool counterTracking() {
+    return registry.enabled.load(std::memory_order_relaxed);
+}
+
+// CountedSection
+
+CountedSection::CountedSection(const char* algoName, std::size_t bytes)
+: algoName_(algoName),
+  bytes_(bytes),
+  active_(counterTracking() && threadCounters.ready()),
+  start_()
+{
+    if (active_) {
+        active_ = threadCounters.perf.read(start_);
+    }
+}
+
+CountedSection::~CountedSection() {
+    if (!active_) {
+        return;
+    }
+    std::uint64_t end[perf_event_count];
+    if (!threadCounters.perf.read(end)) {
+        return;
+    }
+    // only this thread writes its totals while work is in progress
+    AlgoTotals& algo = totalsFor(*threadCounters.totals, algoName_);
+    algo.bytes += bytes_;
+    for (std::size_t i = 0; i < perf_event_count; i++) {
+        // scaling may make a later estimate slightly smaller
+        algo.values[i] += (end[i] > start_[i]) ? end[i] - start_[i] : 0;
+    }
+}
+
+void printCounterReport(std::FILE* out) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.threads.empty()) {
+        std::fprintf(out, "hardware counters: nothing counted%s%s\n",
+            registry.failure.empty() ? "" : ": ", registry.failure.c_str());
+        return;
+    }
+
+    ThreadTotals merged;
+    for (std::size_t i = 0; i < perf_event_count; i++) {
+        merged.counts[i] = true;
+    }
+    for (const auto& thread : registry.threads) {
+        for (std::size_t i = 0; i < perf_event_count; i++) {
+            merged.counts[i] = merged.counts[i] && thread->counts[i];
+        }
+        for (const auto& algo : thread->algos) {
+            AlgoTotals& into = totalsFor(merged, algo.algoName.c_str());
+            into.bytes += algo.bytes;
+            for (std::size_t i = 0; i < perf_event_count; i++) {
+                into.values[i] += algo.values[i];
+            }
+        }
+    }
+
+    const bool* counts = merged.counts;
+    auto idx = [](PerfEvent event) { return static_cast<std::size_t>(event); };
+    std::fprintf(out, "hardware counters (user space) on %zu thread%s:\n",
+        registry.threads.size(), registry.threads.size() == 1 ? "" : "s");
+    std::fprintf(out, "  %-12s %14s %10s %10s %7s %15s %16s\n", "algorithm", "bytes",
+        "cycles/B", "instr/B", "IPC", "cache-miss/KiB", "branch-miss/KiB");
+    for (const auto& algo : merged.algos) {
+        auto bytes = static_cast<double>(algo.bytes);
+        std::uint64_t cycles = algo.values[idx(PerfEvent::cycles)];
+        std::fprintf(out, "  %-12s %14llu %10s %10s %7s %15s %16s\n", algo.algoName.c_str(),
+            static_cast<unsigned long long>(algo.bytes),
+            formatRatio(counts[idx(PerfEvent::cycles)], cycles, bytes).c_str(),
+            formatRatio(counts[idx(PerfEvent::instructions)],
+                algo.values[idx(PerfEvent::instructions)], bytes).c_str(),
+            formatRatio(counts[idx(PerfEvent::instructions)],
+                algo.values[idx(PerfEvent::instructions)], static_cast<double>(cycles)).c_str(),
+            formatRatio(counts[idx(PerfEvent::cacheMisses)],
+                algo.values[idx(PerfEvent::cacheMisses)], bytes / 1024).c_str(),
+            formatRatio(counts[idx(PerfEvent::branchMisses)],
+                algo.values[idx(PerfEvent::branchMisses)], bytes / 1024).c_str());
+    }
+}
+
+}  // namespace mji::xmph
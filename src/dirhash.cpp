@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include <xmphash/dirhash.hpp>
+#include <xmphash/gitobj.hpp>
+#include <xmphash/walk.hpp>
+
+namespace fs = std::filesystem;
+
+namespace mji::xmph {
+
+namespace {
+
+struct DirEntry {
+    std::string name;
+    char type;
+    unsigned int mode;
+    /// Index into the file list for 'f', the directory list for 'd'
+    std::size_t index;
+    /// Link target for 'l'
+    std::string target;
+};
+
+struct Dir {
+    std::string path;
+    std::vector<DirEntry> entries;
+};
+
+/// Lists the tree in pre-order, so that every directory comes before its
+/// subdirectories
+class TreeLister final {
+public:
+    TreeLister(const std::string& root, bool skipGitDirs, const PathFilter* filter,
+        std::vector<Dir>& dirs, std::vector<std::string>& files)
+    : root_(root),
+      skipGitDirs_(skipGitDirs),
+      filter_(filter),
+      dirs_(dirs),
+      files_(files)
+    {}
+
+    bool list(const fs::path& dir, const std::string& relDir, PathFilter::Cursor cursor) {
+        std::size_t dirIdx = dirs_.size();
+        dirs_.push_back({relDir, {}});
+
+        std::error_code ec;
+        fs::directory_iterator it(dir, ec);
+        if (ec) {
+            std::fprintf(stderr, "%s: unable to read directory: %s\n",
+                dir.string().c_str(), ec.message().c_str());
+            return false;
+        }
+        std::vector<std::pair<fs::path, std::string>> subdirs;
+        std::vector<PathFilter::Cursor> subdirCursors;
+        for (; it != fs::directory_iterator(); it.increment(ec)) {
+            if (ec) {
+                std::fprintf(stderr, "%s: error while reading directory: %s\n",
+                    dir.string().c_str(), ec.message().c_str());
+                return false;
+            }
+            const fs::path& path = it->path();
+            std::string name = path.filename().generic_string();
+            std::string relPath = relDir.empty() ? name : relDir + "/" + name;
+            fs::file_status status = it->symlink_status(ec);
+            if (ec) {
+                std::fprintf(stderr, "%s: unable to stat: %s\n", path.string().c_str(),
+                    ec.message().c_str());
+                return false;
+            }
+
+            PathFilter::Cursor entryCursor = cursor;
+            if (filter_ != nullptr) {
+                entryCursor = filter_->child(cursor, name);
+                bool kept = fs::is_directory(status) ? !filter_->prunesDir(entryCursor)
+                    : filter_->keepsEntry(entryCursor);
+                if (kept && fs::is_regular_file(status)) {
+                    std::uintmax_t size = it->file_size(ec);
+                    kept = !ec && filter_->keepsFile(entryCursor, size);
+                }
+                if (!kept) {
+                    continue;
+                }
+            }
+
+            DirEntry entry;
+            entry.name = std::move(name);
+            entry.mode = static_cast<unsigned int>(status.permissions() & fs::perms::mask);
+            if (fs::is_directory(status) && skipGitDirs_ && entry.name == ".git") {
+                continue;
+            } else if (fs::is_directory(status)) {
+                entry.type = 'd';
+                // numbered once the subdirectory is listed
+                entry.index = subdirs.size();
+                subdirs.emplace_back(path, relPath);
+                subdirCursors.push_back(entryCursor);
+            } else if (fs::is_regular_file(status)) {
+                entry.type = 'f';
+                entry.index = files_.size();
+                files_.push_back(joinWalkPath(root_, relPath));
+            } else if (fs::is_symlink(status)) {
+                entry.type = 'l';
+                entry.mode = 0;
+                entry.target = fs::read_symlink(path, ec).generic_string();
+                if (ec) {
+                    std::fprintf(stderr, "%s: unable to read link: %s\n",
+                        path.string().c_str(), ec.message().c_str());
+                    return false;
+                }
+            } else {
+                std::fprintf(stderr, "%s: not a regular file, directory or link; skipped\n",
+                    path.string().c_str());
+                continue;
+            }
+            dirs_[dirIdx].entries.push_back(std::move(entry));
+        }
+
+        std::vector<std::size_t> subdirIdx;
+        for (std::size_t i = 0; i < subdirs.size(); i++) {
+            subdirIdx.push_back(dirs_.size());
+            if (!list(subdirs[i].first, subdirs[i].second, subdirCursors[i])) {
+                return false;
+            }
+        }
+        auto& entries = dirs_[dirIdx].entries;
+        for (auto& entry : entries) {
+            if (entry.type == 'd') {
+                entry.index = subdirIdx[entry.index];
+            }
+        }
+        std::sort(entries.begin(), entries.end(),
+            [](const DirEntry& a, const DirEntry& b) { return a.name < b.name; });
+        return true;
+    }
+
+private:
+    const std::string& root_;
+    bool skipGitDirs_;
+    const PathFilter* filter_;
+    std::vector<Dir>& dirs_;
+    std::vector<std::string>& files_;
+};
+
+void appendField(std::string& line, const std::string& value) {
+    line += std::to_string(value.size());
+    line += ':';
+    line += value;
+}
+
+std::string encodeEntry(const DirEntry& entry, const std::string& payload) {
+    char mode[8];
+    std::snprintf(mode, sizeof(mode), "%04o", entry.mode & 07777);
+    std::string line;
+    line += entry.type;
+    line += ' ';
+    line += mode;
+    line += ' ';
+    appendField(line, entry.name);
+    line += ' ';
+    appendField(line, payload);
+    line += '\n';
+    return line;
+}
+
+/// Builds the content of a git tree object. Entries whose payload is empty
+/// are directories with nothing to record, which git leaves out.
+std::optional<std::string> encodeGitTree(const std::vector<DirEntry>& entries,
+    const std::vector<std::string>& payloads)
+{
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        if (!payloads[i].empty()) {
+            order.push_back(i);
+        }
+    }
+    auto sortKey = [&](std::size_t i) {
+        return entries[i].type == 'd' ? entries[i].name + "/" : entries[i].name;
+    };
+    std::sort(order.begin(), order.end(),
+        [&](std::size_t a, std::size_t b) { return sortKey(a) < sortKey(b); });
+
+    std::string content;
+    for (std::size_t i : order) {
+        const DirEntry& entry = entries[i];
+        auto id = strToBytes(payloads[i]);
+        if (!id) {
+            return {};
+        }
+        if (entry.type == 'd') {
+            content += "40000";
+        } else if (entry.type == 'l') {
+            content += "120000";
+        } else {
+            content += (entry.mode & 0100) ? "100755" : "100644";
+        }
+        content += ' ';
+        content += entry.name;
+        content += '\0';
+        content.append(id->begin(), id->end());
+    }
+    return content;
+}
+
+}  // namespace
+
+bool computeDirHash(const std::string& root, const DirHashOptions& options,
+    std::vector<DirDigest>& out)
+{
+    auto gitInner = gitInnerAlgo(options.algoName);
+    std::unique_ptr<Hasher> dirHasher;
+    try {
+        dirHasher = makeHasher(gitInner.value_or(options.algoName));
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s cannot be used for directory digests: %s\n",
+            options.algoName.c_str(), e.what());
+        return false;
+    }
+
+    std::error_code ec;
+    if (!fs::is_directory(fs::status(root, ec))) {
+        std::fprintf(stderr, "%s: not a directory\n", root.c_str());
+        return false;
+    }
+    std::vector<Dir> dirs;
+    std::vector<std::string> files;
+    if (!TreeLister(root, gitInner.has_value(), options.filter, dirs, files)
+        .list(root, "", options.filter != nullptr ? options.filter->root() : PathFilter::Cursor{})) {
+        return false;
+    }
+
+    HashEngineOptions engineOptions = options.engine;
+    engineOptions.algoNames = {options.algoName};
+    engineOptions.blockSize = 0;
+    engineOptions.binaryMode = true;
+    std::vector<std::string> fileDigests(files.size());
+    std::vector<std::uint64_t> fileSizes(files.size());
+    bool ok = HashEngine(engineOptions).run(files, [&](std::size_t idx, HashResult& result) {
+        if (!result.ok) {
+            return false;
+        }
+        fileDigests[idx] = std::move(result.digests.digests[0]);
+        fileSizes[idx] = result.digests.size;
+        return true;
+    });
+    if (!ok) {
+        std::fprintf(stderr, "%s: unable to hash every file\n", root.c_str());
+        return false;
+    }
+
+    // subdirectories follow their parents, so in reverse they are done first
+    std::vector<DirDigest> digests(dirs.size());
+    // git trees with nothing in them are left out of their parents
+    std::vector<bool> emptyTree(dirs.size());
+    for (std::size_t i = dirs.size(); i-- > 0;) {
+        DirDigest& digest = digests[i];
+        digest.path = dirs[i].path;
+        const auto& entries = dirs[i].entries;
+        std::vector<std::string> payloads(entries.size());
+        for (std::size_t e = 0; e < entries.size(); e++) {
+            const DirEntry& entry = entries[e];
+            if (entry.type == 'f') {
+                payloads[e] = fileDigests[entry.index];
+                digest.files++;
+                digest.bytes += fileSizes[entry.index];
+            } else if (entry.type == 'd') {
+                if (!emptyTree[entry.index]) {
+                    payloads[e] = digests[entry.index].digest;
+                }
+                digest.files += digests[entry.index].files;
+                digest.bytes += digests[entry.index].bytes;
+            } else if (gitInner) {
+                payloads[e] = hashGitObject("blob", entry.target, *dirHasher).value_or("");
+            } else {
+                payloads[e] = entry.target;
+            }
+        }
+
+        std::optional<std::string> dirDigest;
+        if (gitInner) {
+            auto content = encodeGitTree(entries, payloads);
+            emptyTree[i] = content && content->empty();
+            if (content) {
+                dirDigest = hashGitObject("tree", *content, *dirHasher);
+            }
+        } else {
+            std::string content;
+            for (std::size_t e = 0; e < entries.size(); e++) {
+                content += encodeEntry(entries[e], payloads[e]);
+            }
+            if (dirHasher->reset()
+                && dirHasher->consume(reinterpret_cast<const unsigned char*>(content.data()),
+                    content.size()))
+            {
+                dirDigest = finalizeToStr(*dirHasher);
+            }
+        }
+        if (!dirDigest) {
+            std::fprintf(stderr, "%s: failed to compute \"%s\"\n",
+                joinWalkPath(root, digest.path).c_str(), options.algoName.c_str());
+            return false;
+        }
+        digest.digest = std::move(*dirDigest);
+    }
+
+    std::sort(digests.begin(), digests.end(),
+        [](const DirDigest& a, const DirDigest& b) { return a.path < b.path; });
+    out.insert(out.end(), std::make_move_iterator(digests.begin()),
+        std::make_move_iterator(digests.end()));
+    return true;
+}
+
+}  // namespace mji::xmph
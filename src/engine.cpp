@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#include <xmphash/engine.hpp>
+#include <xmphash/latency.hpp>
+#include <xmphash/pressure.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace fs = std::filesystem;
+
+namespace mji::xmph {
+
+namespace {
+
+/// Files at least this much in the page cache count as hot for cacheFirst
+constexpr double hot_cached_fraction = 0.9;
+
+constexpr std::size_t no_source = ~std::size_t(0);
+/// Files with more extents than this are hashed even if they are copies
+constexpr std::size_t max_shared_extents = 1024;
+
+/// Files whose data is all in extents shared with an earlier file of the
+/// list, with the same layout (and so the same content), and the results
+/// of those earlier files, kept until their copies have been drained
+class SharedCopies {
+public:
+    SharedCopies(const std::vector<std::string>& paths, unsigned int jobs, bool enabled)
+    : sourceOf_(),
+      kept_()
+    {
+        // querying flushes each file's dirty pages, which is wasted when
+        // there is no other file to share extents with
+        if (!enabled || paths.size() <= 1) {
+            return;
+        }
+        std::vector<std::optional<mji::xplat::FileLayout>> layouts(paths.size());
+        runParallel(paths.size(), jobs, [&](std::size_t idx, unsigned int) {
+            layouts[idx] = mji::xplat::sharedLayout(paths[idx].c_str(), max_shared_extents);
+        });
+
+        sourceOf_.assign(paths.size(), no_source);
+        std::unordered_map<std::string, std::size_t> firstWithLayout;
+        for (std::size_t i = 0; i < paths.size(); i++) {
+            if (!layouts[i]) {
+                continue;
+            }
+            auto inserted = firstWithLayout.emplace(layoutKey(*layouts[i]), i);
+            if (!inserted.second) {
+                std::size_t source = inserted.first->second;
+                sourceOf_[i] = source;
+                kept_[source].copiesLeft++;
+            }
+            layouts[i].reset();
+        }
+    }
+
+    bool isCopy(std::size_t idx) const {
+        return !sourceOf_.empty() && sourceOf_[idx] != no_source;
+    }
+
+    /// Keeps the result of a file if copies of it are still to come
+    bool keep(std::size_t idx, const HashResult& result) {
+        auto it = kept_.find(idx);
+        if (it == kept_.end()) {
+            return false;
+        }
+        it->second.result = result;
+        return true;
+    }
+
+    /// Fills in the result of a copy from its source, whose index is
+    /// returned once this was its last copy
+    std::optional<std::size_t> fill(std::size_t idx, HashResult& result) {
+        std::size_t source = sourceOf_[idx];
+        auto it = kept_.find(source);
+        result = it->second.result;
+        if (--it->second.copiesLeft != 0) {
+            return {};
+        }
+        kept_.erase(it);
+        return source;
+    }
+
+    /// Sources whose copies were never drained
+    std::vector<std::size_t> stillKept(std::size_t drained) const {
+        std::vector<std::size_t> sources;
+        for (const auto& kept : kept_) {
+            if (kept.first < drained) {
+                sources.push_back(kept.first);
+            }
+        }
+        return sources;
+    }
+
+private:
+    struct Kept {
+        std::size_t copiesLeft = 0;
+        HashResult result;
+    };
+
+    std::vector<std::size_t> sourceOf_;
+    std::unordered_map<std::size_t, Kept> kept_;
+
+    static std::string layoutKey(const mji::xplat::FileLayout& layout) {
+        std::string key;
+        auto append = [&key](std::uint64_t value) {
+            for (int i = 0; i < 8; i++) {
+                key.push_back(static_cast<char>(value >> (8 * i)));
+            }
+        };
+        append(layout.device);
+        append(layout.size);
+        for (const auto& extent : layout.extents) {
+            append(extent.logical);
+            append(extent.physical);
+            append(extent.length);
+        }
+        return key;
+    }
+};
+
+/// File indices in the order a group of workers starts them
+struct WorkQueue {
+    std::vector<std::size_t> order;
+    std::atomic<std::size_t> next{0};
+
+    /// Claims the next position in order; false once all are claimed
+    bool take(std::size_t& pos) {
+        pos = next.fetch_add(1);
+        return pos < order.size();
+    }
+};
+
+}  // namespace
+
+void runParallel(std::size_t count, unsigned int jobs,
+    const std::function<void(std::size_t, unsigned int)>& fn)
+{
+    if (jobs <= 1 || count <= 1) {
+        for (std::size_t i = 0; i < count; i++) {
+            fn(i, 0);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next{0};
+    auto work = [&](unsigned int worker) {
+        for (;;) {
+            waitForWorkerSlot(worker);
+            std::size_t idx = next.fetch_add(1);
+            if (idx >= count) {
+                break;
+            }
+            fn(idx, worker);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    unsigned int threadCount = static_cast<unsigned int>(std::min<std::size_t>(jobs, count));
+    for (unsigned int w = 1; w < threadCount; w++) {
+        threads.emplace_back(work, w);
+    }
+    work(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+HashEngine::HashEngine(const HashEngineOptions& options)
+: options_(options),
+  fileHasher_(options.algoNames, options.blockSize, options.fingerprintParams)
+{}
+
+bool HashEngine::hashOne(FileHasher& hasher, const std::string& path, std::size_t idx,
+    FileDigests& out)
+{
+    // failures are timed too: a file on a failing disk may take long to fail
+    std::uint64_t start = latencyStart();
+    bool ok = false;
+    try {
+        ok = hashOneUntimed(hasher, path, idx, out);
+    } catch (const std::bad_alloc&) {
+        // nothing above a worker could catch it
+        std::fprintf(stderr, "%s: out of memory\n", path.c_str());
+    }
+    recordFileLatency(start, path, out.size);
+    return ok;
+}
+
+bool HashEngine::hashOneUntimed(FileHasher& hasher, const std::string& path, std::size_t idx,
+    FileDigests& out)
+{
+    if (options_.checkpointInterval == 0 && !options_.resumePoint) {
+        return hasher.hashFile(path, options_.binaryMode, out);
+    }
+    CheckpointHooks hooks;
+    if (options_.saveCheckpoint) {
+        hooks.interval = options_.checkpointInterval;
+        hooks.save = [&](const StreamCheckpoint& checkpoint) {
+            options_.saveCheckpoint(idx, checkpoint);
+        };
+    }
+    if (options_.resumePoint) {
+        hooks.resumeFrom = options_.resumePoint(idx);
+    }
+    return hasher.hashFile(path, options_.binaryMode, out, &hooks);
+}
+
+bool HashEngine::run(const std::vector<std::string>& paths,
+    const std::function<bool(std::size_t, HashResult&)>& sink)
+{
+    std::size_t count = paths.size();
+    unsigned int jobs = std::max(1u, options_.jobs);
+
+    SharedCopies copies(paths, jobs, options_.reuseSharedExtents);
+
+    unsigned int threadCount = static_cast<unsigned int>(std::min<std::size_t>(jobs, count));
+    MemoryBudget* budget = options_.memoryBudget;
+    std::uint64_t hasherBytes = fileHasher_.workingSetSize();
+    std::uint64_t workerBytes = 0;
+    if (budget) {
+        // the first worker's hasher is needed to make any progress at all
+        if (!budget->tryAcquire(hasherBytes)) {
+            std::fprintf(stderr, "The buffers and hash state of one worker (%llu bytes) do not fit in the memory limit of %llu bytes\n",
+                static_cast<unsigned long long>(hasherBytes),
+                static_cast<unsigned long long>(budget->limit()));
+            return false;
+        }
+        workerBytes = hasherBytes;
+        for (unsigned int w = 1; w < threadCount; w++) {
+            if (!budget->tryAcquire(hasherBytes)) {
+                threadCount = w;
+                break;
+            }
+            workerBytes += hasherBytes;
+        }
+    }
+    // what a file's result is charged to the budget until it is drained
+    auto resultBytes = [&](const FileHasher& hasher, std::size_t idx) {
+        std::uint64_t fileSize = 0;
+        if (options_.blockSize != 0) {
+            std::error_code ec;
+            fileSize = fs::file_size(paths[idx], ec);
+            if (ec) {
+                fileSize = 0;
+            }
+        }
+        return sizeof(HashResult) + hasher.digestsSize(fileSize);
+    };
+
+    if (jobs == 1) {
+        std::vector<std::size_t> order;
+        for (std::size_t i = 0; i < count; i++) {
+            if (!copies.isCopy(i)) {
+                order.push_back(i);
+            }
+        }
+        Prefetcher prefetcher(paths, std::move(order), options_.prefetch);
+        // results kept for their copies, and what each was charged
+        std::unordered_map<std::size_t, std::uint64_t> keptBytes;
+        std::size_t started = 0;
+        bool completed = true;
+        for (std::size_t i = 0; i < count && completed; i++) {
+            HashResult result;
+            std::uint64_t freed = 0;
+            if (copies.isCopy(i)) {
+                if (auto source = copies.fill(i, result); source && budget) {
+                    freed = keptBytes[*source];
+                    keptBytes.erase(*source);
+                }
+            } else {
+                // this is always the next result to drain, so it may go
+                // over the budget
+                std::uint64_t charge = 0;
+                if (budget) {
+                    charge = resultBytes(fileHasher_, i);
+                    budget->acquire(charge, [] { return true; });
+                }
+                prefetcher.started(started++);
+                result.ok = hashOne(fileHasher_, paths[i], i, result.digests);
+                if (copies.keep(i, result)) {
+                    keptBytes[i] = charge;
+                } else {
+                    freed = charge;
+                }
+            }
+            completed = sink(i, result);
+            if (budget) {
+                budget->release(freed);
+            }
+        }
+        if (budget) {
+            for (const auto& kept : keptBytes) {
+                budget->release(kept.second);
+            }
+            budget->release(workerBytes);
+        }
+        return completed;
+    }
+
+    // files mostly in the page cache get a queue and workers of their own,
+    // so that they are hashed at CPU speed while the rest wait on the disk.
+    // This needs at least one worker for each queue.
+    WorkQueue coldQueue;
+    WorkQueue hotQueue;
+    if (options_.cacheFirst && threadCount > 1) {
+        std::vector<unsigned char> hot(count);
+        runParallel(count, jobs, [&](std::size_t idx, unsigned int) {
+            auto fraction = mji::xplat::cachedFraction(paths[idx].c_str());
+            hot[idx] = fraction && *fraction >= hot_cached_fraction;
+        });
+        for (std::size_t i = 0; i < count; i++) {
+            if (!copies.isCopy(i)) {
+                (hot[i] ? hotQueue : coldQueue).order.push_back(i);
+            }
+        }
+    } else {
+        for (std::size_t i = 0; i < count; i++) {
+            if (!copies.isCopy(i)) {
+                coldQueue.order.push_back(i);
+            }
+        }
+    }
+    unsigned int hotWorkers = 0;
+    if (!hotQueue.order.empty()) {
+        hotWorkers = coldQueue.order.empty() ? threadCount : threadCount / 2;
+    }
+    // only cold files are worth reading ahead
+    Prefetcher prefetcher(paths, coldQueue.order, options_.prefetch);
+
+    // reorder buffer: workers fill slots in any order, the caller drains
+    // them in index order
+    std::vector<std::optional<HashResult>> slots(count);
+    std::mutex mutex;
+    std::condition_variable slotFilled;
+    std::atomic<bool> stop{false};
+    // under a memory budget: what each filled slot was charged, and the
+    // next slot to be drained, which may always go over the budget since
+    // everything else waits for it
+    std::vector<std::uint64_t> charged(budget ? count : 0);
+    std::atomic<std::size_t> drained{0};
+
+    auto work = [&](unsigned int worker) {
+        std::unique_ptr<FileHasher> ownHasher;
+        FileHasher* hasher = &fileHasher_;
+        if (worker != 0) {
+            ownHasher = std::make_unique<FileHasher>(
+                options_.algoNames, options_.blockSize, options_.fingerprintParams);
+            hasher = ownHasher.get();
+        }
+        // the jobs left over when there are fewer files than jobs go to
+        // the workers' fs-verity digests, so no more than -j threads hash
+        hasher->setPositionalThreads(jobs / threadCount, budget);
+        // a worker only moves to the other queue once its own is exhausted.
+        // Each queue is in index order, so the next file to be drained is
+        // then always either taken or at the front of a queue whose workers
+        // are not waiting on the memory budget.
+        WorkQueue* ownQueue = (worker < hotWorkers) ? &hotQueue : &coldQueue;
+        WorkQueue* otherQueue = (worker < hotWorkers) ? &coldQueue : &hotQueue;
+        for (;;) {
+            waitForWorkerSlot(worker);
+            WorkQueue* queue = ownQueue;
+            std::size_t pos = 0;
+            if (!queue->take(pos)) {
+                queue = otherQueue;
+                if (!queue->take(pos)) {
+                    break;
+                }
+            }
+            if (stop.load()) {
+                break;
+            }
+            std::size_t idx = queue->order[pos];
+            if (budget) {
+                charged[idx] = resultBytes(*hasher, idx);
+                budget->acquire(charged[idx], [&] { return idx == drained.load() || stop.load(); });
+                if (stop.load()) {
+                    budget->release(charged[idx]);
+                    break;
+                }
+            }
+            if (queue == &coldQueue) {
+                prefetcher.started(pos);
+            }
+            HashResult result;
+            result.ok = hashOne(*hasher, paths[idx], idx, result.digests);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slots[idx].emplace(std::move(result));
+            }
+            slotFilled.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int w = 0; w < threadCount; w++) {
+        threads.emplace_back(work, w);
+    }
+
+    bool completed = true;
+    for (std::size_t i = 0; i < count; i++) {
+        HashResult result;
+        // what drained this result lets go of the budget
+        std::uint64_t freed = 0;
+        if (copies.isCopy(i)) {
+            if (auto source = copies.fill(i, result); source && budget) {
+                freed = charged[*source];
+            }
+        } else {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slotFilled.wait(lock, [&] { return slots[i].has_value(); });
+                result = std::move(*slots[i]);
+                slots[i].reset();
+            }
+            if (!copies.keep(i, result) && budget) {
+                freed = charged[i];
+            }
+        }
+        bool keepGoing = sink(i, result);
+        if (budget) {
+            drained.store(i + 1);
+            budget->release(freed);
+        }
+        if (!keepGoing) {
+            completed = false;
+            stop.store(true);
+            if (budget) {
+                budget->wake();
+            }
+            break;
+        }
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (budget) {
+        // results that were hashed but never drained
+        std::uint64_t undrained = 0;
+        for (std::size_t i = drained.load(); i < count; i++) {
+            if (slots[i]) {
+                undrained += charged[i];
+            }
+        }
+        for (std::size_t source : copies.stillKept(drained.load())) {
+            undrained += charged[source];
+        }
+        budget->release(workerBytes + undrained);
+    }
+    return completed;
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <xmphash/fingerprint.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/pressure.hpp>
+#include <xmphash/throttle.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr std::size_t fingerprintReadSize = 1 << 16;
+
+void putLe64(unsigned char* buf, std::uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        buf[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+}
+
+}  // namespace
+
+bool isFingerprintAlgo(std::string_view name) {
+    return name.size() > fingerprint_prefix.size()
+        && name.substr(0, fingerprint_prefix.size()) == fingerprint_prefix;
+}
+
+std::optional<std::string> computeFingerprint(const mji::xplat::InFile& file,
+    std::uint64_t size, Hasher& inner, const FingerprintParams& params)
+{
+    if (!inner.reset()) {
+        return {};
+    }
+
+    unsigned char header[32];
+    putLe64(header, 0x3170662d68706d78u);  // "xmph-fp1"
+    putLe64(header + 8, size);
+    putLe64(header + 16, params.edgeSize);
+    putLe64(header + 24, params.samples);
+    inner.consume(header, sizeof(header));
+
+    // (offset, length) of each region to read, in ascending offset order
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> regions;
+    std::uint64_t sampledTotal = 2 * params.edgeSize + params.samples * params.sampleSize;
+    if (size <= sampledTotal) {
+        regions.emplace_back(0, size);
+    } else {
+        regions.emplace_back(0, params.edgeSize);
+        // spread the samples evenly over the interior between head and tail
+        std::uint64_t interiorStart = params.edgeSize;
+        std::uint64_t interiorLen = size - 2 * params.edgeSize;
+        for (std::uint64_t i = 0; i < params.samples; i++) {
+            std::uint64_t slot = interiorLen / params.samples;
+            std::uint64_t offset = interiorStart + i * slot
+                + (slot - std::min(slot, params.sampleSize)) / 2;
+            regions.emplace_back(offset, std::min(slot, params.sampleSize));
+        }
+        regions.emplace_back(size - params.edgeSize, params.edgeSize);
+    }
+
+    auto buf = std::make_unique<unsigned char[]>(fingerprintReadSize);
+    for (const auto& [offset, length] : regions) {
+        std::uint64_t done = 0;
+        while (done < length) {
+            auto want = static_cast<std::size_t>(
+                std::min<std::uint64_t>(length - done, pressureReadSize(fingerprintReadSize)));
+            std::int64_t got = throttledReadAt(file, buf.get(), want, offset + done);
+            if (got <= 0) {
+                // the file shrank underneath us or the read failed
+                return {};
+            }
+            if (!inner.consume(buf.get(), static_cast<std::size_t>(got))) {
+                return {};
+            }
+            done += static_cast<std::uint64_t>(got);
+        }
+        file.dropCache(offset, done);
+    }
+
+    return finalizeToStr(inner);
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include <xmphash/fuzzy.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr char ssdeepB64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+constexpr unsigned char ssdeepHashInit = 0x27;
+
+constexpr std::uint32_t ssdeepBlockSize(unsigned int index) {
+    return 3u << index;
+}
+
+/// Lookup table for the ssdeep piece hash. Only the low 6 bits of the FNV
+/// state ever reach the digest, so a 64x64 table replaces the multiply.
+class SsdeepSumLut {
+public:
+    constexpr SsdeepSumLut()
+    : data()
+    {
+        for (std::uint32_t h = 0; h < 64; h++) {
+            for (std::uint32_t c = 0; c < 64; c++) {
+                data[h][c] = static_cast<unsigned char>(((h * 0x01000193u) ^ c) & 0x3fu);
+            }
+        }
+    }
+
+    constexpr unsigned char operator()(unsigned char h, unsigned char c) const {
+        return data[h][c & 0x3fu];
+    }
+
+private:
+    unsigned char data[64][64];
+};
+
+inline constexpr SsdeepSumLut ssdeepSum{};
+
+/// The Pearson permutation used by TLSH
+constexpr unsigned char tlshVTable[256] = {
+    1, 87, 49, 12, 176, 178, 102, 166, 121, 193, 6, 84, 249, 230, 44, 163,
+    14, 197, 213, 181, 161, 85, 218, 80, 64, 239, 24, 226, 236, 142, 38, 200,
+    110, 177, 104, 103, 141, 253, 255, 50, 77, 101, 81, 18, 45, 96, 31, 222,
+    25, 107, 190, 70, 86, 237, 240, 34, 72, 242, 20, 214, 244, 227, 149, 235,
+    97, 234, 57, 22, 60, 250, 82, 175, 208, 5, 127, 199, 111, 62, 135, 248,
+    174, 169, 211, 58, 66, 154, 106, 195, 245, 171, 17, 187, 182, 179, 0, 243,
+    132, 56, 148, 75, 128, 133, 158, 100, 130, 126, 91, 13, 153, 246, 216, 219,
+    119, 68, 223, 78, 83, 88, 201, 99, 122, 11, 92, 32, 136, 114, 52, 10,
+    138, 30, 48, 183, 156, 35, 61, 26, 143, 74, 251, 94, 129, 162, 63, 152,
+    170, 7, 115, 167, 241, 206, 3, 150, 55, 59, 151, 220, 90, 53, 23, 131,
+    125, 173, 15, 238, 79, 95, 89, 16, 105, 137, 225, 224, 217, 160, 37, 123,
+    118, 73, 2, 157, 46, 116, 9, 145, 134, 228, 207, 212, 202, 215, 69, 229,
+    27, 188, 67, 124, 168, 252, 42, 4, 29, 108, 21, 247, 19, 205, 39, 203,
+    233, 40, 186, 147, 198, 192, 155, 33, 164, 191, 98, 204, 165, 180, 117, 76,
+    140, 36, 210, 172, 41, 54, 159, 8, 185, 232, 113, 196, 231, 47, 146, 120,
+    51, 65, 28, 144, 254, 221, 93, 189, 194, 139, 112, 43, 71, 109, 184, 209
+};
+
+/// Pearson hash of (salt, i, j, k), taking the salt already mapped through
+/// the table so the first lookup is a constant
+inline unsigned char tlshMapping(unsigned char mappedSalt,
+    unsigned char i, unsigned char j, unsigned char k)
+{
+    unsigned char h = tlshVTable[mappedSalt ^ i];
+    h = tlshVTable[h ^ j];
+    return tlshVTable[h ^ k];
+}
+
+constexpr std::uint64_t tlshMinDataLength = 50;
+constexpr std::uint64_t tlshMaxDataLength = 0xffffffffu;
+
+/// Log-scale length code
+unsigned char tlshLCapturing(std::uint32_t len) {
+    int i;
+    if (len <= 656) {
+        i = static_cast<int>(std::floor(std::log(static_cast<double>(len)) / 0.4054651));
+    } else if (len <= 3199) {
+        i = static_cast<int>(std::floor(std::log(static_cast<double>(len)) / 0.26236426 - 8.72777));
+    } else {
+        i = static_cast<int>(std::floor(std::log(static_cast<double>(len)) / 0.095310180 - 62.5472));
+    }
+    return static_cast<unsigned char>(i & 0xff);
+}
+
+unsigned char swapNibbles(unsigned char b) {
+    return static_cast<unsigned char>(((b & 0xfu) << 4) | (b >> 4));
+}
+
+}  // namespace
+
+// SsdeepHasher
+
+SsdeepHasher::SsdeepHasher()
+: Hasher(),
+  bh_(),
+  window_()
+{
+    resetImpl();
+}
+
+bool SsdeepHasher::resetImpl() {
+    totalSize_ = 0;
+    bhStart_ = 0;
+    bhEnd_ = 1;
+    needLastHash_ = false;
+    lastHash_ = 0;
+    bh_[0].h = ssdeepHashInit;
+    bh_[0].halfh = ssdeepHashInit;
+    bh_[0].digest[0] = '\0';
+    bh_[0].halfdigest = '\0';
+    bh_[0].dindex = 0;
+
+    std::memset(window_, 0, sizeof(window_));
+    h1_ = 0;
+    h2_ = 0;
+    h3_ = 0;
+    windowIdx_ = 0;
+    return true;
+}
+
+void SsdeepHasher::tryForkBlockhash() {
+    BlockhashContext& obh = bh_[bhEnd_ - 1];
+    if (bhEnd_ < num_blockhashes) {
+        BlockhashContext& nbh = bh_[bhEnd_];
+        nbh.h = obh.h;
+        nbh.halfh = obh.halfh;
+        nbh.digest[0] = '\0';
+        nbh.halfdigest = '\0';
+        nbh.dindex = 0;
+        bhEnd_++;
+    } else if (bhEnd_ == num_blockhashes && !needLastHash_) {
+        needLastHash_ = true;
+        lastHash_ = obh.h;
+    }
+}
+
+void SsdeepHasher::tryReduceBlockhash() {
+    if (bhEnd_ - bhStart_ < 2) {
+        // need at least two working hashes
+        return;
+    }
+    if (static_cast<std::uint64_t>(ssdeepBlockSize(bhStart_)) * spamsum_length >= totalSize_) {
+        // the initial block size estimate would still select this one
+        return;
+    }
+    if (bh_[bhStart_ + 1].dindex < spamsum_length / 2) {
+        // the estimate adjustment would still select this one
+        return;
+    }
+    // no longer interested in the smallest block size
+    bhStart_++;
+}
+
+bool SsdeepHasher::consumeImpl(const void* data, std::size_t count) {
+    auto ucdata = static_cast<const unsigned char*>(data);
+    // the reduction test compares against the total including this buffer,
+    // exactly as libfuzzy does; it never changes the result, only the work
+    totalSize_ += count;
+
+    // keep the rolling hash in locals for the duration of the loop
+    std::uint32_t h1 = h1_;
+    std::uint32_t h2 = h2_;
+    std::uint32_t h3 = h3_;
+    std::uint32_t windowIdx = windowIdx_;
+
+    for (std::size_t n = 0; n < count; n++) {
+        unsigned char c = ucdata[n];
+
+        h2 -= h1;
+        h2 += static_cast<std::uint32_t>(rolling_window) * c;
+        h1 += c;
+        h1 -= window_[windowIdx];
+        window_[windowIdx] = c;
+        windowIdx = (windowIdx + 1 == rolling_window) ? 0 : windowIdx + 1;
+        h3 = (h3 << 5) ^ c;
+        std::uint32_t h = h1 + h2 + h3;
+
+        for (unsigned int i = bhStart_; i < bhEnd_; i++) {
+            bh_[i].h = ssdeepSum(bh_[i].h, c);
+            bh_[i].halfh = ssdeepSum(bh_[i].halfh, c);
+        }
+        if (needLastHash_) {
+            lastHash_ = ssdeepSum(lastHash_, c);
+        }
+
+        // Reset points for larger block sizes are a subset of those for
+        // smaller ones, so stop at the first block size that doesn't trigger.
+        // Almost every byte stops at bhStart_.
+        for (unsigned int i = bhStart_; i < bhEnd_; i++) {
+            std::uint32_t bs = ssdeepBlockSize(i);
+            if (h % bs != bs - 1) {
+                break;
+            }
+            if (bh_[i].dindex == 0) {
+                // first reset point for this block size: start the next one
+                tryForkBlockhash();
+            }
+            bh_[i].digest[bh_[i].dindex] = ssdeepB64[bh_[i].h];
+            bh_[i].halfdigest = ssdeepB64[bh_[i].halfh];
+            if (bh_[i].dindex < spamsum_length - 1) {
+                // only start a new piece while there is room for it; once
+                // full, the tail pieces are merged into the last character
+                bh_[i].digest[++bh_[i].dindex] = '\0';
+                bh_[i].h = ssdeepHashInit;
+                if (bh_[i].dindex < spamsum_length / 2) {
+                    bh_[i].halfh = ssdeepHashInit;
+                    bh_[i].halfdigest = '\0';
+                }
+            } else {
+                tryReduceBlockhash();
+            }
+        }
+    }
+
+    h1_ = h1;
+    h2_ = h2;
+    h3_ = h3;
+    windowIdx_ = windowIdx;
+    return true;
+}
+
+bool SsdeepHasher::finalizeImpl(void* buf) {
+    unsigned int bi = bhStart_;
+    std::uint32_t h = h1_ + h2_ + h3_;
+
+    // initial block size guess from the total length
+    while (static_cast<std::uint64_t>(ssdeepBlockSize(bi)) * spamsum_length < totalSize_) {
+        bi++;
+        if (bi >= num_blockhashes) {
+            // the input is too large for the digest format
+            return false;
+        }
+    }
+    // adapt the guess to the digest lengths actually produced
+    while (bi >= bhEnd_) {
+        bi--;
+    }
+    while (bi > bhStart_ && bh_[bi].dindex < spamsum_length / 2) {
+        bi--;
+    }
+
+    std::string result = std::to_string(ssdeepBlockSize(bi));
+    result += ':';
+    result.append(bh_[bi].digest, bh_[bi].dindex);
+    if (h != 0) {
+        result += ssdeepB64[bh_[bi].h];
+    } else if (bh_[bi].digest[bh_[bi].dindex] != '\0') {
+        result += bh_[bi].digest[bh_[bi].dindex];
+    }
+    result += ':';
+    if (bi < bhEnd_ - 1) {
+        bi++;
+        unsigned int len = std::min<unsigned int>(bh_[bi].dindex, spamsum_length / 2 - 1);
+        result.append(bh_[bi].digest, len);
+        if (h != 0) {
+            result += ssdeepB64[bh_[bi].halfh];
+        } else if (bh_[bi].halfdigest != '\0') {
+            result += bh_[bi].halfdigest;
+        }
+    } else if (h != 0) {
+        result += ssdeepB64[bi == 0 ? bh_[bi].h : lastHash_];
+    }
+
+    auto cbuf = static_cast<char*>(buf);
+    std::memcpy(cbuf, result.c_str(), result.size() + 1);
+    return true;
+}
+
+std::size_t SsdeepHasher::getDigestSizeImpl() const {
+    return max_result;
+}
+
+const char* SsdeepHasher::getNameImpl() const {
+    return "ssdeep";
+}
+
+std::string SsdeepHasher::formatDigestImpl(const unsigned char* buf) const {
+    return std::string(reinterpret_cast<const char*>(buf));
+}
+
+// TlshHasher
+
+TlshHasher::TlshHasher()
+: Hasher(),
+  buckets_()
+{
+    resetImpl();
+}
+
+bool TlshHasher::resetImpl() {
+    std::memset(buckets_, 0, sizeof(buckets_));
+    dataLen_ = 0;
+    checksum_ = 0;
+    w1_ = 0;
+    w2_ = 0;
+    w3_ = 0;
+    w4_ = 0;
+    return true;
+}
+
+bool TlshHasher::consumeImpl(const void* data, std::size_t count) {
+    auto ucdata = static_cast<const unsigned char*>(data);
+
+    // The reference implementation indexes a 5-byte ring buffer; here the
+    // window lives in locals and shifts by one each byte.
+    unsigned char w1 = w1_;
+    unsigned char w2 = w2_;
+    unsigned char w3 = w3_;
+    unsigned char w4 = w4_;
+    unsigned char checksum = checksum_;
+    std::size_t n = 0;
+
+    // the first four bytes only fill the window
+    for (; n < count && dataLen_ + n < 4; n++) {
+        w4 = w3;
+        w3 = w2;
+        w2 = w1;
+        w1 = ucdata[n];
+    }
+
+    for (; n < count; n++) {
+        unsigned char c = ucdata[n];
+        // salts 0, 2, 3, 5, 7, 11 and 13, already mapped through the table
+        checksum = tlshMapping(1, c, w1, checksum);
+        buckets_[tlshMapping(49, c, w1, w2)]++;
+        buckets_[tlshMapping(12, c, w1, w3)]++;
+        buckets_[tlshMapping(178, c, w2, w3)]++;
+        buckets_[tlshMapping(166, c, w2, w4)]++;
+        buckets_[tlshMapping(84, c, w1, w4)]++;
+        buckets_[tlshMapping(230, c, w3, w4)]++;
+        w4 = w3;
+        w3 = w2;
+        w2 = w1;
+        w1 = c;
+    }
+
+    dataLen_ += count;
+    w1_ = w1;
+    w2_ = w2;
+    w3_ = w3;
+    w4_ = w4;
+    checksum_ = checksum;
+    return true;
+}
+
+bool TlshHasher::finalizeImpl(void* buf) {
+    auto cbuf = static_cast<char*>(buf);
+    constexpr char nullDigest[] = "TNULL";
+
+    if (dataLen_ < tlshMinDataLength || dataLen_ > tlshMaxDataLength) {
+        std::memcpy(cbuf, nullDigest, sizeof(nullDigest));
+        return true;
+    }
+
+    unsigned int nonzero = 0;
+    for (std::size_t i = 0; i < eff_buckets; i++) {
+        if (buckets_[i] > 0) {
+            nonzero++;
+        }
+    }
+    if (nonzero <= eff_buckets / 2) {
+        std::memcpy(cbuf, nullDigest, sizeof(nullDigest));
+        return true;
+    }
+
+    std::uint32_t sorted[eff_buckets];
+    std::copy(buckets_, buckets_ + eff_buckets, sorted);
+    std::uint32_t* q1p = sorted + eff_buckets / 4 - 1;
+    std::uint32_t* q2p = sorted + eff_buckets / 2 - 1;
+    std::uint32_t* q3p = sorted + eff_buckets - eff_buckets / 4 - 1;
+    std::nth_element(sorted, q2p, sorted + eff_buckets);
+    std::nth_element(sorted, q1p, q2p);
+    std::nth_element(q2p + 1, q3p, sorted + eff_buckets);
+    std::uint32_t q1 = *q1p;
+    std::uint32_t q2 = *q2p;
+    std::uint32_t q3 = *q3p;
+
+    // checksum, L value, Q ratios, then the code in reverse order
+    unsigned char bin[3 + code_size];
+    bin[0] = swapNibbles(checksum_);
+    bin[1] = swapNibbles(tlshLCapturing(static_cast<std::uint32_t>(dataLen_)));
+    // the reference computes these in 32-bit unsigned and float arithmetic
+    auto q1ratio = static_cast<unsigned int>(
+        static_cast<float>(q1 * 100u) / static_cast<float>(q3)) % 16;
+    auto q2ratio = static_cast<unsigned int>(
+        static_cast<float>(q2 * 100u) / static_cast<float>(q3)) % 16;
+    bin[2] = swapNibbles(static_cast<unsigned char>(q1ratio | (q2ratio << 4)));
+    for (std::size_t i = 0; i < code_size; i++) {
+        unsigned char h = 0;
+        for (std::size_t j = 0; j < 4; j++) {
+            std::uint32_t k = buckets_[4 * i + j];
+            if (q3 < k) {
+                h += 3 << (j * 2);
+            } else if (q2 < k) {
+                h += 2 << (j * 2);
+            } else if (q1 < k) {
+                h += 1 << (j * 2);
+            }
+        }
+        bin[3 + (code_size - 1 - i)] = h;
+    }
+
+    constexpr char hexDigits[] = "0123456789ABCDEF";
+    cbuf[0] = 'T';
+    cbuf[1] = '1';
+    for (std::size_t i = 0; i < sizeof(bin); i++) {
+        cbuf[2 + 2 * i] = hexDigits[bin[i] >> 4];
+        cbuf[2 + 2 * i + 1] = hexDigits[bin[i] & 0xfu];
+    }
+    cbuf[2 + 2 * sizeof(bin)] = '\0';
+    return true;
+}
+
+std::size_t TlshHasher::getDigestSizeImpl() const {
+    return max_result;
+}
+
+const char* TlshHasher::getNameImpl() const {
+    return "tlsh";
+}
+
+std::string TlshHasher::formatDigestImpl(const unsigned char* buf) const {
+    return std::string(reinterpret_cast<const char*>(buf));
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,66 @@
+#include <algorithm>
+
+#include <xmphash/bufpool.hpp>
+#include <xmphash/gitobj.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/throttle.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+bool consumeHeader(Hasher& hasher, std::string_view type, std::uint64_t size) {
+    std::string header(type);
+    header += ' ';
+    header += std::to_string(size);
+    // the terminating NUL is part of the header
+    return hasher.reset()
+        && hasher.consume(reinterpret_cast<const unsigned char*>(header.c_str()), header.size() + 1);
+}
+
+}  // namespace
+
+std::optional<std::string> gitInnerAlgo(std::string_view name) {
+    if (name.substr(0, git_algo_prefix.size()) != git_algo_prefix) {
+        return {};
+    }
+    std::string_view inner = name.substr(git_algo_prefix.size());
+    if (inner != "sha1" && inner != "sha256") {
+        return {};
+    }
+    return std::string(inner);
+}
+
+std::optional<std::string> computeGitBlobId(const mji::xplat::InFile& file,
+    std::uint64_t size, Hasher& hasher)
+{
+    if (!consumeHeader(hasher, "blob", size)) {
+        return {};
+    }
+    PooledBuffer buffer = PooledBuffer::acquire();
+    if (buffer.data() == nullptr) {
+        return {};
+    }
+    for (std::uint64_t offset = 0; offset < size;) {
+        auto want = static_cast<std::size_t>(std::min<std::uint64_t>(pool_buffer_size, size - offset));
+        std::int64_t got = throttledReadAt(file, buffer.data(), want, offset);
+        if (got <= 0 || !hasher.consume(buffer.data(), static_cast<std::size_t>(got))) {
+            return {};
+        }
+        offset += static_cast<std::uint64_t>(got);
+    }
+    return finalizeToStr(hasher);
+}
+
+std::optional<std::string> hashGitObject(std::string_view type, std::string_view content,
+    Hasher& hasher)
+{
+    if (!consumeHeader(hasher, type, content.size())
+        || !hasher.consume(reinterpret_cast<const unsigned char*>(content.data()), content.size()))
+    {
+        return {};
+    }
+    return finalizeToStr(hasher);
+}
+
+}  // namespace mji::xmph
@@ -1,5 +1,8 @@
 #include <cassert>
+#include <cstring>
+#include <limits>
 
+#include <xmphash/fuzzy.hpp>
 #include <xmphash/hasher.hpp>
 
 namespace mji::xmph {
@@ -16,8 +19,7 @@ Hasher::Hasher()
 
 bool Hasher::consume(const void* data, std::size_t count) {
     if (!isFinalized_ && data != nullptr) {
-        consumeImpl(data, count);
-        return true;
+        return consumeImpl(data, count);
     } else {
         return false;
     }
@@ -42,7 +44,39 @@ const char* Hasher::getName() const {
 }
 
 bool Hasher::reset() {
-    return resetImpl();
+    if (resetImpl()) {
+        isFinalized_ = false;
+        return true;
+    }
+    return false;
+}
+
+std::string Hasher::formatDigest(const unsigned char* buf) const {
+    return formatDigestImpl(buf);
+}
+
+std::string Hasher::formatDigestImpl(const unsigned char* buf) const {
+    return bytesToStr(buf, getDigestSize());
+}
+
+bool Hasher::exportState(std::vector<unsigned char>& out) const {
+    return !isFinalized_ && exportStateImpl(out);
+}
+
+bool Hasher::importState(const unsigned char* data, std::size_t count) {
+    if (data != nullptr && importStateImpl(data, count)) {
+        isFinalized_ = false;
+        return true;
+    }
+    return false;
+}
+
+bool Hasher::exportStateImpl(std::vector<unsigned char>&) const {
+    return false;
+}
+
+bool Hasher::importStateImpl(const unsigned char*, std::size_t) {
+    return false;
 }
 
 // Crc32Hasher
@@ -87,6 +121,25 @@ std::size_t Crc32Hasher::getDigestSizeImpl() const {
     return 4;
 }
 
+bool Crc32Hasher::exportStateImpl(std::vector<unsigned char>& out) const {
+    out.resize(4);
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<unsigned char>(partial_ >> (8 * i));
+    }
+    return true;
+}
+
+bool Crc32Hasher::importStateImpl(const unsigned char* data, std::size_t count) {
+    if (count != 4) {
+        return false;
+    }
+    partial_ = 0;
+    for (int i = 3; i >= 0; i--) {
+        partial_ = (partial_ << 8) | data[i];
+    }
+    return true;
+}
+
 const char* Crc32Hasher::getNameImpl() const {
     return "crc32";
 }
@@ -187,6 +240,18 @@ EvpHasher::EvpHasher(std::string&& name)
     initContext();
 }
 
+std::unique_ptr<Hasher> makeHasher(const std::string& name) {
+    if (name == "crc32") {
+        return std::make_unique<Crc32Hasher>();
+    } else if (name == "ssdeep") {
+        return std::make_unique<SsdeepHasher>();
+    } else if (name == "tlsh") {
+        return std::make_unique<TlshHasher>();
+    } else {
+        return std::make_unique<EvpHasher>(name.c_str());
+    }
+}
+
 namespace {
 
 /// Gets the value of a hex digit char ('0'-'F') as a number (0-15)
@@ -206,7 +271,7 @@ int hexDigitValue(char c) {
 
 /// converts a number in [0, 15] to a digit or lowercase letter
 char valueToHexDigit(int n) {
-    assert(n > 0 && n < 16);
+    assert(n >= 0 && n < 16);
 
     if (n < 10) {
         return '0' + n;
@@ -237,7 +302,7 @@ std::optional<std::vector<unsigned char>> strToBytes(std::string_view sv) {
     return vec;
 }
 
-std::string bytesToStr(unsigned char* buf, std::size_t count) {
+std::string bytesToStr(const unsigned char* buf, std::size_t count) {
     assert(count <= std::numeric_limits<std::size_t>::max() / 2);
 
     std::string ret(count * 2, '\0');
@@ -248,6 +313,22 @@ std::string bytesToStr(unsigned char* buf, std::size_t count) {
     return ret;
 }
 
+std::uint64_t stableHash64(std::string_view sv) {
+    std::uint64_t h = 0xcbf29ce484222325u;
+    for (char c : sv) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3u;
+    }
+    return h;
+}
+
+std::uint64_t mix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15u;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9u;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebu;
+    return x ^ (x >> 31);
+}
+
 std::vector<std::string> splitOnChar(const char* str, char delim) {
     if (*str == '\0') {
         return {""};
@@ -258,7 +339,7 @@ std::vector<std::string> splitOnChar(const char* str, char delim) {
     const char* finger = str;
 
     for (;;) {
-        while (*finger != '\0' && *finger != ',') {
+        while (*finger != '\0' && *finger != delim) {
             finger++;
         }
         // note that start == finger indicates an empty element
@@ -280,7 +361,7 @@ std::vector<std::string> splitOnChar(const char* str, char delim) {
 
 std::optional<std::pair<std::string, std::string>>
 parseNameDigestPair(const char* s) {
-    const char* splitPtr = s.find('=');
+    const char* splitPtr = std::strchr(s, '=');
     if (splitPtr == nullptr) {
         return {};
     }
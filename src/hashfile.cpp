@@ -0,0 +1,477 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <xmphash/bufpool.hpp>
+#include <xmphash/counters.hpp>
+#include <xmphash/gitobj.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/kcrypto.hpp>
+#include <xmphash/latency.hpp>
+#include <xmphash/pressure.hpp>
+#include <xmphash/throttle.hpp>
+#include <xmphash/verity.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace mji::xmph {
+
+std::optional<std::string> finalizeToStr(Hasher& hasher) {
+    unsigned char digest[hash_max_digest_size];
+    if (!hasher.finalize(digest, sizeof(digest))) {
+        return {};
+    }
+    return hasher.formatDigest(digest);
+}
+
+FileHasher::FileHasher(const std::vector<std::string>& algoNames, std::uint64_t blockSize,
+    const FingerprintParams& fingerprintParams)
+: algoNames_(algoNames),
+  streamIdx_(),
+  hashers_(),
+  blockHashers_(),
+  fingerprintIdx_(),
+  fingerprintHashers_(),
+  verityIdx_(),
+  gitIdx_(),
+  gitHashers_(),
+  kernelNames_(),
+  fingerprintParams_(fingerprintParams),
+  blockSize_(blockSize),
+  canCheckpoint_(false),
+  positionalThreads_(1),
+  memoryBudget_(nullptr)
+{
+    for (std::size_t i = 0; i < algoNames_.size(); i++) {
+        const std::string& algoName = algoNames_[i];
+        if (isFingerprintAlgo(algoName)) {
+            fingerprintIdx_.push_back(i);
+            fingerprintHashers_.push_back(
+                makeHasher(algoName.substr(fingerprint_prefix.size())));
+            continue;
+        }
+        if (algoName == fsverity_algo_name) {
+            verityIdx_.push_back(i);
+            continue;
+        }
+        if (auto inner = gitInnerAlgo(algoName)) {
+            gitIdx_.push_back(i);
+            gitHashers_.push_back(makeHasher(*inner));
+            continue;
+        }
+        streamIdx_.push_back(i);
+        hashers_.push_back(makeHasher(algoName));
+        if (blockSize_ != 0) {
+            // block digests are joined with ':' and compared as hex bytes
+            if (algoName == "ssdeep" || algoName == "tlsh") {
+                throw std::invalid_argument("similarity digest \"" + algoName
+                    + "\" cannot be taken per block");
+            }
+            blockHashers_.push_back(makeHasher(algoName));
+        }
+    }
+
+    if (blockSize_ == 0 && !hashers_.empty()) {
+        std::vector<std::string> streamNames;
+        for (std::size_t idx : streamIdx_) {
+            streamNames.push_back(algoNames_[idx]);
+        }
+        kernelNames_ = kernelHashNames(streamNames);
+    }
+
+    std::vector<unsigned char> state;
+    canCheckpoint_ = blockSize_ == 0 && !hashers_.empty()
+        && std::all_of(hashers_.begin(), hashers_.end(), [&](const auto& hasher) {
+            return hasher->exportState(state);
+        });
+}
+
+void FileHasher::setPositionalThreads(unsigned int threads, MemoryBudget* budget) {
+    positionalThreads_ = std::max(1u, threads);
+    memoryBudget_ = budget;
+}
+
+bool FileHasher::canCheckpoint() const {
+    return canCheckpoint_;
+}
+
+bool FileHasher::resumeStream(std::FILE* fp, const StreamCheckpoint& checkpoint, FileDigests& out) {
+    if (checkpoint.states.size() != hashers_.size()
+        || !mji::xplat::seekFile(fp, checkpoint.offset))
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < hashers_.size(); i++) {
+        const auto& state = checkpoint.states[i];
+        if (!hashers_[i]->importState(state.data(), state.size())) {
+            return false;
+        }
+    }
+    out.size = checkpoint.offset;
+    return true;
+}
+
+void FileHasher::saveCheckpoint(const CheckpointHooks& hooks, std::uint64_t offset) {
+    StreamCheckpoint checkpoint;
+    checkpoint.offset = offset;
+    checkpoint.states.resize(hashers_.size());
+    for (std::size_t i = 0; i < hashers_.size(); i++) {
+        if (!hashers_[i]->exportState(checkpoint.states[i])) {
+            return;
+        }
+    }
+    hooks.save(checkpoint);
+}
+
+bool FileHasher::needsStream() const {
+    return !hashers_.empty();
+}
+
+bool FileHasher::hasPositional() const {
+    return !fingerprintHashers_.empty() || !verityIdx_.empty() || !gitHashers_.empty();
+}
+
+const std::vector<std::string>& FileHasher::algoNames() const {
+    return algoNames_;
+}
+
+std::uint64_t FileHasher::blockSize() const {
+    return blockSize_;
+}
+
+std::size_t FileHasher::workingSetSize() const {
+    return sizeof(FileHasher) + pool_buffer_size + hasherStateSize
+        * (hashers_.size() + blockHashers_.size() + fingerprintHashers_.size() + gitHashers_.size());
+}
+
+std::uint64_t FileHasher::digestsSize(std::uint64_t fileSize) const {
+    // hex digests, each in its own string
+    std::uint64_t size = sizeof(FileDigests);
+    for (const auto& hasher : hashers_) {
+        size += sizeof(std::string) + 2 * hasher->getDigestSize();
+    }
+    for (const auto& hasher : fingerprintHashers_) {
+        size += sizeof(std::string) + 2 * hasher->getDigestSize();
+    }
+    for (const auto& hasher : gitHashers_) {
+        size += sizeof(std::string) + 2 * hasher->getDigestSize();
+    }
+    size += verityIdx_.size() * (sizeof(std::string) + 2 * 32);
+    if (blockSize_ != 0) {
+        std::uint64_t blocks = fileSize / blockSize_ + 1;
+        for (const auto& hasher : blockHashers_) {
+            size += sizeof(std::vector<std::string>)
+                + blocks * (sizeof(std::string) + 2 * hasher->getDigestSize());
+        }
+    }
+    return size;
+}
+
+bool FileHasher::consumeAll(const unsigned char* data, std::size_t count, const char* displayName) {
+    for (auto& hasher : hashers_) {
+        CountedSection counted(hasher->getName(), count);
+        if (!hasher->consume(data, count)) {
+            std::fprintf(stderr, "%s: hasher \"%s\" failed to consume data\n",
+                displayName, hasher->getName());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileHasher::finishBlock(FileDigests& out, const char* displayName) {
+    for (std::size_t i = 0; i < blockHashers_.size(); i++) {
+        auto digest = finalizeToStr(*blockHashers_[i]);
+        if (!digest || !blockHashers_[i]->reset()) {
+            std::fprintf(stderr, "%s: failed to finalize block hasher \"%s\"\n",
+                displayName, blockHashers_[i]->getName());
+            return false;
+        }
+        out.blockDigests[i].push_back(std::move(*digest));
+    }
+    return true;
+}
+
+bool FileHasher::hashStream(std::FILE* fp, const char* displayName, FileDigests& out,
+    const CheckpointHooks* hooks)
+{
+    for (auto& hasher : hashers_) {
+        hasher->reset();
+    }
+    for (auto& hasher : blockHashers_) {
+        hasher->reset();
+    }
+    out.size = 0;
+    out.digests.resize(algoNames_.size());
+    out.blockDigests.assign(blockHashers_.size(), {});
+
+    if (!canCheckpoint_) {
+        hooks = nullptr;
+    }
+    if (hooks != nullptr && hooks->resumeFrom != nullptr) {
+        if (!resumeStream(fp, *hooks->resumeFrom, out)) {
+            // start over from the beginning
+            std::fprintf(stderr, "%s: unable to resume from checkpoint\n", displayName);
+            for (auto& hasher : hashers_) {
+                hasher->reset();
+            }
+            out.size = 0;
+            if (!mji::xplat::seekFile(fp, 0)) {
+                return false;
+            }
+        }
+    }
+    std::uint64_t nextCheckpoint = (hooks != nullptr && hooks->interval != 0)
+        ? out.size + hooks->interval : ~std::uint64_t(0);
+
+    std::uint64_t blockFill = 0;
+    std::uint64_t droppedTo = out.size;
+    PooledBuffer buffer = PooledBuffer::acquire();
+    unsigned char* inBuf = buffer.data();
+    if (inBuf == nullptr) {
+        std::fprintf(stderr, "%s: unable to allocate a read buffer\n", displayName);
+        return false;
+    }
+    // this is the critical loop
+    for (;;) {
+        std::size_t want = pressureReadSize(readSize);
+        throttleRead(want);
+        std::uint64_t readStart = latencyStart();
+        std::size_t bytesRead = std::fread(inBuf, 1, want, fp);
+        recordReadLatency(readStart);
+        refundRead(want - bytesRead);
+        if (bytesRead == 0) {
+            if (std::feof(fp)) {
+                break;
+            } else {
+                std::fprintf(stderr, "%s: failed while reading data from file\n", displayName);
+                return false;
+            }
+        }
+        out.size += bytesRead;
+
+        if (!consumeAll(inBuf, bytesRead, displayName)) {
+            return false;
+        }
+        if (out.size - droppedTo >= dropCacheInterval) {
+            mji::xplat::dropCache(fp, droppedTo, out.size - droppedTo);
+            droppedTo = out.size;
+        }
+        if (out.size >= nextCheckpoint) {
+            saveCheckpoint(*hooks, out.size);
+            nextCheckpoint = out.size + hooks->interval;
+        }
+
+        // split the chunk on block boundaries for the block hashers
+        std::size_t pos = 0;
+        while (blockSize_ != 0 && pos < bytesRead) {
+            std::size_t take = static_cast<std::size_t>(
+                std::min<std::uint64_t>(bytesRead - pos, blockSize_ - blockFill));
+            for (auto& hasher : blockHashers_) {
+                CountedSection counted(hasher->getName(), take);
+                if (!hasher->consume(inBuf + pos, take)) {
+                    std::fprintf(stderr, "%s: block hasher \"%s\" failed to consume data\n",
+                        displayName, hasher->getName());
+                    return false;
+                }
+            }
+            pos += take;
+            blockFill += take;
+            if (blockFill == blockSize_) {
+                if (!finishBlock(out, displayName)) {
+                    return false;
+                }
+                blockFill = 0;
+            }
+        }
+    }
+
+    mji::xplat::dropCache(fp, droppedTo, out.size - droppedTo);
+
+    if (blockFill != 0 && !finishBlock(out, displayName)) {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < hashers_.size(); i++) {
+        auto digest = finalizeToStr(*hashers_[i]);
+        if (!digest) {
+            std::fprintf(stderr, "%s: failed to finalize hasher \"%s\"\n",
+                displayName, hashers_[i]->getName());
+            return false;
+        }
+        out.digests[streamIdx_[i]] = std::move(*digest);
+    }
+
+    return true;
+}
+
+bool FileHasher::hashKernel(const char* path, FileDigests& out) {
+    mji::xplat::InFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    std::vector<std::vector<unsigned char>> raw;
+    std::uint64_t droppedTo = 0;
+    // each splice is charged before it reads, as in throttledReadAt, and
+    // what it did not move is refunded once it is known
+    std::size_t charged = 0;
+    auto size = mji::xplat::kernelHashFile(file, *kernelNames_, raw,
+        [&](std::size_t want) {
+            throttleRead(want);
+            charged = want;
+        },
+        [&](std::uint64_t offset, std::uint64_t length) {
+            refundRead(charged - static_cast<std::size_t>(length));
+            charged = 0;
+            if (offset + length - droppedTo >= dropCacheInterval) {
+                file.dropCache(droppedTo, offset + length - droppedTo);
+                droppedTo = offset + length;
+            }
+        });
+    // the last splice, at the end of the file or failing, moved nothing
+    refundRead(charged);
+    if (!size) {
+        return false;
+    }
+    file.dropCache(droppedTo, *size - droppedTo);
+    for (std::size_t i = 0; i < hashers_.size(); i++) {
+        if (raw[i].size() != hashers_[i]->getDigestSize()) {
+            return false;
+        }
+    }
+
+    out.size = *size;
+    out.digests.resize(algoNames_.size());
+    out.blockDigests.clear();
+    for (std::size_t i = 0; i < hashers_.size(); i++) {
+        out.digests[streamIdx_[i]] = hashers_[i]->formatDigest(raw[i].data());
+    }
+    return true;
+}
+
+bool FileHasher::hashPositional(const char* path, FileDigests& out) {
+    out.digests.resize(algoNames_.size());
+
+    mji::xplat::InFile file;
+    if (!file.open(path)) {
+        std::fprintf(stderr, "%s: unable to open file for positional reads\n", path);
+        return false;
+    }
+    auto size = file.size();
+    if (!size) {
+        std::fprintf(stderr, "%s: unable to determine file size\n", path);
+        return false;
+    }
+    out.size = *size;
+
+    for (std::size_t i = 0; i < fingerprintHashers_.size(); i++) {
+        auto digest = computeFingerprint(file, *size, *fingerprintHashers_[i], fingerprintParams_);
+        if (!digest) {
+            std::fprintf(stderr, "%s: failed to compute \"%s\"\n",
+                path, algoNames_[fingerprintIdx_[i]].c_str());
+            return false;
+        }
+        out.digests[fingerprintIdx_[i]] = std::move(*digest);
+    }
+
+    for (std::size_t idx : verityIdx_) {
+        auto digest = computeFsVerityDigest(file, *size, positionalThreads_, memoryBudget_);
+        if (!digest) {
+            std::fprintf(stderr, "%s: failed to compute \"%s\"\n", path, algoNames_[idx].c_str());
+            return false;
+        }
+        out.digests[idx] = std::move(*digest);
+    }
+
+    for (std::size_t i = 0; i < gitHashers_.size(); i++) {
+        auto digest = computeGitBlobId(file, *size, *gitHashers_[i]);
+        if (!digest) {
+            std::fprintf(stderr, "%s: failed to compute \"%s\"\n",
+                path, algoNames_[gitIdx_[i]].c_str());
+            return false;
+        }
+        out.digests[gitIdx_[i]] = std::move(*digest);
+    }
+
+    return true;
+}
+
+bool FileHasher::hashFile(const std::string& path, bool binaryMode, FileDigests& out,
+    const CheckpointHooks* hooks)
+{
+    bool isStdin = (path == "-");
+    if (isStdin && hasPositional()) {
+        std::fprintf(stderr, "Fingerprints, fs-verity digests and git IDs cannot be taken of standard input\n");
+        return false;
+    }
+
+    bool hashed = false;
+    if (needsStream() && kernelHashing() && kernelNames_ && !isStdin && binaryMode
+        && hooks == nullptr)
+    {
+        hashed = hashKernel(path.c_str(), out);
+    }
+
+    if (needsStream() && !hashed) {
+        errno = 0;
+        CFileWrapper inFile{nullptr};
+        if (isStdin) {
+            if (binaryMode && !mji::xplat::reopenStdinAsBinary()) {
+                std::fprintf(stderr, "Failed to reopen stdin as binary\n");
+                return false;
+            }
+        } else {
+            inFile.fp = mji::xplat::openInputStream(path.c_str(), binaryMode);
+            if (inFile.fp == nullptr) {
+                std::fprintf(stderr, "%s: unable to open file: %s\n",
+                    path.c_str(), std::strerror(errno));
+                return false;
+            }
+        }
+        // offsets into text mode streams and stdin cannot be seeked back to
+        if (isStdin || !binaryMode) {
+            hooks = nullptr;
+        }
+        if (!hashStream(isStdin ? stdin : inFile.fp, path.c_str(), out, hooks)) {
+            return false;
+        }
+    }
+
+    if (hasPositional()) {
+        return hashPositional(path.c_str(), out);
+    }
+    return true;
+}
+
+ManifestEntry toManifestEntry(const std::vector<std::string>& algoNames, std::uint64_t blockSize,
+    const FileDigests& digests, std::string path)
+{
+    ManifestEntry entry;
+    entry.fields.emplace_back("size", std::to_string(digests.size));
+    for (std::size_t i = 0; i < algoNames.size() && i < digests.digests.size(); i++) {
+        entry.fields.emplace_back(algoNames[i], digests.digests[i]);
+    }
+    // block digests are parallel to the streaming algorithms
+    std::size_t block = 0;
+    for (const std::string& algoName : algoNames) {
+        if (block == digests.blockDigests.size()) {
+            break;
+        }
+        if (isFingerprintAlgo(algoName) || algoName == fsverity_algo_name || gitInnerAlgo(algoName)) {
+            continue;
+        }
+        std::string joined;
+        for (const auto& blockDigest : digests.blockDigests[block]) {
+            if (!joined.empty()) {
+                joined += ':';
+            }
+            joined += blockDigest;
+        }
+        entry.fields.emplace_back(algoName + "@" + std::to_string(blockSize), std::move(joined));
+        block++;
+    }
+    entry.path = std::move(path);
+    return entry;
+}
+
+}  // namespace mji::xmph
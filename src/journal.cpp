@@ -0,0 +1,252 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+#include <xmphash/hasher.hpp>
+#include <xmphash/journal.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace fs = std::filesystem;
+
+namespace mji::xmph {
+
+namespace {
+
+std::string formatCheckpoint(const std::string& path, const StreamCheckpoint& checkpoint) {
+    std::string record = "C " + std::to_string(checkpoint.offset) + " ";
+    for (std::size_t i = 0; i < checkpoint.states.size(); i++) {
+        if (i != 0) {
+            record += ':';
+        }
+        record += bytesToStr(checkpoint.states[i].data(), checkpoint.states[i].size());
+    }
+    record += ' ';
+    record += path;
+    return record;
+}
+
+/// Parses the body of a C record (after "C ")
+bool parseCheckpoint(std::string_view body, std::string& path, StreamCheckpoint& checkpoint) {
+    std::size_t offsetEnd = body.find(' ');
+    if (offsetEnd == std::string_view::npos) {
+        return false;
+    }
+    std::size_t statesEnd = body.find(' ', offsetEnd + 1);
+    if (statesEnd == std::string_view::npos) {
+        return false;
+    }
+
+    std::string offsetStr(body.substr(0, offsetEnd));
+    char* end = nullptr;
+    errno = 0;
+    checkpoint.offset = std::strtoull(offsetStr.c_str(), &end, 10);
+    if (end == offsetStr.c_str() || *end != '\0' || errno != 0) {
+        return false;
+    }
+
+    checkpoint.states.clear();
+    std::string_view states = body.substr(offsetEnd + 1, statesEnd - offsetEnd - 1);
+    for (;;) {
+        std::size_t colon = states.find(':');
+        auto bytes = strToBytes(states.substr(0, colon));
+        if (!bytes) {
+            return false;
+        }
+        checkpoint.states.push_back(std::move(*bytes));
+        if (colon == std::string_view::npos) {
+            break;
+        }
+        states.remove_prefix(colon + 1);
+    }
+
+    path.assign(body.substr(statesEnd + 1));
+    return true;
+}
+
+}  // namespace
+
+Journal::Journal()
+: mutex_(),
+  fp_(nullptr),
+  path_(),
+  completed_(),
+  checkpoints_(),
+  pending_(),
+  pendingRecords_(0),
+  lastCommit_(std::chrono::steady_clock::now())
+{}
+
+Journal::~Journal() {
+    if (fp_ != nullptr) {
+        commit();
+        std::fclose(fp_);
+    }
+}
+
+bool Journal::open(const char* path, const std::string& runKey, bool resume) {
+    path_ = path;
+    if (resume && fs::exists(path_)) {
+        if (!load(runKey)) {
+            return false;
+        }
+    }
+    if (!rewrite(runKey)) {
+        return false;
+    }
+
+    fp_ = std::fopen(path, "ab");
+    if (fp_ == nullptr) {
+        std::fprintf(stderr, "%s: unable to open journal: %s\n", path, std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool Journal::load(const std::string& runKey) {
+    CFileWrapper in(std::fopen(path_.c_str(), "rb"));
+    if (in.fp == nullptr) {
+        std::fprintf(stderr, "%s: unable to open journal: %s\n", path_.c_str(), std::strerror(errno));
+        return false;
+    }
+    std::string data;
+    char buf[1 << 16];
+    std::size_t got;
+    while ((got = std::fread(buf, 1, sizeof(buf), in.fp)) > 0) {
+        data.append(buf, got);
+    }
+    if (std::ferror(in.fp)) {
+        std::fprintf(stderr, "%s: unable to read journal\n", path_.c_str());
+        return false;
+    }
+
+    std::size_t pos = 0;
+    bool first = true;
+    for (;;) {
+        std::size_t term = data.find('\0', pos);
+        if (term == std::string::npos) {
+            // anything left is a torn record
+            break;
+        }
+        std::string_view record(data.data() + pos, term - pos);
+        pos = term + 1;
+
+        if (first) {
+            if (record.substr(0, 2) != "H " || record.substr(2) != runKey) {
+                std::fprintf(stderr, "%s: journal is for a different run (%.*s)\n", path_.c_str(),
+                    static_cast<int>(record.size()), record.data());
+                return false;
+            }
+            first = false;
+        } else if (record.substr(0, 2) == "D ") {
+            std::string_view manifestRecord = record.substr(2);
+            std::size_t spaceIdx = manifestRecord.find(' ');
+            if (spaceIdx != std::string_view::npos) {
+                std::string filePath(manifestRecord.substr(spaceIdx + 1));
+                checkpoints_.erase(filePath);
+                completed_[std::move(filePath)] = std::string(manifestRecord);
+            }
+        } else if (record.substr(0, 2) == "C ") {
+            std::string filePath;
+            StreamCheckpoint checkpoint;
+            if (parseCheckpoint(record.substr(2), filePath, checkpoint)
+                && completed_.count(filePath) == 0)
+            {
+                checkpoints_[std::move(filePath)] = std::move(checkpoint);
+            }
+        }
+    }
+
+    std::fprintf(stderr, "%s: resuming after %zu completed files (%zu in progress)\n",
+        path_.c_str(), completed_.size(), checkpoints_.size());
+    return true;
+}
+
+bool Journal::rewrite(const std::string& runKey) {
+    std::string tempPath = path_ + ".tmp";
+    CFileWrapper out(std::fopen(tempPath.c_str(), "wb"));
+    if (out.fp == nullptr) {
+        std::fprintf(stderr, "%s: unable to write journal: %s\n", tempPath.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    bool ok = true;
+    auto put = [&](const std::string& record) {
+        ok = ok && std::fwrite(record.c_str(), 1, record.size() + 1, out.fp) == record.size() + 1;
+    };
+    put("H " + runKey);
+    for (const auto& completed : completed_) {
+        put("D " + completed.second);
+    }
+    for (const auto& checkpoint : checkpoints_) {
+        put(formatCheckpoint(checkpoint.first, checkpoint.second));
+    }
+    ok = mji::xplat::syncFile(out.fp) && ok;
+    ok = (out.close() == 0) && ok;
+
+    std::error_code ec;
+    if (ok) {
+        fs::rename(tempPath, path_, ec);
+    }
+    if (!ok || ec) {
+        std::fprintf(stderr, "%s: unable to write journal\n", path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+const std::string* Journal::completedRecord(const std::string& path) const {
+    auto it = completed_.find(path);
+    return (it == completed_.end()) ? nullptr : &it->second;
+}
+
+const StreamCheckpoint* Journal::checkpoint(const std::string& path) const {
+    auto it = checkpoints_.find(path);
+    return (it == checkpoints_.end()) ? nullptr : &it->second;
+}
+
+bool Journal::recordCompleted(const std::string& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ += "D ";
+    pending_ += record;
+    pending_ += '\0';
+    pendingRecords_++;
+    if (pendingRecords_ >= commit_records
+        || std::chrono::steady_clock::now() - lastCommit_ >= commit_interval)
+    {
+        return commitLocked();
+    }
+    return true;
+}
+
+bool Journal::recordCheckpoint(const std::string& path, const StreamCheckpoint& checkpoint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ += formatCheckpoint(path, checkpoint);
+    pending_ += '\0';
+    pendingRecords_++;
+    return commitLocked();
+}
+
+bool Journal::commit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return commitLocked();
+}
+
+bool Journal::commitLocked() {
+    lastCommit_ = std::chrono::steady_clock::now();
+    if (pendingRecords_ == 0) {
+        return true;
+    }
+    bool ok = std::fwrite(pending_.data(), 1, pending_.size(), fp_) == pending_.size()
+        && mji::xplat::syncFile(fp_);
+    pending_.clear();
+    pendingRecords_ = 0;
+    if (!ok) {
+        std::fprintf(stderr, "%s: unable to write journal\n", path_.c_str());
+    }
+    return ok;
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,47 @@
+#include <xmphash/kcrypto.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+bool kernelHashingEnabled = false;
+
+}  // namespace
+
+void setKernelHashing(bool enabled) {
+    kernelHashingEnabled = enabled;
+}
+
+bool kernelHashing() {
+    return kernelHashingEnabled;
+}
+
+std::optional<std::string> kernelHashName(const std::string& algoName) {
+    // our names match the kernel's for everything it offers
+    static const char* const supported[] = {
+        "md5", "sha1", "sha224", "sha256", "sha384", "sha512",
+        "sha3-224", "sha3-256", "sha3-384", "sha3-512"
+    };
+    for (const char* name : supported) {
+        if (algoName == name) {
+            return algoName;
+        }
+    }
+    return {};
+}
+
+std::optional<std::vector<std::string>> kernelHashNames(
+    const std::vector<std::string>& algoNames)
+{
+    std::vector<std::string> names;
+    for (const auto& algoName : algoNames) {
+        auto name = kernelHashName(algoName);
+        if (!name) {
+            return {};
+        }
+        names.push_back(std::move(*name));
+    }
+    return names;
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <xmphash/fingerprint.hpp>
+#include <xmphash/gitobj.hpp>
+#include <xmphash/hasher.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/knownset.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr char known_magic[8] = {'X', 'M', 'P', 'H', 'K', 'S', 'E', 'T'};
+constexpr std::uint32_t known_version = 1;
+constexpr std::size_t known_header_size = 64;
+constexpr std::size_t known_algo_name_size = 32;
+constexpr std::size_t bloom_block_size = 64;
+constexpr std::uint64_t bloom_bits_per_entry = 10;
+constexpr unsigned int bloom_hashes = 7;
+
+void putLe32(unsigned char* buf, std::uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        buf[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+}
+
+void putLe64(unsigned char* buf, std::uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        buf[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+}
+
+std::uint32_t getLe32(const unsigned char* buf) {
+    std::uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) {
+        v = (v << 8) | buf[i];
+    }
+    return v;
+}
+
+std::uint64_t getLe64(const unsigned char* buf) {
+    std::uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | buf[i];
+    }
+    return v;
+}
+
+/// The first 8 bytes of a digest as a big-endian number, zero-padded, so
+/// that numeric order matches memcmp order
+std::uint64_t digestPrefix(const unsigned char* digest, std::size_t size) {
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < 8; i++) {
+        v = (v << 8) | (i < size ? digest[i] : 0);
+    }
+    return v;
+}
+
+/// Block index and in-block bit positions for a digest. Each of the
+/// bloom_hashes positions takes 9 bits of a second mixed hash.
+std::pair<std::uint64_t, std::uint64_t> bloomHash(const unsigned char* digest,
+    std::size_t size, std::uint64_t blocks)
+{
+    std::uint64_t h = mix64(stableHash64(
+        std::string_view(reinterpret_cast<const char*>(digest), size)));
+    return {h % blocks, mix64(h)};
+}
+
+void bloomAdd(unsigned char* bloom, const unsigned char* digest, std::size_t size,
+    std::uint64_t blocks)
+{
+    auto [block, bits] = bloomHash(digest, size, blocks);
+    unsigned char* blockPtr = bloom + block * bloom_block_size;
+    for (unsigned int i = 0; i < bloom_hashes; i++) {
+        unsigned int bit = (bits >> (9 * i)) & 511u;
+        blockPtr[bit / 8] |= static_cast<unsigned char>(1u << (bit % 8));
+    }
+}
+
+bool bloomMayContain(const unsigned char* bloom, const unsigned char* digest,
+    std::size_t size, std::uint64_t blocks)
+{
+    auto [block, bits] = bloomHash(digest, size, blocks);
+    const unsigned char* blockPtr = bloom + block * bloom_block_size;
+    for (unsigned int i = 0; i < bloom_hashes; i++) {
+        unsigned int bit = (bits >> (9 * i)) & 511u;
+        if ((blockPtr[bit / 8] & (1u << (bit % 8))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Buckets smaller than this are finished by insertion sort
+constexpr std::size_t radix_cutoff = 32;
+
+void swapRecords(unsigned char* a, unsigned char* b, std::size_t width) {
+    std::swap_ranges(a, a + width, b);
+}
+
+/// Sorts count records of width bytes into memcmp order in place, given
+/// that they already agree on their first depth bytes. An MSD radix sort
+/// (American flag sort): records are permuted into 256 buckets by the byte
+/// at depth, each bucket is sorted on the next byte, and small buckets are
+/// finished by insertion sort. Digests are uniformly distributed, so after
+/// a few bytes every bucket is small.
+void sortRecords(unsigned char* base, std::size_t count, std::size_t width, std::size_t depth) {
+    if (count < radix_cutoff || depth == width) {
+        for (std::size_t i = 1; i < count; i++) {
+            for (std::size_t j = i; j > 0; j--) {
+                unsigned char* cur = base + j * width;
+                if (std::memcmp(cur - width + depth, cur + depth, width - depth) <= 0) {
+                    break;
+                }
+                swapRecords(cur - width, cur, width);
+            }
+        }
+        return;
+    }
+
+    std::size_t counts[256] = {};
+    for (std::size_t i = 0; i < count; i++) {
+        counts[base[i * width + depth]]++;
+    }
+    std::size_t next[256];
+    std::size_t ends[256];
+    std::size_t start = 0;
+    for (unsigned int b = 0; b < 256; b++) {
+        next[b] = start;
+        start += counts[b];
+        ends[b] = start;
+    }
+    for (unsigned int b = 0; b < 256; b++) {
+        while (next[b] < ends[b]) {
+            unsigned char* record = base + next[b] * width;
+            unsigned char byte = record[depth];
+            if (byte == b) {
+                next[b]++;
+            } else {
+                swapRecords(record, base + next[byte] * width, width);
+                next[byte]++;
+            }
+        }
+    }
+
+    start = 0;
+    for (unsigned int b = 0; b < 256; b++) {
+        if (counts[b] > 1) {
+            sortRecords(base + start * width, counts[b], width, depth + 1);
+        }
+        start += counts[b];
+    }
+}
+
+/// Size in bytes of the digests of an algorithm, or 0 if its digests are not
+/// fixed-size hex strings
+std::size_t knownDigestSize(const std::string& algoName) {
+    std::string inner = isFingerprintAlgo(algoName)
+        ? algoName.substr(fingerprint_prefix.size()) : gitInnerAlgo(algoName).value_or(algoName);
+    if (inner == "ssdeep" || inner == "tlsh") {
+        return 0;
+    }
+    try {
+        return makeHasher(inner)->getDigestSize();
+    } catch (const std::invalid_argument&) {
+        return 0;
+    }
+}
+
+}  // namespace
+
+bool buildKnownSet(const char* listPath, const std::string& algoName, const char* indexPath) {
+    std::size_t digestSize = knownDigestSize(algoName);
+    if (digestSize == 0 || algoName.size() >= known_algo_name_size) {
+        std::fprintf(stderr, "%s: algorithm cannot be used for a known set\n", algoName.c_str());
+        return false;
+    }
+
+    mji::xplat::MappedFile list;
+    if (!list.open(listPath)) {
+        std::fprintf(stderr, "%s: unable to open file\n", listPath);
+        return false;
+    }
+
+    // parse every digest into one flat buffer of fixed-width records, which
+    // is then sorted and deduplicated in place: for hundreds of millions of
+    // digests, even a pointer per entry would cost gigabytes
+    std::vector<unsigned char> flat;
+    std::uint64_t skipped = 0;
+    const char* data = list.data();
+    std::size_t size = list.size();
+    std::size_t pos = 0;
+    while (pos < size) {
+        auto nl = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        std::size_t end = (nl == nullptr) ? size : static_cast<std::size_t>(nl - data);
+        std::string_view line(data + pos, end - pos);
+        pos = end + 1;
+
+        if (!line.empty() && line[0] == '"') {
+            line.remove_prefix(1);
+        }
+        std::size_t hexLen = 2 * digestSize;
+        bool terminated = line.size() == hexLen
+            || (line.size() > hexLen && !std::isxdigit(static_cast<unsigned char>(line[hexLen])));
+        auto bytes = terminated ? strToBytes(line.substr(0, hexLen)) : std::nullopt;
+        if (!bytes) {
+            if (!line.empty() && line[0] != '#' && line != "\r") {
+                skipped++;
+            }
+            continue;
+        }
+        flat.insert(flat.end(), bytes->begin(), bytes->end());
+    }
+
+    // everything needed from the list is in flat now
+    list.close();
+
+    sortRecords(flat.data(), flat.size() / digestSize, digestSize, 0);
+    std::size_t kept = 0;
+    for (std::size_t off = 0; off < flat.size(); off += digestSize) {
+        if (kept == 0 || std::memcmp(flat.data() + kept - digestSize, flat.data() + off, digestSize) != 0) {
+            std::memmove(flat.data() + kept, flat.data() + off, digestSize);
+            kept += digestSize;
+        }
+    }
+    flat.resize(kept);
+
+    std::uint64_t count = flat.size() / digestSize;
+    std::uint64_t bloomBlocks = std::max<std::uint64_t>(1,
+        (count * bloom_bits_per_entry + bloom_block_size * 8 - 1) / (bloom_block_size * 8));
+    std::vector<unsigned char> bloom(bloomBlocks * bloom_block_size);
+    for (std::size_t off = 0; off < flat.size(); off += digestSize) {
+        bloomAdd(bloom.data(), flat.data() + off, digestSize, bloomBlocks);
+    }
+
+    unsigned char header[known_header_size] = {};
+    std::memcpy(header, known_magic, sizeof(known_magic));
+    putLe32(header + 8, known_version);
+    putLe32(header + 12, static_cast<std::uint32_t>(digestSize));
+    putLe64(header + 16, count);
+    putLe64(header + 24, bloomBlocks);
+    std::memcpy(header + 32, algoName.data(), algoName.size());
+
+    CFileWrapper out(std::fopen(indexPath, "wb"));
+    if (out.fp == nullptr) {
+        std::fprintf(stderr, "%s: unable to open file for writing\n", indexPath);
+        return false;
+    }
+    bool ok = std::fwrite(header, 1, sizeof(header), out.fp) == sizeof(header)
+        && std::fwrite(bloom.data(), 1, bloom.size(), out.fp) == bloom.size()
+        && std::fwrite(flat.data(), 1, flat.size(), out.fp) == flat.size();
+    if (out.close() != 0 || !ok) {
+        std::fprintf(stderr, "%s: write failed\n", indexPath);
+        return false;
+    }
+
+    std::fprintf(stderr, "%s: %llu %s digests indexed, %llu lines skipped\n", indexPath,
+        static_cast<unsigned long long>(count), algoName.c_str(),
+        static_cast<unsigned long long>(skipped));
+    return true;
+}
+
+// KnownSet
+
+KnownSet::KnownSet()
+: file_(),
+  algoName_(),
+  digestSize_(0),
+  count_(0),
+  bloomBlocks_(0),
+  bloom_(nullptr),
+  digests_(nullptr)
+{}
+
+bool KnownSet::open(const char* path) {
+    if (!file_.open(path)) {
+        std::fprintf(stderr, "%s: unable to map known set\n", path);
+        return false;
+    }
+    auto base = reinterpret_cast<const unsigned char*>(file_.data());
+    std::size_t size = file_.size();
+    if (size < known_header_size || std::memcmp(base, known_magic, sizeof(known_magic)) != 0
+        || getLe32(base + 8) != known_version)
+    {
+        std::fprintf(stderr, "%s: not a known set index\n", path);
+        return false;
+    }
+
+    digestSize_ = getLe32(base + 12);
+    count_ = getLe64(base + 16);
+    bloomBlocks_ = getLe64(base + 24);
+    const char* name = reinterpret_cast<const char*>(base + 32);
+    algoName_.assign(name, std::find(name, name + known_algo_name_size, '\0'));
+
+    std::uint64_t expected = known_header_size + bloomBlocks_ * bloom_block_size
+        + count_ * digestSize_;
+    if (digestSize_ == 0 || digestSize_ > hash_max_digest_size || bloomBlocks_ == 0
+        || expected != size)
+    {
+        std::fprintf(stderr, "%s: corrupt known set index\n", path);
+        return false;
+    }
+    bloom_ = base + known_header_size;
+    digests_ = bloom_ + bloomBlocks_ * bloom_block_size;
+    return true;
+}
+
+const std::string& KnownSet::algoName() const {
+    return algoName_;
+}
+
+std::uint64_t KnownSet::count() const {
+    return count_;
+}
+
+bool KnownSet::contains(const unsigned char* digest) const {
+    if (count_ == 0 || !bloomMayContain(bloom_, digest, digestSize_, bloomBlocks_)) {
+        return false;
+    }
+
+    std::uint64_t key = digestPrefix(digest, digestSize_);
+    std::uint64_t lo = 0;
+    std::uint64_t hi = count_ - 1;
+    for (unsigned int round = 0; lo <= hi; round++) {
+        std::uint64_t keyLo = digestPrefix(digests_ + lo * digestSize_, digestSize_);
+        std::uint64_t keyHi = digestPrefix(digests_ + hi * digestSize_, digestSize_);
+        if (key < keyLo || key > keyHi) {
+            return false;
+        }
+
+        std::uint64_t mid;
+        if (keyHi == keyLo || round >= 8) {
+            // degenerate range, or interpolation is not converging: bisect
+            mid = lo + (hi - lo) / 2;
+        } else {
+            long double frac = static_cast<long double>(key - keyLo)
+                / static_cast<long double>(keyHi - keyLo);
+            mid = lo + static_cast<std::uint64_t>(frac * static_cast<long double>(hi - lo));
+            mid = std::min(mid, hi);
+        }
+
+        int cmp = std::memcmp(digests_ + mid * digestSize_, digest, digestSize_);
+        if (cmp == 0) {
+            return true;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else if (mid == 0) {
+            return false;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return false;
+}
+
+bool KnownSet::containsHex(std::string_view hex) const {
+    if (hex.size() != 2 * digestSize_) {
+        return false;
+    }
+    auto bytes = strToBytes(hex);
+    return bytes && contains(bytes->data());
+}
+
+}  // namespace mji::xmph
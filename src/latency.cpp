@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <xmphash/latency.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct SlowFile {
+    std::uint64_t nanos;
+    std::uint64_t size;
+    std::string path;
+
+    bool operator>(const SlowFile& other) const {
+        return nanos > other.nanos;
+    }
+};
+
+/// What one thread records
+struct Recorder {
+    LatencyHistogram files;
+    LatencyHistogram reads;
+    /// A min-heap of the slowest files, so the fastest of them is replaced
+    std::vector<SlowFile> slowest;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Recorder>> recorders;
+    std::atomic<bool> enabled{false};
+    std::size_t slowFileCount = 0;
+};
+
+Registry registry;
+
+thread_local Recorder* threadRecorder = nullptr;
+
+Recorder& recorder() {
+    if (threadRecorder == nullptr) {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.recorders.push_back(std::make_unique<Recorder>());
+        threadRecorder = registry.recorders.back().get();
+    }
+    return *threadRecorder;
+}
+
+std::uint64_t nowNanos() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+}
+
+/// Formats a duration with three significant digits
+std::string formatNanos(std::uint64_t nanos) {
+    static const char* const units[] = {"ns", "us", "ms", "s"};
+    double value = static_cast<double>(nanos);
+    std::size_t unit = 0;
+    while (value >= 1000.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1000.0;
+        unit++;
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), (unit == 0 || value >= 100.0) ? "%.0f%s" : "%.3g%s",
+        value, units[unit]);
+    return buf;
+}
+
+void printPercentiles(std::FILE* out, const char* label, const LatencyHistogram& histogram) {
+    std::fprintf(out, "  %-9s p50 %-8s p99 %-8s p99.9 %-8s max %s\n", label,
+        formatNanos(histogram.quantile(0.5)).c_str(),
+        formatNanos(histogram.quantile(0.99)).c_str(),
+        formatNanos(histogram.quantile(0.999)).c_str(),
+        formatNanos(histogram.max()).c_str());
+}
+
+}  // namespace
+
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram()
+: counts_(std::make_unique<std::atomic<std::uint64_t>[]>(bucket_count)),
+  total_(0),
+  max_(0)
+{
+    for (std::size_t i = 0; i < bucket_count; i++) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::size_t LatencyHistogram::indexOf(std::uint64_t nanos) {
+    if (nanos < 2 * sub_buckets) {
+        return static_cast<std::size_t>(nanos);
+    }
+    unsigned int msb = 63;
+    while ((nanos >> msb) == 0) {
+        msb--;
+    }
+    unsigned int shift = msb - sub_bucket_bits;
+    std::size_t sub = static_cast<std::size_t>(nanos >> shift) - sub_buckets;
+    return (shift + 1) * sub_buckets + sub;
+}
+
+std::uint64_t LatencyHistogram::valueAt(std::size_t index) {
+    if (index < 2 * sub_buckets) {
+        return index;
+    }
+    unsigned int shift = static_cast<unsigned int>(index / sub_buckets) - 1;
+    std::uint64_t low = static_cast<std::uint64_t>(index % sub_buckets + sub_buckets) << shift;
+    return low + ((std::uint64_t(1) << shift) >> 1);
+}
+
+void LatencyHistogram::record(std::uint64_t nanos) {
+    counts_[indexOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t seen = max_.load(std::memory_order_relaxed);
+    while (nanos > seen && !max_.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < bucket_count; i++) {
+        counts_[i].fetch_add(other.counts_[i].load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+    }
+    total_.fetch_add(other.count(), std::memory_order_relaxed);
+    std::uint64_t otherMax = other.max();
+    std::uint64_t seen = max_.load(std::memory_order_relaxed);
+    while (otherMax > seen && !max_.compare_exchange_weak(seen, otherMax, std::memory_order_relaxed)) {}
+}
+
+std::uint64_t LatencyHistogram::count() const {
+    return total_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::max() const {
+    return max_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::quantile(double q) const {
+    std::uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    // the rank of the value, counted from 1
+    auto rank = static_cast<std::uint64_t>(q * static_cast<double>(total));
+    rank = std::clamp<std::uint64_t>(rank + (rank < q * static_cast<double>(total)), 1, total);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; i++) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // the middle of the last bucket may lie past the largest value
+            return std::min(valueAt(i), max());
+        }
+    }
+    return max();
+}
+
+// tracking
+
+void setLatencyTracking(std::size_t slowFileCount) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.slowFileCount = slowFileCount;
+    registry.enabled = true;
+}
+
+bool latencyTracking() {
+    return registry.enabled.load(std::memory_order_relaxed);
+}
+
+std::uint64_t latencyStart() {
+    return latencyTracking() ? nowNanos() : 0;
+}
+
+void recordReadLatency(std::uint64_t start) {
+    if (start != 0) {
+        recorder().reads.record(nowNanos() - start);
+    }
+}
+
+void recordFileLatency(std::uint64_t start, const std::string& path, std::uint64_t size) {
+    if (start == 0) {
+        return;
+    }
+    std::uint64_t nanos = nowNanos() - start;
+    Recorder& own = recorder();
+    own.files.record(nanos);
+
+    // slowFileCount is only written before work starts
+    auto& slowest = own.slowest;
+    if (registry.slowFileCount == 0) {
+        return;
+    }
+    if (slowest.size() < registry.slowFileCount) {
+        slowest.push_back({nanos, size, path});
+        std::push_heap(slowest.begin(), slowest.end(), std::greater<SlowFile>());
+    } else if (nanos > slowest.front().nanos) {
+        std::pop_heap(slowest.begin(), slowest.end(), std::greater<SlowFile>());
+        slowest.back() = {nanos, size, path};
+        std::push_heap(slowest.begin(), slowest.end(), std::greater<SlowFile>());
+    }
+}
+
+void printLatencyReport(std::FILE* out) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    LatencyHistogram files;
+    LatencyHistogram reads;
+    std::vector<SlowFile> slowest;
+    for (const auto& own : registry.recorders) {
+        files.merge(own->files);
+        reads.merge(own->reads);
+        slowest.insert(slowest.end(), own->slowest.begin(), own->slowest.end());
+    }
+    std::sort(slowest.begin(), slowest.end(), std::greater<SlowFile>());
+    if (slowest.size() > registry.slowFileCount) {
+        slowest.resize(registry.slowFileCount);
+    }
+
+    std::fprintf(out, "latency of %llu files and %llu reads, recorded on %zu thread%s:\n",
+        static_cast<unsigned long long>(files.count()),
+        static_cast<unsigned long long>(reads.count()),
+        registry.recorders.size(), registry.recorders.size() == 1 ? "" : "s");
+    printPercentiles(out, "per file", files);
+    printPercentiles(out, "per read", reads);
+    if (slowest.empty()) {
+        return;
+    }
+    std::fprintf(out, "slowest files:\n");
+    for (const auto& file : slowest) {
+        double seconds = static_cast<double>(file.nanos) / 1e9;
+        double mibPerSecond = seconds > 0.0 ? static_cast<double>(file.size) / (1 << 20) / seconds : 0.0;
+        std::fprintf(out, "  %8s %14llu bytes %10.1f MiB/s  %s\n", formatNanos(file.nanos).c_str(),
+            static_cast<unsigned long long>(file.size), mibPerSecond, file.path.c_str());
+    }
+}
+
+}  // namespace mji::xmph
@@ -1,7 +1,14 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <optional>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <utility>
@@ -9,7 +16,27 @@
 
 #include <getopt.h>
 
+#include <xmphash/audit.hpp>
+#include <xmphash/benchmark.hpp>
+#include <xmphash/check.hpp>
+#include <xmphash/compress.hpp>
+#include <xmphash/counters.hpp>
+#include <xmphash/dirhash.hpp>
+#include <xmphash/engine.hpp>
 #include <xmphash/hasher.hpp>
+#include <xmphash/hashfile.hpp>
+#include <xmphash/journal.hpp>
+#include <xmphash/kcrypto.hpp>
+#include <xmphash/knownset.hpp>
+#include <xmphash/latency.hpp>
+#include <xmphash/manifest.hpp>
+#include <xmphash/manifestops.hpp>
+#include <xmphash/membudget.hpp>
+#include <xmphash/pathfilter.hpp>
+#include <xmphash/pressure.hpp>
+#include <xmphash/throttle.hpp>
+#include <xmphash/treediff.hpp>
+#include <xmphash/walk.hpp>
 #include <xmphash/xplat.hpp>
 
 namespace xmph = mji::xmph;
@@ -30,12 +57,49 @@ enum Arg : int {
     USE_TEXT_MODE = 't',
     USE_ZERO_TERMINATE = 'z',
     CONTINUE = 'c',
+    MANIFEST = 'm',
+    JOBS = 'j',
 
     // long only
-    HELP = 1001
+    HELP = 1001,
+    BLOCK_SIZE = 1002,
+    AUDIT = 1003,
+    AUDIT_FRACTION = 1004,
+    SEED = 1005,
+    FP_EDGE = 1006,
+    FP_SAMPLES = 1007,
+    DIFF = 1008,
+    MANIFEST_DIFF = 1009,
+    MERGE = 1010,
+    SORT = 1011,
+    SORT_MEMORY = 1012,
+    TMPDIR = 1013,
+    KNOWN = 1014,
+    BUILD_KNOWN = 1015,
+    JOURNAL = 1016,
+    RESUME = 1017,
+    RATE = 1018,
+    BURST = 1019,
+    ADAPTIVE = 1020,
+    LOW_IMPACT = 1021,
+    MEMORY_LIMIT = 1022,
+    PREFETCH = 1023,
+    CACHE_FIRST = 1024,
+    NO_EXTENT_REUSE = 1025,
+    KERNEL_CRYPTO = 1026,
+    BENCHMARK = 1027,
+    DIRHASH = 1028,
+    INCLUDE = 1029,
+    EXCLUDE = 1030,
+    MIN_SIZE = 1031,
+    MAX_SIZE = 1032,
+    COMPRESS = 1033,
+    SHARD = 1034,
+    LATENCY_REPORT = 1035,
+    COUNTERS = 1036
 };
 
-constexpr char optShortStr[] = "ibtzc";
+constexpr char optShortStr[] = "ibtzcmj:";
 
 }  // namespace karg
 
@@ -47,8 +111,93 @@ public:
     bool zeroTerminate = false;
     bool help = false;
     bool doContinue = false;
+    bool manifest = false;
+    std::uint64_t blockSize = 0;
+    bool audit = false;
+    double auditFraction = 0.01;
+    std::optional<std::uint64_t> seed;
+    xmph::FingerprintParams fingerprintParams;
+    unsigned int jobs = hardware_thread_count();
+    bool diff = false;
+    bool manifestDiff = false;
+    bool merge = false;
+    bool sort = false;
+    std::uint64_t sortMemory = 256ull << 20;
+    std::string tempDir;
+    std::string knownPath;
+    bool buildKnown = false;
+    std::string journalPath;
+    bool resume = false;
+    std::uint64_t rate = 0;
+    std::optional<std::uint64_t> burst;
+    std::optional<double> adaptiveThreshold;
+    bool lowImpact = false;
+    /// 0 for no limit
+    std::uint64_t memoryLimit = 0;
+    /// Files to prefetch ahead of the workers; defaults to twice the jobs
+    std::optional<unsigned int> prefetch;
+    bool cacheFirst = false;
+    bool reuseSharedExtents = true;
+    bool kernelCrypto = false;
+    bool benchmark = false;
+    bool dirhash = false;
+    /// --include, --exclude, --min-size and --max-size, applied to walks
+    xmph::PathFilter filter;
+    /// zstd level for manifest output, if compressed
+    std::optional<int> compressionLevel;
+    /// --shard, 0-based
+    std::uint32_t shardIndex = 0;
+    std::uint32_t shardCount = 1;
+    /// --latency-report: the number of slowest files to list
+    std::optional<std::size_t> latencyReport;
+    bool counters = false;
 };
 
+/// Parses a byte count with an optional binary suffix (K, M, G or T)
+std::optional<std::uint64_t> parseSize(const char* s) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = std::strtoull(s, &end, 10);
+    if (end == s || errno != 0) {
+        return {};
+    }
+
+    unsigned int shift = 0;
+    switch (*end) {
+    case '\0': break;
+    case 'k': case 'K': shift = 10; break;
+    case 'm': case 'M': shift = 20; break;
+    case 'g': case 'G': shift = 30; break;
+    case 't': case 'T': shift = 40; break;
+    default: return {};
+    }
+    if (*end != '\0' && end[1] != '\0') {
+        return {};
+    }
+    if (shift != 0 && value > (~0ull >> shift)) {
+        return {};
+    }
+    return static_cast<std::uint64_t>(value) << shift;
+}
+
+/// Parses a fraction given either as a number in (0, 1] or as a percentage
+std::optional<double> parseFraction(const char* s) {
+    char* end = nullptr;
+    double value = std::strtod(s, &end);
+    if (end == s) {
+        return {};
+    }
+    if (*end == '%' && end[1] == '\0') {
+        value /= 100.0;
+    } else if (*end != '\0') {
+        return {};
+    }
+    if (!(value > 0.0 && value <= 1.0)) {
+        return {};
+    }
+    return value;
+}
+
 // note: returned pos args excludes program name
 std::optional<std::pair<ProcFlags, std::vector<std::string>>>
 parseCliArgs(int argc, char** argv) {
@@ -60,8 +209,45 @@ parseCliArgs(int argc, char** argv) {
         {"text", no_argument, nullptr, karg::USE_TEXT_MODE},
         {"zero", no_argument, nullptr, karg::USE_ZERO_TERMINATE},
         {"continue", no_argument, nullptr, karg::CONTINUE},
+        {"manifest", no_argument, nullptr, karg::MANIFEST},
+        {"jobs", required_argument, nullptr, karg::JOBS},
 
         {"help", no_argument, nullptr, karg::HELP},
+        {"block-size", required_argument, nullptr, karg::BLOCK_SIZE},
+        {"audit", no_argument, nullptr, karg::AUDIT},
+        {"audit-fraction", required_argument, nullptr, karg::AUDIT_FRACTION},
+        {"seed", required_argument, nullptr, karg::SEED},
+        {"fp-edge", required_argument, nullptr, karg::FP_EDGE},
+        {"fp-samples", required_argument, nullptr, karg::FP_SAMPLES},
+        {"diff", no_argument, nullptr, karg::DIFF},
+        {"manifest-diff", no_argument, nullptr, karg::MANIFEST_DIFF},
+        {"merge", no_argument, nullptr, karg::MERGE},
+        {"sort", no_argument, nullptr, karg::SORT},
+        {"sort-memory", required_argument, nullptr, karg::SORT_MEMORY},
+        {"tmpdir", required_argument, nullptr, karg::TMPDIR},
+        {"known", required_argument, nullptr, karg::KNOWN},
+        {"build-known", no_argument, nullptr, karg::BUILD_KNOWN},
+        {"journal", required_argument, nullptr, karg::JOURNAL},
+        {"resume", no_argument, nullptr, karg::RESUME},
+        {"rate", required_argument, nullptr, karg::RATE},
+        {"burst", required_argument, nullptr, karg::BURST},
+        {"adaptive", optional_argument, nullptr, karg::ADAPTIVE},
+        {"low-impact", no_argument, nullptr, karg::LOW_IMPACT},
+        {"memory-limit", required_argument, nullptr, karg::MEMORY_LIMIT},
+        {"prefetch", required_argument, nullptr, karg::PREFETCH},
+        {"cache-first", no_argument, nullptr, karg::CACHE_FIRST},
+        {"no-extent-reuse", no_argument, nullptr, karg::NO_EXTENT_REUSE},
+        {"kernel-crypto", no_argument, nullptr, karg::KERNEL_CRYPTO},
+        {"benchmark", no_argument, nullptr, karg::BENCHMARK},
+        {"dirhash", no_argument, nullptr, karg::DIRHASH},
+        {"include", required_argument, nullptr, karg::INCLUDE},
+        {"exclude", required_argument, nullptr, karg::EXCLUDE},
+        {"min-size", required_argument, nullptr, karg::MIN_SIZE},
+        {"max-size", required_argument, nullptr, karg::MAX_SIZE},
+        {"compress", optional_argument, nullptr, karg::COMPRESS},
+        {"shard", required_argument, nullptr, karg::SHARD},
+        {"latency-report", optional_argument, nullptr, karg::LATENCY_REPORT},
+        {"counters", no_argument, nullptr, karg::COUNTERS},
         {nullptr, 0, nullptr, 0}
     };
     int optionIdx = 0;
@@ -69,6 +255,8 @@ parseCliArgs(int argc, char** argv) {
     // missing required arguments
     ::opterr = 1;
 
+    std::uint64_t minSize = 0;
+    std::uint64_t maxSize = std::numeric_limits<std::uint64_t>::max();
     for (;;) {
         // Arguments to short and long options will be stored in ::optarg
         // (char*)
@@ -121,9 +309,245 @@ parseCliArgs(int argc, char** argv) {
         case karg::CONTINUE:
             procFlags.doContinue = true;
             break;
+        case karg::MANIFEST:
+            procFlags.manifest = true;
+            break;
+        case karg::JOBS: {
+            char* end = nullptr;
+            unsigned long jobs = std::strtoul(::optarg, &end, 10);
+            if (end == ::optarg || *end != '\0' || jobs == 0 || jobs > 4096) {
+                std::fprintf(stderr, "Invalid job count \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.jobs = static_cast<unsigned int>(jobs);
+            break;
+        }
         case karg::HELP:
             procFlags.help = true;
             break;
+        case karg::BLOCK_SIZE: {
+            auto size = parseSize(::optarg);
+            if (!size || *size == 0) {
+                std::fprintf(stderr, "Invalid block size \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.blockSize = *size;
+            break;
+        }
+        case karg::AUDIT:
+            procFlags.audit = true;
+            break;
+        case karg::AUDIT_FRACTION: {
+            auto fraction = parseFraction(::optarg);
+            if (!fraction) {
+                std::fprintf(stderr, "Invalid audit fraction \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.auditFraction = *fraction;
+            break;
+        }
+        case karg::SEED: {
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long seed = std::strtoull(::optarg, &end, 0);
+            if (end == ::optarg || *end != '\0' || errno != 0) {
+                std::fprintf(stderr, "Invalid seed \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.seed = seed;
+            break;
+        }
+        case karg::FP_EDGE: {
+            auto size = parseSize(::optarg);
+            if (!size) {
+                std::fprintf(stderr, "Invalid fingerprint edge size \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.fingerprintParams.edgeSize = *size;
+            break;
+        }
+        case karg::FP_SAMPLES: {
+            char* end = nullptr;
+            unsigned long samples = std::strtoul(::optarg, &end, 10);
+            if (end == ::optarg || *end != '\0' || samples > 1u << 20) {
+                std::fprintf(stderr, "Invalid fingerprint sample count \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.fingerprintParams.samples = samples;
+            break;
+        }
+        case karg::DIFF:
+            procFlags.diff = true;
+            break;
+        case karg::MANIFEST_DIFF:
+            procFlags.manifestDiff = true;
+            break;
+        case karg::MERGE:
+            procFlags.merge = true;
+            break;
+        case karg::SORT:
+            procFlags.sort = true;
+            break;
+        case karg::SORT_MEMORY: {
+            auto size = parseSize(::optarg);
+            if (!size || *size == 0) {
+                std::fprintf(stderr, "Invalid sort memory size \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.sortMemory = *size;
+            break;
+        }
+        case karg::TMPDIR:
+            procFlags.tempDir = ::optarg;
+            break;
+        case karg::KNOWN:
+            procFlags.knownPath = ::optarg;
+            break;
+        case karg::BUILD_KNOWN:
+            procFlags.buildKnown = true;
+            break;
+        case karg::JOURNAL:
+            procFlags.journalPath = ::optarg;
+            break;
+        case karg::RESUME:
+            procFlags.resume = true;
+            break;
+        case karg::RATE: {
+            auto rate = parseSize(::optarg);
+            if (!rate) {
+                std::fprintf(stderr, "Invalid read rate \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.rate = *rate;
+            break;
+        }
+        case karg::BURST: {
+            auto burst = parseSize(::optarg);
+            if (!burst || *burst == 0) {
+                std::fprintf(stderr, "Invalid burst size \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.burst = *burst;
+            break;
+        }
+        case karg::ADAPTIVE: {
+            // the default threshold is 10% of time stalled
+            auto threshold = (::optarg == nullptr) ? std::optional<double>(0.10) : parseFraction(::optarg);
+            if (!threshold) {
+                std::fprintf(stderr, "Invalid pressure threshold \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.adaptiveThreshold = *threshold;
+            break;
+        }
+        case karg::LOW_IMPACT:
+            procFlags.lowImpact = true;
+            break;
+        case karg::MEMORY_LIMIT: {
+            auto size = parseSize(::optarg);
+            if (!size || *size == 0) {
+                std::fprintf(stderr, "Invalid memory limit \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.memoryLimit = *size;
+            break;
+        }
+        case karg::PREFETCH: {
+            char* end = nullptr;
+            unsigned long depth = std::strtoul(::optarg, &end, 10);
+            if (end == ::optarg || *end != '\0' || depth > 4096) {
+                std::fprintf(stderr, "Invalid prefetch depth \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.prefetch = static_cast<unsigned int>(depth);
+            break;
+        }
+        case karg::CACHE_FIRST:
+            procFlags.cacheFirst = true;
+            break;
+        case karg::NO_EXTENT_REUSE:
+            procFlags.reuseSharedExtents = false;
+            break;
+        case karg::KERNEL_CRYPTO:
+            procFlags.kernelCrypto = true;
+            break;
+        case karg::BENCHMARK:
+            procFlags.benchmark = true;
+            break;
+        case karg::DIRHASH:
+            procFlags.dirhash = true;
+            break;
+        case karg::INCLUDE:
+            if (!procFlags.filter.addInclude(::optarg)) {
+                return {};
+            }
+            break;
+        case karg::EXCLUDE:
+            if (!procFlags.filter.addExclude(::optarg)) {
+                return {};
+            }
+            break;
+        case karg::MIN_SIZE:
+        case karg::MAX_SIZE: {
+            auto size = parseSize(::optarg);
+            if (!size) {
+                std::fprintf(stderr, "Invalid file size \"%s\"\n", ::optarg);
+                return {};
+            }
+            (c == karg::MIN_SIZE ? minSize : maxSize) = *size;
+            break;
+        }
+        case karg::COMPRESS: {
+            if (::optarg == nullptr) {
+                procFlags.compressionLevel = xmph::default_compression_level;
+                break;
+            }
+            char* end = nullptr;
+            long level = std::strtol(::optarg, &end, 10);
+            if (end == ::optarg || *end != '\0' || level < 1 || level > 19) {
+                std::fprintf(stderr, "Invalid compression level \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.compressionLevel = static_cast<int>(level);
+            break;
+        }
+        case karg::SHARD: {
+            // I/N, with I counted from 1
+            char* end = nullptr;
+            unsigned long index = std::strtoul(::optarg, &end, 10);
+            unsigned long count = 0;
+            if (end != ::optarg && *end == '/') {
+                const char* countStr = end + 1;
+                count = std::strtoul(countStr, &end, 10);
+                if (end == countStr) {
+                    count = 0;
+                }
+            }
+            if (*end != '\0' || count == 0 || count > 65536 || index == 0 || index > count) {
+                std::fprintf(stderr, "Invalid shard \"%s\" (expected I/N, 1 <= I <= N)\n", ::optarg);
+                return {};
+            }
+            procFlags.shardIndex = static_cast<std::uint32_t>(index - 1);
+            procFlags.shardCount = static_cast<std::uint32_t>(count);
+            break;
+        }
+        case karg::LATENCY_REPORT: {
+            if (::optarg == nullptr) {
+                procFlags.latencyReport = xmph::default_slow_file_count;
+                break;
+            }
+            char* end = nullptr;
+            unsigned long count = std::strtoul(::optarg, &end, 10);
+            if (end == ::optarg || *end != '\0' || count > 100000) {
+                std::fprintf(stderr, "Invalid slow file count \"%s\"\n", ::optarg);
+                return {};
+            }
+            procFlags.latencyReport = static_cast<std::size_t>(count);
+            break;
+        }
+        case karg::COUNTERS:
+            procFlags.counters = true;
+            break;
         case 0:
             // a long option requested that a value be stored instead of
             // returned. We don't specify any such options
@@ -135,6 +559,10 @@ parseCliArgs(int argc, char** argv) {
         }
     }
 
+    procFlags.filter.setSizeRange(minSize, maxSize);
+    procFlags.filter.setShard(procFlags.shardIndex, procFlags.shardCount);
+    procFlags.filter.compile();
+
     return std::optional<std::pair<ProcFlags, std::vector<std::string>>>(
         std::in_place,
         std::move(procFlags),
@@ -143,50 +571,589 @@ parseCliArgs(int argc, char** argv) {
 }
 
 void printHelp() {
-    std::printf("[insert help]\n");
+    std::printf(
+        "usage: xmphash [options] ALGO[,ALGO...] FILE...\n"
+        "       xmphash -i [options] MANIFEST [PATH...]\n"
+        "       xmphash --audit [options] MANIFEST\n"
+        "       xmphash --diff [options] OLD_DIR NEW_DIR\n"
+        "       xmphash --manifest-diff [options] OLD_MANIFEST NEW_MANIFEST\n"
+        "       xmphash --merge [options] MANIFEST...\n"
+        "       xmphash --sort [options] MANIFEST\n"
+        "       xmphash --build-known ALGO DIGEST_LIST INDEX\n"
+        "       xmphash --benchmark ALGO[,ALGO...] FILE...\n"
+        "       xmphash --dirhash [options] ALGO DIR\n"
+        "\n"
+        "Hashes each FILE (\"-\" for standard input) with every listed algorithm.\n"
+        "Directories are walked recursively and their files hashed in parallel.\n"
+        "An ALGO of the form fp-ALGO is a quick fingerprint which reads only the\n"
+        "head, tail and a few interior samples of a file. The ALGO fsverity is\n"
+        "the fs-verity file digest (SHA-256, 4K blocks), taken from the kernel\n"
+        "when the file has fs-verity enabled. The ALGOs git-sha1 and git-sha256\n"
+        "are git blob IDs (as from git hash-object), and with --dirhash give git\n"
+        "tree IDs.\n"
+        "\n"
+        "  -i, --check-integrity   verify the files of MANIFEST (in manifest order,\n"
+        "                          or as found by walking each PATH)\n"
+        "  -b, --binary            read files in binary mode (default)\n"
+        "  -t, --text              read files in text mode\n"
+        "  -z, --zero              end manifest records with NUL, not newline\n"
+        "  -c, --continue          keep going after a file fails\n"
+        "  -m, --manifest          print manifest records (implied by several\n"
+        "                          FILEs, a directory or --block-size)\n"
+        "  -j, --jobs=N            number of worker threads (default: one per\n"
+        "                          hardware thread)\n"
+        "      --block-size=SIZE   also record digests of each SIZE-byte block\n"
+        "      --audit             verify a random sample of the blocks in MANIFEST\n"
+        "      --audit-fraction=F  fraction of blocks to audit (default 1%%)\n"
+        "      --seed=N            seed for the audit sample (default: random,\n"
+        "                          printed so the run can be repeated)\n"
+        "      --fp-edge=SIZE      head and tail size for fp-ALGO (default 64K)\n"
+        "      --fp-samples=K      interior samples for fp-ALGO (default 16)\n"
+        "      --diff              list files added, removed or changed between\n"
+        "                          two trees, reading each pair only until the\n"
+        "                          first difference\n"
+        "      --dirhash           print a digest of DIR covering the names, modes,\n"
+        "                          link targets and contents beneath it, and one\n"
+        "                          for each subdirectory, as manifest records\n"
+        "                          (which -i verifies)\n"
+        "      --manifest-diff     list paths added, removed or changed between\n"
+        "                          two manifests\n"
+        "      --merge             merge manifests (e.g. of shards) into one sorted\n"
+        "                          manifest on standard output\n"
+        "      --sort              sort a manifest by path onto standard output\n"
+        "      --sort-memory=SIZE  memory for sorting unsorted manifests before\n"
+        "                          spilling to temporary files (default 256M)\n"
+        "      --tmpdir=DIR        directory for temporary sort files\n"
+        "      --known=INDEX       flag each file whose digest is in the known set\n"
+        "                          INDEX (\"known=1\" or \"known=0\")\n"
+        "      --build-known       index a list of hex digests (one per line, as\n"
+        "                          in an NSRL hash file) for use with --known\n"
+        "      --journal=FILE      record progress in FILE so that an interrupted\n"
+        "                          run can be resumed (implies -m)\n"
+        "      --resume            skip the files completed according to the\n"
+        "                          --journal, and continue partly hashed files\n"
+        "                          where the algorithms allow it (crc32)\n"
+        "      --rate=SIZE         read at most SIZE bytes per second in total\n"
+        "                          across all workers (e.g. 50M)\n"
+        "      --burst=SIZE        bytes that may be read at once before --rate\n"
+        "                          applies (default: a tenth of a second's worth)\n"
+        "      --adaptive[=F]      back off (fewer workers, smaller reads) while\n"
+        "                          more than F of the time some task is stalled\n"
+        "                          on I/O or CPU, per Linux PSI (default 10%%)\n"
+        "      --low-impact        run at idle CPU and I/O priority, leave access\n"
+        "                          times alone and drop hashed data from the page\n"
+        "                          cache\n"
+        "      --memory-limit=SIZE bound the memory used for read buffers and\n"
+        "                          results waiting to be written; workers wait\n"
+        "                          (or are not started) rather than exceed it.\n"
+        "                          Also caps --sort-memory\n"
+        "      --prefetch=N        start reading the next N files into the page\n"
+        "                          cache while earlier ones hash (default: twice\n"
+        "                          the number of jobs; 0 disables)\n"
+        "      --cache-first       hash the files already in the page cache on\n"
+        "                          half of the workers while the others read the\n"
+        "                          rest from disk (needs -j2 or more)\n"
+        "      --no-extent-reuse   hash reflink copies too, rather than reusing\n"
+        "                          the digests of the file whose extents they\n"
+        "                          share (-i always hashes them)\n"
+        "      --kernel-crypto     hash through the kernel crypto API (AF_ALG),\n"
+        "                          splicing file pages straight to the kernel,\n"
+        "                          where every algorithm is offered there\n"
+        "      --benchmark         time OpenSSL against --kernel-crypto on each\n"
+        "                          FILE (from the page cache) and print MiB/s\n"
+        "      --include=GLOB      only take the files (and everything in the\n"
+        "                          directories) matching GLOB when walking a\n"
+        "                          directory; may be repeated. A GLOB without\n"
+        "                          '/' matches names at any depth (e.g. '*.c'),\n"
+        "                          one with '/' the path from the top of the walk,\n"
+        "                          where '*' also matches '/' (e.g. '/src/*')\n"
+        "      --exclude=GLOB      skip what matches GLOB when walking a directory,\n"
+        "                          without reading excluded directories (e.g.\n"
+        "                          'node_modules', '*.tmp'); may be repeated and\n"
+        "                          wins over --include\n"
+        "      --min-size=SIZE     skip smaller files when walking a directory\n"
+        "      --max-size=SIZE     skip larger files when walking a directory\n"
+        "      --compress[=LEVEL]  write the manifest zstd-compressed, at LEVEL 1\n"
+        "                          to 19 (default 3); compressed manifests are\n"
+        "                          read wherever a manifest is\n"
+        "      --shard=I/N         hash only the I-th of N shards (1 <= I <= N):\n"
+        "                          each entry directly below a walked directory,\n"
+        "                          and each FILE given, belongs to one shard by a\n"
+        "                          stable hash of its name, so separate hosts\n"
+        "                          can split a scan and --merge their manifests\n"
+        "      --latency-report[=N]\n"
+        "                          at exit, print p50/p99/p99.9 latencies of each\n"
+        "                          file (open to finalize) and of each read, and\n"
+        "                          the N slowest files (default 10)\n"
+        "      --counters          count cycles, instructions, cache misses and\n"
+        "                          branch misses in each algorithm's hashing code\n"
+        "                          (perf_event_open) and print them per byte at exit\n"
+        "      --help              print this message\n"
+    );
 }
 
-class CFileWrapper final {
-public:
-    std::FILE* fp;
+xmph::PrefetchOptions prefetchOptions(const ProcFlags& procFlags) {
+    xmph::PrefetchOptions options;
+    options.depth = procFlags.prefetch.value_or(2 * procFlags.jobs);
+    if (procFlags.memoryLimit != 0) {
+        // cached pages are charged to the cgroup as well
+        options.byteBudget = std::min(options.byteBudget, procFlags.memoryLimit / 4);
+    }
+    return options;
+}
 
-    CFileWrapper(std::FILE* fp)
-    : fp(fp)
-    {}
+/// Describes everything that affects the records of a hash run, so that a
+/// journal is only resumed by an equivalent run
+std::string journalRunKey(const ProcFlags& procFlags, const xmph::HashEngineOptions& options) {
+    std::string key = "algos=";
+    for (std::size_t i = 0; i < options.algoNames.size(); i++) {
+        key += (i == 0 ? "" : ",") + options.algoNames[i];
+    }
+    key += " block-size=" + std::to_string(options.blockSize);
+    key += " fp-edge=" + std::to_string(options.fingerprintParams.edgeSize);
+    key += " fp-samples=" + std::to_string(options.fingerprintParams.samples);
+    key += options.binaryMode ? " binary" : " text";
+    key += " known=" + procFlags.knownPath;
+    if (procFlags.shardCount > 1) {
+        key += " shard=" + std::to_string(procFlags.shardIndex + 1) + "/"
+            + std::to_string(procFlags.shardCount);
+    }
+    return key;
+}
 
-    CFileWrapper(const CFileWrapper&) = delete;
-    CFileWrapper& operator=(const CFileWrapper&) = delete;
+int runHash(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    xmph::HashEngineOptions options;
+    options.algoNames = xmph::splitOnChar(posArgs[0].data(), ',');
+    options.blockSize = procFlags.blockSize;
+    options.fingerprintParams = procFlags.fingerprintParams;
+    options.binaryMode = procFlags.binaryMode;
+    options.jobs = procFlags.jobs;
+    options.prefetch = prefetchOptions(procFlags);
+    options.cacheFirst = procFlags.cacheFirst;
+    options.reuseSharedExtents = procFlags.reuseSharedExtents;
+    assert(options.algoNames.size() > 0);
+    std::optional<xmph::MemoryBudget> memoryBudget;
+    if (procFlags.memoryLimit != 0) {
+        options.memoryBudget = &memoryBudget.emplace(procFlags.memoryLimit);
+    }
 
-    CFileWrapper(CFileWrapper&& other)
-    : fp(other.fp)
-    {
-        other.fp = nullptr;
+    // the known set is matched against the digest of its own algorithm
+    xmph::KnownSet knownSet;
+    std::size_t knownIdx = options.algoNames.size();
+    if (!procFlags.knownPath.empty()) {
+        if (!knownSet.open(procFlags.knownPath.c_str())) {
+            return -1;
+        }
+        auto it = std::find(options.algoNames.begin(), options.algoNames.end(), knownSet.algoName());
+        if (it == options.algoNames.end()) {
+            std::fprintf(stderr, "%s: known set is of %s digests, which are not being computed\n",
+                procFlags.knownPath.c_str(), knownSet.algoName().c_str());
+            return -1;
+        }
+        knownIdx = static_cast<std::size_t>(it - options.algoNames.begin());
     }
 
-    CFileWrapper& operator=(CFileWrapper&& other)
-    {
-        fp = other.fp;
-        other.fp = nullptr;
-        return *this;
+    // expand directories into the files beneath them
+    std::vector<std::string> inFileNames;
+    bool anyDirectory = false;
+    bool anyFailed = false;
+    for (auto it = posArgs.begin() + 1; it != posArgs.end(); ++it) {
+        if (*it == "-") {
+            if (procFlags.filter.inShard(*it)) {
+                inFileNames.push_back(*it);
+            }
+            continue;
+        }
+        std::vector<xmph::WalkEntry> walked;
+        if (!xmph::walkTree(*it, walked, &procFlags.filter)) {
+            anyFailed = true;
+            if (!procFlags.doContinue) {
+                return -1;
+            }
+            continue;
+        }
+        for (const auto& walkEntry : walked) {
+            anyDirectory = anyDirectory || !walkEntry.path.empty();
+            // a file given directly is a top-level entry of its own
+            if (walkEntry.path.empty() && !procFlags.filter.inShard(*it)) {
+                continue;
+            }
+            inFileNames.push_back(xmph::joinWalkPath(*it, walkEntry.path));
+        }
     }
 
-    int close() {
-        if (fp != nullptr) {
-            int ret = std::fclose(fp);
-            fp = nullptr;
-            return ret;
-        } else {
-            return EOF;
+    bool asManifest = procFlags.manifest || procFlags.blockSize != 0
+        || posArgs.size() > 2 || anyDirectory || !procFlags.journalPath.empty()
+        || procFlags.compressionLevel || procFlags.shardCount > 1;
+    xmph::ManifestWriter writer(stdout, procFlags.zeroTerminate ? '\0' : '\n',
+        procFlags.compressionLevel);
+
+    // files completed by an earlier run are not hashed again, but their
+    // journaled records are still written out in order
+    xmph::Journal journal;
+    // set by a failed journal write (from any thread), which stops the run
+    // rather than let it go on without progress that --resume can use
+    std::atomic<bool> journalFailed{false};
+    std::vector<std::string> pendingNames;
+    std::vector<std::size_t> pendingIdx;
+    if (!procFlags.journalPath.empty()) {
+        if (!journal.open(procFlags.journalPath.c_str(), journalRunKey(procFlags, options),
+            procFlags.resume))
+        {
+            return -1;
+        }
+        options.checkpointInterval = xmph::journal_checkpoint_interval;
+        options.saveCheckpoint = [&](std::size_t idx, const xmph::StreamCheckpoint& checkpoint) {
+            if (!journal.recordCheckpoint(pendingNames[idx], checkpoint)) {
+                journalFailed.store(true);
+            }
+        };
+        options.resumePoint = [&](std::size_t idx) {
+            return journal.checkpoint(pendingNames[idx]);
+        };
+    }
+    for (std::size_t i = 0; i < inFileNames.size(); i++) {
+        if (journal.completedRecord(inFileNames[i]) == nullptr || inFileNames[i] == "-") {
+            pendingNames.push_back(inFileNames[i]);
+            pendingIdx.push_back(i);
         }
     }
 
-    ~CFileWrapper() {
-        close();
+    std::size_t replayed = 0;
+    auto replayCompleted = [&](std::size_t upTo) {
+        for (; replayed < upTo; replayed++) {
+            const std::string* record = journal.completedRecord(inFileNames[replayed]);
+            if (record == nullptr) {
+                continue;
+            }
+            auto entry = xmph::parseManifestRecord(*record);
+            if (!entry || !writer.write(*entry)) {
+                std::fprintf(stderr, "%s: unable to write manifest record\n",
+                    inFileNames[replayed].c_str());
+                anyFailed = true;
+            }
+        }
+    };
+
+    // the file list is held for the whole run, so it comes out of the budget
+    // before any worker starts
+    std::uint64_t listBytes = 0;
+    if (memoryBudget) {
+        for (const std::string& name : inFileNames) {
+            listBytes += 2 * sizeof(std::string) + 2 * name.size();
+        }
+        if (!memoryBudget->tryAcquire(listBytes)) {
+            std::fprintf(stderr, "The list of %llu files takes about %llu bytes, more than the %llu byte memory limit\n",
+                static_cast<unsigned long long>(inFileNames.size()),
+                static_cast<unsigned long long>(listBytes),
+                static_cast<unsigned long long>(procFlags.memoryLimit));
+            return -1;
+        }
+        if (listBytes > procFlags.memoryLimit / 2) {
+            std::fprintf(stderr, "Warning: the list of %llu files takes about %llu bytes of the %llu byte memory limit\n",
+                static_cast<unsigned long long>(inFileNames.size()),
+                static_cast<unsigned long long>(listBytes),
+                static_cast<unsigned long long>(procFlags.memoryLimit));
+        }
     }
-};
+
+    // TODO: should duplicate hash names be an error?
+    std::optional<xmph::HashEngine> engine;
+    try {
+        engine.emplace(options);
+    } catch (const std::invalid_argument& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return -1;
+    }
+
+    bool completed = engine->run(pendingNames, [&](std::size_t idx, xmph::HashResult& result) {
+        const std::string& inFileName = pendingNames[idx];
+        replayCompleted(pendingIdx[idx]);
+        replayed = pendingIdx[idx] + 1;
+        bool ok = result.ok;
+        const char* known = nullptr;
+        if (ok && knownIdx < options.algoNames.size()) {
+            known = knownSet.containsHex(result.digests.digests[knownIdx]) ? "1" : "0";
+        }
+        if (ok && asManifest) {
+            xmph::ManifestEntry entry = xmph::toManifestEntry(options.algoNames, options.blockSize,
+                result.digests, inFileName);
+            if (known != nullptr) {
+                entry.fields.emplace_back("known", known);
+            }
+            if (!writer.write(entry)) {
+                std::fprintf(stderr, "%s: unable to write manifest record\n", inFileName.c_str());
+                ok = false;
+            } else if (!procFlags.journalPath.empty() && inFileName != "-"
+                && !journal.recordCompleted(xmph::formatManifestEntry(entry)))
+            {
+                journalFailed.store(true);
+            }
+        } else if (ok) {
+            for (std::size_t i = 0; i < options.algoNames.size(); i++) {
+                std::printf("%s: %s\n",
+                    options.algoNames[i].c_str(), result.digests.digests[i].c_str());
+            }
+            if (known != nullptr) {
+                std::printf("known: %s\n", known);
+            }
+        }
+
+        if (journalFailed.load()) {
+            std::fprintf(stderr, "Stopping, since progress can no longer be journaled\n");
+            anyFailed = true;
+            return false;
+        }
+        if (!ok) {
+            anyFailed = true;
+            return procFlags.doContinue;
+        }
+        return true;
+    });
+
+    if (completed) {
+        replayCompleted(inFileNames.size());
+    }
+    if (!writer.finish()) {
+        std::fprintf(stderr, "Unable to write manifest\n");
+        anyFailed = true;
+    }
+    if (!procFlags.journalPath.empty() && !journal.commit()) {
+        anyFailed = true;
+    }
+
+    return (completed && !anyFailed) ? 0 : -1;
+}
+
+int runDiff(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    xmph::TreeDiffOptions options;
+    options.jobs = procFlags.jobs;
+    options.filter = &procFlags.filter;
+    std::optional<xmph::MemoryBudget> memoryBudget;
+    if (procFlags.memoryLimit != 0) {
+        options.memoryBudget = &memoryBudget.emplace(procFlags.memoryLimit);
+    }
+
+    xmph::TreeDiffReport report;
+    if (!xmph::runTreeDiff(posArgs[0], posArgs[1], options, report)) {
+        return -1;
+    }
+    std::fprintf(stderr, "%llu added, %llu removed, %llu changed, %llu identical (%llu bytes read)\n",
+        static_cast<unsigned long long>(report.added),
+        static_cast<unsigned long long>(report.removed),
+        static_cast<unsigned long long>(report.changed),
+        static_cast<unsigned long long>(report.identical),
+        static_cast<unsigned long long>(report.bytesRead));
+    if (report.errors != 0) {
+        return -1;
+    }
+    return (report.added == 0 && report.removed == 0 && report.changed == 0) ? 0 : 1;
+}
+
+xmph::ManifestOpsOptions manifestOpsOptions(const ProcFlags& procFlags) {
+    xmph::ManifestOpsOptions options;
+    options.terminator = procFlags.zeroTerminate ? '\0' : '\n';
+    options.sortMemory = procFlags.sortMemory;
+    if (procFlags.memoryLimit != 0) {
+        options.sortMemory = std::min(options.sortMemory, procFlags.memoryLimit);
+    }
+    options.tempDir = procFlags.tempDir;
+    return options;
+}
+
+int runDirHash(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    xmph::DirHashOptions options;
+    options.algoName = posArgs[0];
+    options.engine.jobs = procFlags.jobs;
+    options.engine.prefetch = prefetchOptions(procFlags);
+    options.engine.cacheFirst = procFlags.cacheFirst;
+    options.engine.reuseSharedExtents = procFlags.reuseSharedExtents;
+    options.filter = &procFlags.filter;
+    std::optional<xmph::MemoryBudget> memoryBudget;
+    if (procFlags.memoryLimit != 0) {
+        options.engine.memoryBudget = &memoryBudget.emplace(procFlags.memoryLimit);
+    }
+
+    std::vector<xmph::DirDigest> digests;
+    if (!xmph::computeDirHash(posArgs[1], options, digests)) {
+        return -1;
+    }
+    xmph::ManifestWriter writer(stdout, procFlags.zeroTerminate ? '\0' : '\n',
+        procFlags.compressionLevel);
+    for (const auto& digest : digests) {
+        xmph::ManifestEntry entry;
+        entry.fields.emplace_back("files", std::to_string(digest.files));
+        entry.fields.emplace_back("size", std::to_string(digest.bytes));
+        entry.fields.emplace_back(std::string(xmph::dirhash_field_prefix) + options.algoName,
+            digest.digest);
+        entry.path = digest.path.empty() ? "." : digest.path;
+        if (!writer.write(entry)) {
+            std::fprintf(stderr, "%s: unable to write manifest record\n", entry.path.c_str());
+            return -1;
+        }
+    }
+    if (!writer.finish()) {
+        std::fprintf(stderr, "Unable to write manifest\n");
+        return -1;
+    }
+    return 0;
+}
+
+int runManifestDiff(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    xmph::ManifestDiffReport report;
+    if (!xmph::diffManifests(posArgs[0].c_str(), posArgs[1].c_str(),
+        manifestOpsOptions(procFlags), report))
+    {
+        return -1;
+    }
+    std::fprintf(stderr, "%llu added, %llu removed, %llu changed, %llu unchanged\n",
+        static_cast<unsigned long long>(report.added),
+        static_cast<unsigned long long>(report.removed),
+        static_cast<unsigned long long>(report.changed),
+        static_cast<unsigned long long>(report.unchanged));
+    return (report.added == 0 && report.removed == 0 && report.changed == 0) ? 0 : 1;
+}
+
+int runMerge(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    bool ok = xmph::mergeManifests(posArgs, stdout, manifestOpsOptions(procFlags));
+    return (ok && std::fflush(stdout) == 0) ? 0 : -1;
+}
+
+int runSort(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    bool ok = xmph::sortManifest(posArgs[0].c_str(), stdout, manifestOpsOptions(procFlags));
+    return (ok && std::fflush(stdout) == 0) ? 0 : -1;
+}
+
+int runCheck(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    xmph::CheckOptions options;
+    options.terminator = procFlags.zeroTerminate ? '\0' : '\n';
+    options.binaryMode = procFlags.binaryMode;
+    options.jobs = procFlags.jobs;
+    options.fingerprintParams = procFlags.fingerprintParams;
+    options.prefetch = prefetchOptions(procFlags);
+    options.cacheFirst = procFlags.cacheFirst;
+    options.filter = &procFlags.filter;
+    std::optional<xmph::MemoryBudget> memoryBudget;
+    if (procFlags.memoryLimit != 0) {
+        options.memoryBudget = &memoryBudget.emplace(procFlags.memoryLimit);
+    }
+
+    xmph::CheckReport report;
+    std::vector<std::string> roots(posArgs.begin() + 1, posArgs.end());
+    if (!xmph::runCheck(posArgs[0].c_str(), roots, options, report)) {
+        return -1;
+    }
+    std::fprintf(stderr, "%llu OK, %llu FAILED, %llu missing, %llu not listed, %llu unreadable\n",
+        static_cast<unsigned long long>(report.ok),
+        static_cast<unsigned long long>(report.failed),
+        static_cast<unsigned long long>(report.missing),
+        static_cast<unsigned long long>(report.unlisted),
+        static_cast<unsigned long long>(report.errors));
+    if (report.errors != 0) {
+        return -1;
+    }
+    return (report.failed == 0 && report.missing == 0 && report.unlisted == 0) ? 0 : 1;
+}
+
+int runAudit(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    xmph::AuditOptions options;
+    options.fraction = procFlags.auditFraction;
+    options.terminator = procFlags.zeroTerminate ? '\0' : '\n';
+    if (procFlags.seed) {
+        options.seed = *procFlags.seed;
+    } else {
+        options.seed = xmph::mix64(static_cast<std::uint64_t>(
+            std::chrono::system_clock::now().time_since_epoch().count()));
+    }
+
+    xmph::AuditReport report;
+    if (!xmph::runAudit(posArgs[0].c_str(), options, report)) {
+        return -1;
+    }
+    xmph::printAuditReport(report, options);
+    return (report.failedBlocks == 0 && report.failedFiles == 0) ? 0 : 1;
+}
+
+int runBenchmark(const std::vector<std::string>& posArgs) {
+    std::vector<std::string> algoNames = xmph::splitOnChar(posArgs[0].data(), ',');
+    std::vector<xmph::BenchmarkResult> results;
+    if (!xmph::runBenchmark(algoNames,
+        std::vector<std::string>(posArgs.begin() + 1, posArgs.end()), {}, results))
+    {
+        return -1;
+    }
+    xmph::printBenchmarkReport(results);
+    return std::all_of(results.begin(), results.end(),
+        [](const auto& result) { return result.digestsMatch; }) ? 0 : 1;
+}
+
+/// Runs the mode selected by the flags
+int runMode(const ProcFlags& procFlags, const std::vector<std::string>& posArgs) {
+    if (procFlags.audit) {
+        if (posArgs.size() != 1) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected 1\n");
+            return -1;
+        }
+        return runAudit(procFlags, posArgs);
+    } else if (procFlags.benchmark) {
+        if (posArgs.size() < 2) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected at least 2\n");
+            return -1;
+        }
+        return runBenchmark(posArgs);
+    } else if (procFlags.dirhash) {
+        if (posArgs.size() != 2) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected 2\n");
+            return -1;
+        }
+        return runDirHash(procFlags, posArgs);
+    } else if (procFlags.diff) {
+        if (posArgs.size() != 2) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected 2\n");
+            return -1;
+        }
+        return runDiff(procFlags, posArgs);
+    } else if (procFlags.manifestDiff) {
+        if (posArgs.size() != 2) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected 2\n");
+            return -1;
+        }
+        return runManifestDiff(procFlags, posArgs);
+    } else if (procFlags.merge) {
+        if (posArgs.empty()) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected at least 1\n");
+            return -1;
+        }
+        return runMerge(procFlags, posArgs);
+    } else if (procFlags.sort) {
+        if (posArgs.size() != 1) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected 1\n");
+            return -1;
+        }
+        return runSort(procFlags, posArgs);
+    } else if (procFlags.buildKnown) {
+        if (posArgs.size() != 3) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected 3\n");
+            return -1;
+        }
+        return xmph::buildKnownSet(posArgs[1].c_str(), posArgs[0], posArgs[2].c_str()) ? 0 : -1;
+    } else if (procFlags.checkIntegrity) {
+        if (posArgs.empty()) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected at least 1\n");
+            return -1;
+        }
+        return runCheck(procFlags, posArgs);
+    } else {
+        if (posArgs.size() < 2) {
+            std::fprintf(stderr, "Wrong number of positional arguments - expected at least 2\n");
+            return -1;
+        }
+        return runHash(procFlags, posArgs);
+    }
+}
 
 int main(int argc, char** argv) {
-    std::printf("Detected %u hardware threads\n", hardware_thread_count());
+    std::fprintf(stderr, "Detected %u hardware threads\n", hardware_thread_count());
 
     std::optional<std::pair<ProcFlags, std::vector<std::string>>> cliArgs =
         parseCliArgs(argc, argv);
@@ -202,102 +1169,67 @@ int main(int argc, char** argv) {
     if (procFlags.help) {
         printHelp();
         return 0;
-    } else if (posArgs.size() != 2) {
-        std::fprintf(stderr, "Wrong number of positional arguments - expected 2\n");
-        return -1;
     }
 
-    std::vector<std::string> algoEls = xmph::splitOnChar(posArgs[0].data(), ',');
-    assert(algoEls.size() > 0);
+    if (procFlags.rate != 0) {
+        constexpr std::uint64_t minBurst = 64 << 10;
+        xmph::setReadRateLimit(procFlags.rate,
+            procFlags.burst.value_or(std::max(procFlags.rate / 10, minBurst)));
+    }
 
-    if (procFlags.checkIntegrity) {
-        assert("not implemented");
-    } else {
-        // compute hashes of multiple files
-
-        // for algo in algoEls, construct a hasher
-        std::vector<std::unique_ptr<xmph::Hasher>> hashers;
-        // TODO: should duplicate hash names be an error?
-        for (const auto& algoName : algoEls) {
-            if (algoName == "crc32") {
-                hashers.push_back(std::make_unique<xmph::Crc32Hasher>());
-            } else {
-                // TODO: could throw!
-                hashers.push_back(std::make_unique<xmph::EvpHasher>(algoName.c_str()));
-            }
-        }
-
-        // open file
-        const std::string& inFileName = posArgs[1];
-        std::FILE* inFilePtr = nullptr;
-        errno = 0;
-        if (inFileName == "-") {
-            // stdin
-            if (procFlags.binaryMode && !mji::xplat::reopenStdinAsBinary()) {
-                std::fprintf(stderr, "Failed to reopen stdin as binary");
-                return -1;
-            }
-            inFilePtr = stdin;
-        } else {
-            const char* openMode;
-            if (procFlags.binaryMode) {
-                openMode = "rb";
-            } else {
-                openMode = "r";
-            }
-            inFilePtr = std::fopen(inFileName.c_str(), openMode);
-        }
+    if (procFlags.lowImpact) {
+        // before any worker threads exist, so that they inherit it
+        mji::xplat::lowerProcessPriority();
+        mji::xplat::setLowImpactIo(true);
+    }
 
-        if (!inFilePtr) {
-            std::fprintf(stderr, "Unable to open file: %s", std::strerror(errno));
-            return -1;
+    xmph::PressureMonitor pressureMonitor;
+    if (procFlags.adaptiveThreshold) {
+        xmph::PressureOptions pressureOptions;
+        pressureOptions.threshold = *procFlags.adaptiveThreshold;
+        pressureOptions.maxWorkers = procFlags.jobs;
+        if (!pressureMonitor.start(pressureOptions)) {
+            std::fprintf(stderr, "Pressure stall information is not available; --adaptive ignored\n");
         }
+    }
 
-        CFileWrapper inFile{inFilePtr};
-
-        // send file data through hashers
-        constexpr std::size_t inBufSize = 4096;
-        auto inBuf = std::make_unique<unsigned char[]>(inBufSize);
-        // this is the critical loop
-        for (;;) {
-            std::size_t bytesRead = std::fread(inBuf.get(), 1, inBufSize, inFile.fp);
-            if (bytesRead == 0) {
-                if (std::feof(inFile.fp)) {
-                    break;
-                } else {
-                    std::fprintf(stderr, "Failed while reading data from file\n");
-                    return -1;
-                }
-            }
-            for (auto& hasher : hashers) {
-                if (!hasher->consume(inBuf.get(), bytesRead)) {
-                    std::fprintf(stderr, "Hasher \"%s\" failed to consume data\n", hasher->getName());
-                    return -1;
-                }
-            }
+    if (procFlags.kernelCrypto) {
+        if (mji::xplat::kernelHashSupported("sha256")) {
+            xmph::setKernelHashing(true);
+        } else {
+            std::fprintf(stderr, "The kernel crypto API is not available; --kernel-crypto ignored\n");
         }
+    }
 
-        // close file
-        inFile.close();
+    if (procFlags.compressionLevel && !xmph::compressionSupported()) {
+        std::fprintf(stderr, "--compress is not supported (built without zstd)\n");
+        return -1;
+    }
 
-        std::vector<std::unique_ptr<unsigned char[]>> digests;
-        // finalize hashers
-        for (auto& hasher : hashers) {
-            digests.push_back(std::make_unique<unsigned char[]>(xmph::hash_max_digest_size));
-            if (!hasher->finalize(digests.back().get(), xmph::hash_max_digest_size)) {
-                std::fprintf(stderr, "Failed to finalize hasher \"%s\"\n", hasher->getName());
-                return -1;
-            }
-        }
-        // print results
+    if (procFlags.shardCount > 1 && (procFlags.audit || procFlags.benchmark || procFlags.dirhash
+        || procFlags.manifestDiff || procFlags.merge || procFlags.sort || procFlags.buildKnown
+        || procFlags.checkIntegrity))
+    {
+        std::fprintf(stderr, "--shard applies only when hashing files or with --diff\n");
+        return -1;
+    }
 
-        for (std::size_t i = 0; i < hashers.size(); i++) {
-            std::printf("%s: %s\n",
-                hashers[i]->getName(),
-                xmph::bytesToStr(digests[i].get(), hashers[i]->getDigestSize()).c_str()
-            );
-        }
+    if (procFlags.resume && procFlags.journalPath.empty()) {
+        std::fprintf(stderr, "--resume requires --journal\n");
+        return -1;
     }
 
-    return 0;
+    if (procFlags.latencyReport) {
+        xmph::setLatencyTracking(*procFlags.latencyReport);
+    }
+    xmph::setCounterTracking(procFlags.counters);
+
+    int status = runMode(procFlags, posArgs);
+    if (procFlags.latencyReport) {
+        xmph::printLatencyReport(stderr);
+    }
+    if (procFlags.counters) {
+        xmph::printCounterReport(stderr);
+    }
+    return status;
 }
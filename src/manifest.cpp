@@ -0,0 +1,247 @@
+#include <cstdlib>
+#include <cstring>
+
+#include <xmphash/compress.hpp>
+#include <xmphash/hasher.hpp>
+#include <xmphash/manifest.hpp>
+
+namespace mji::xmph {
+
+const std::string* ManifestEntry::findField(std::string_view name) const {
+    for (const auto& field : fields) {
+        if (field.first == name) {
+            return &field.second;
+        }
+    }
+    return nullptr;
+}
+
+std::string formatManifestEntry(const ManifestEntry& entry) {
+    std::string ret;
+    for (std::size_t i = 0; i < entry.fields.size(); i++) {
+        if (i != 0) {
+            ret += ',';
+        }
+        ret += entry.fields[i].first;
+        ret += '=';
+        ret += entry.fields[i].second;
+    }
+    ret += ' ';
+    ret += entry.path;
+    return ret;
+}
+
+std::optional<ManifestEntry> parseManifestRecord(std::string_view record) {
+    std::size_t spaceIdx = record.find(' ');
+    if (spaceIdx == std::string_view::npos || spaceIdx + 1 == record.size()) {
+        return {};
+    }
+
+    ManifestEntry entry;
+    entry.path.assign(record.substr(spaceIdx + 1));
+
+    std::string fieldStr(record.substr(0, spaceIdx));
+    for (const auto& field : splitOnChar(fieldStr.c_str(), ',')) {
+        auto pair = parseNameDigestPair(field.c_str());
+        if (!pair || pair->first.empty()) {
+            return {};
+        }
+        entry.fields.push_back(std::move(*pair));
+    }
+
+    return entry;
+}
+
+std::optional<std::pair<std::string, std::uint64_t>>
+parseBlockFieldName(std::string_view name) {
+    std::size_t atIdx = name.find('@');
+    if (atIdx == std::string_view::npos || atIdx == 0 || atIdx + 1 == name.size()) {
+        return {};
+    }
+
+    std::string sizeStr(name.substr(atIdx + 1));
+    char* end = nullptr;
+    unsigned long long blockSize = std::strtoull(sizeStr.c_str(), &end, 10);
+    if (*end != '\0' || blockSize == 0) {
+        return {};
+    }
+
+    return std::make_pair(std::string(name.substr(0, atIdx)),
+        static_cast<std::uint64_t>(blockSize));
+}
+
+// ManifestReader
+
+ManifestReader::ManifestReader(char terminator)
+: fp_(nullptr),
+  ownsFile_(false),
+  terminator_(terminator),
+  failed_(false),
+  eof_(false),
+  recordNumber_(0),
+  buf_(std::make_unique<char[]>(bufSize)),
+  bufPos_(0),
+  bufLen_(0),
+  record_(),
+  decompressor_()
+{}
+
+ManifestReader::~ManifestReader() {
+    if (ownsFile_ && fp_ != nullptr) {
+        std::fclose(fp_);
+    }
+}
+
+bool ManifestReader::open(const char* path) {
+    if (std::strcmp(path, "-") == 0) {
+        fp_ = stdin;
+        ownsFile_ = false;
+    } else {
+        fp_ = std::fopen(path, "rb");
+        ownsFile_ = true;
+    }
+    if (fp_ == nullptr) {
+        return false;
+    }
+
+    // standard input cannot be rewound, so the bytes read to look for the
+    // magic number are kept and read again
+    bufPos_ = 0;
+    bufLen_ = std::fread(buf_.get(), 1, 4, fp_);
+    if (isCompressed(buf_.get(), bufLen_)) {
+        if (!compressionSupported()) {
+            std::fprintf(stderr, "%s: compressed manifests are not supported (built without zstd)\n", path);
+            return false;
+        }
+        decompressor_ = std::make_unique<StreamDecompressor>();
+        decompressor_->prime(buf_.get(), bufLen_);
+        bufLen_ = 0;
+    }
+    return true;
+}
+
+bool ManifestReader::readRecord() {
+    record_.clear();
+    for (;;) {
+        if (bufPos_ == bufLen_) {
+            if (eof_) {
+                return !record_.empty();
+            }
+            bufPos_ = 0;
+            if (decompressor_) {
+                std::int64_t n = decompressor_->read(fp_, buf_.get(), bufSize);
+                bufLen_ = (n < 0) ? 0 : static_cast<std::size_t>(n);
+                if (n < 0) {
+                    failed_ = true;
+                    return false;
+                }
+            } else {
+                bufLen_ = std::fread(buf_.get(), 1, bufSize, fp_);
+            }
+            if (bufLen_ == 0) {
+                if (std::ferror(fp_)) {
+                    failed_ = true;
+                    return false;
+                }
+                eof_ = true;
+                continue;
+            }
+        }
+
+        const char* start = buf_.get() + bufPos_;
+        auto term = static_cast<const char*>(
+            std::memchr(start, terminator_, bufLen_ - bufPos_));
+        if (term == nullptr) {
+            record_.append(start, bufLen_ - bufPos_);
+            bufPos_ = bufLen_;
+        } else {
+            record_.append(start, term - start);
+            bufPos_ += (term - start) + 1;
+            return true;
+        }
+    }
+}
+
+bool ManifestReader::next(ManifestEntry& entry) {
+    if (fp_ == nullptr || failed_) {
+        return false;
+    }
+
+    for (;;) {
+        if (!readRecord()) {
+            return false;
+        }
+        recordNumber_++;
+        if (record_.empty() || record_[0] == '#') {
+            continue;
+        }
+        if (terminator_ == '\n' && record_.back() == '\r') {
+            record_.pop_back();
+        }
+
+        auto parsed = parseManifestRecord(record_);
+        if (!parsed) {
+            failed_ = true;
+            return false;
+        }
+        entry = std::move(*parsed);
+        return true;
+    }
+}
+
+bool ManifestReader::failed() const {
+    return failed_;
+}
+
+std::uint64_t ManifestReader::recordNumber() const {
+    return recordNumber_;
+}
+
+// ManifestWriter
+
+ManifestWriter::ManifestWriter(std::FILE* fp, char terminator,
+    std::optional<int> compressionLevel)
+: fp_(fp),
+  terminator_(terminator),
+  compressor_(),
+  pending_()
+{
+    if (compressionLevel) {
+        compressor_ = std::make_unique<FrameCompressor>(fp, *compressionLevel);
+    }
+}
+
+ManifestWriter::~ManifestWriter() {
+    finish();
+}
+
+bool ManifestWriter::write(const ManifestEntry& entry) {
+    if (entry.path.find(terminator_) != std::string::npos) {
+        return false;
+    }
+    std::string record = formatManifestEntry(entry);
+    record += terminator_;
+    if (!compressor_) {
+        return std::fwrite(record.data(), 1, record.size(), fp_) == record.size();
+    }
+
+    // frames end on a record boundary so that each can be parsed alone
+    pending_ += record;
+    if (pending_.size() < compressed_frame_size) {
+        return true;
+    }
+    bool ok = compressor_->write(std::move(pending_));
+    pending_.clear();
+    return ok;
+}
+
+bool ManifestWriter::finish() {
+    if (!compressor_) {
+        return std::fflush(fp_) == 0;
+    }
+    bool ok = pending_.empty() || compressor_->write(std::move(pending_));
+    pending_.clear();
+    return compressor_->finish() && ok;
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <queue>
+#include <system_error>
+#include <utility>
+
+#include <xmphash/compress.hpp>
+#include <xmphash/hasher.hpp>
+#include <xmphash/manifest.hpp>
+#include <xmphash/manifestops.hpp>
+
+namespace fs = std::filesystem;
+
+namespace mji::xmph {
+
+namespace {
+
+/// Orders records by path, then by their bytes, so sorting is deterministic
+bool recordLess(std::string_view a, std::string_view b) {
+    std::string_view pathA = MappedManifest::recordPath(a);
+    std::string_view pathB = MappedManifest::recordPath(b);
+    return pathA < pathB || (pathA == pathB && a < b);
+}
+
+/// Orders records by path alone
+bool pathLess(std::string_view a, std::string_view b) {
+    return MappedManifest::recordPath(a) < MappedManifest::recordPath(b);
+}
+
+bool writeRecord(std::FILE* out, std::string_view record, char terminator) {
+    return std::fwrite(record.data(), 1, record.size(), out) == record.size()
+        && std::fputc(terminator, out) != EOF;
+}
+
+/// Creates an empty, uniquely named temporary file and returns its path
+std::optional<std::string> makeTempFile(const ManifestOpsOptions& options) {
+    static std::uint64_t counter = 0;
+    static const std::uint64_t processKey = mix64(static_cast<std::uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count()));
+
+    std::error_code ec;
+    fs::path dir = options.tempDir.empty() ? fs::temp_directory_path(ec) : fs::path(options.tempDir);
+    if (ec) {
+        std::fprintf(stderr, "Unable to find a temporary directory: %s\n", ec.message().c_str());
+        return {};
+    }
+
+    for (int attempt = 0; attempt < 100; attempt++) {
+        std::string name = "xmphash-sort-" + bytesToStr(
+            reinterpret_cast<const unsigned char*>(&processKey), sizeof(processKey))
+            + "-" + std::to_string(counter++);
+        std::string path = (dir / name).string();
+        // "x": fail rather than reuse a file someone else created
+        std::FILE* fp = std::fopen(path.c_str(), "wbx");
+        if (fp != nullptr) {
+            std::fclose(fp);
+            return path;
+        }
+    }
+    std::fprintf(stderr, "Unable to create a temporary file in \"%s\"\n", dir.string().c_str());
+    return {};
+}
+
+/// Deletes a temporary file when it goes out of scope
+class TempFile final {
+public:
+    TempFile() = default;
+    explicit TempFile(std::string path)
+    : path_(std::move(path))
+    {}
+
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+    TempFile(TempFile&& other)
+    : path_(std::move(other.path_))
+    {
+        other.path_.clear();
+    }
+    TempFile& operator=(TempFile&& other) {
+        if (this != &other) {
+            remove();
+            path_ = std::move(other.path_);
+            other.path_.clear();
+        }
+        return *this;
+    }
+
+    ~TempFile() {
+        remove();
+    }
+
+    const std::string& path() const {
+        return path_;
+    }
+
+private:
+    void remove() {
+        if (!path_.empty()) {
+            std::error_code ec;
+            fs::remove(path_, ec);
+            path_.clear();
+        }
+    }
+
+    std::string path_;
+};
+
+/// Merges sources sorted by less, calling emit(record, sourceIdx) in order.
+/// Records that less considers equal are emitted in source order.
+template <typename Less, typename Emit>
+bool mergeSources(std::vector<std::unique_ptr<MappedManifest>>& sources, Less less, Emit&& emit) {
+    using Head = std::pair<std::string_view, std::size_t>;
+    auto greater = [less](const Head& a, const Head& b) {
+        if (less(b.first, a.first)) {
+            return true;
+        } else if (less(a.first, b.first)) {
+            return false;
+        }
+        return a.second > b.second;
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(greater)> heap(greater);
+
+    for (std::size_t i = 0; i < sources.size(); i++) {
+        std::string_view record;
+        if (sources[i]->next(record)) {
+            heap.emplace(record, i);
+        }
+    }
+    while (!heap.empty()) {
+        Head head = heap.top();
+        heap.pop();
+        if (!emit(head.first, head.second)) {
+            return false;
+        }
+        std::string_view record;
+        if (sources[head.second]->next(record)) {
+            heap.emplace(record, head.second);
+        } else if (!sources[head.second]->ok()) {
+            return false;
+        }
+    }
+    return std::all_of(sources.begin(), sources.end(), [](const auto& source) {
+        return source->ok();
+    });
+}
+
+/// A manifest guaranteed to be read in sorted order, sorting it into a
+/// temporary file first if necessary
+class SortedInput final {
+public:
+    explicit SortedInput(const ManifestOpsOptions& options)
+    : options_(options),
+      manifest_(std::make_unique<MappedManifest>(options.terminator))
+    {}
+
+    bool open(const char* path) {
+        if (isManifestSorted(path, options_.terminator)) {
+            return manifest_->open(path);
+        }
+
+        std::fprintf(stderr, "%s: not sorted, sorting first\n", path);
+        auto tempPath = makeTempFile(options_);
+        if (!tempPath) {
+            return false;
+        }
+        sorted_ = TempFile(*tempPath);
+        std::FILE* fp = std::fopen(sorted_.path().c_str(), "wb");
+        if (fp == nullptr) {
+            return false;
+        }
+        bool ok = sortManifest(path, fp, options_);
+        ok = (std::fclose(fp) == 0) && ok;
+        return ok && manifest_->open(sorted_.path().c_str());
+    }
+
+    MappedManifest& manifest() {
+        return *manifest_;
+    }
+
+    std::unique_ptr<MappedManifest> release() {
+        return std::move(manifest_);
+    }
+
+private:
+    ManifestOpsOptions options_;
+    // declared before the mapping so the file outlives it
+    TempFile sorted_;
+    std::unique_ptr<MappedManifest> manifest_;
+};
+
+bool recordsDiffer(std::string_view oldRecord, std::string_view newRecord) {
+    if (oldRecord == newRecord) {
+        return false;
+    }
+    auto oldEntry = parseManifestRecord(oldRecord);
+    auto newEntry = parseManifestRecord(newRecord);
+    if (!oldEntry || !newEntry) {
+        return true;
+    }
+
+    bool anyCommon = false;
+    for (const auto& field : oldEntry->fields) {
+        const std::string* other = newEntry->findField(field.first);
+        if (other == nullptr) {
+            continue;
+        }
+        anyCommon = true;
+        if (*other != field.second) {
+            return true;
+        }
+    }
+    return !anyCommon;
+}
+
+}  // namespace
+
+// MappedManifest
+
+MappedManifest::MappedManifest(char terminator)
+: file_(),
+  stream_(nullptr, std::fclose),
+  streamPath_(),
+  decompressor_(),
+  window_(),
+  content_(),
+  terminator_(terminator),
+  pos_(0),
+  streamEnded_(false),
+  failed_(false)
+{}
+
+bool MappedManifest::open(const char* path) {
+    pos_ = 0;
+    stream_.reset();
+    decompressor_.reset();
+    window_.clear();
+    streamEnded_ = false;
+    failed_ = false;
+    if (!file_.open(path)) {
+        std::fprintf(stderr, "%s: unable to map manifest\n", path);
+        return false;
+    }
+    content_ = std::string_view(file_.data(), file_.size());
+    if (isCompressed(file_.data(), file_.size())) {
+        file_.close();
+        content_ = std::string_view();
+        if (!compressionSupported()) {
+            std::fprintf(stderr, "%s: compressed manifests are not supported (built without zstd)\n",
+                path);
+            return false;
+        }
+        stream_.reset(std::fopen(path, "rb"));
+        if (!stream_) {
+            std::fprintf(stderr, "%s: unable to open manifest\n", path);
+            return false;
+        }
+        streamPath_ = path;
+        decompressor_ = std::make_unique<StreamDecompressor>();
+    }
+    return true;
+}
+
+bool MappedManifest::refill() {
+    if (!stream_ || streamEnded_ || failed_) {
+        return false;
+    }
+    window_.erase(0, pos_);
+    pos_ = 0;
+    std::size_t have = window_.size();
+    window_.resize(have + inflate_size);
+    std::int64_t got = decompressor_->read(stream_.get(), window_.data() + have, inflate_size);
+    window_.resize(have + static_cast<std::size_t>(std::max<std::int64_t>(got, 0)));
+    content_ = window_;
+    if (got < 0) {
+        std::fprintf(stderr, "%s: unable to decompress manifest\n", streamPath_.c_str());
+        failed_ = true;
+        return false;
+    }
+    streamEnded_ = got == 0;
+    // the last record may lack its terminator
+    return !streamEnded_ || !window_.empty();
+}
+
+bool MappedManifest::next(std::string_view& record) {
+    for (;;) {
+        const char* data = content_.data();
+        std::size_t size = content_.size();
+        while (pos_ < size) {
+            auto term = static_cast<const char*>(std::memchr(data + pos_, terminator_, size - pos_));
+            if (term == nullptr && stream_ && !streamEnded_) {
+                // the rest of the record is still compressed
+                break;
+            }
+            std::size_t end = (term == nullptr) ? size : static_cast<std::size_t>(term - data);
+            std::string_view candidate(data + pos_, end - pos_);
+            pos_ = end + 1;
+            if (terminator_ == '\n' && !candidate.empty() && candidate.back() == '\r') {
+                candidate.remove_suffix(1);
+            }
+            if (!candidate.empty() && candidate[0] != '#') {
+                record = candidate;
+                return true;
+            }
+        }
+        if (!refill()) {
+            return false;
+        }
+    }
+}
+
+bool MappedManifest::ok() const {
+    return !failed_;
+}
+
+bool MappedManifest::keepsRecords() const {
+    return !stream_;
+}
+
+std::string_view MappedManifest::recordPath(std::string_view record) {
+    std::size_t spaceIdx = record.find(' ');
+    return (spaceIdx == std::string_view::npos) ? std::string_view() : record.substr(spaceIdx + 1);
+}
+
+bool isManifestSorted(const char* path, char terminator) {
+    MappedManifest manifest(terminator);
+    if (!manifest.open(path)) {
+        return false;
+    }
+    // a compressed manifest's records do not outlive the next one
+    std::string prev;
+    std::string_view record;
+    bool first = true;
+    while (manifest.next(record)) {
+        if (!first && recordLess(record, prev)) {
+            return false;
+        }
+        prev.assign(record);
+        first = false;
+    }
+    return manifest.ok();
+}
+
+bool sortManifest(const char* path, std::FILE* out, const ManifestOpsOptions& options) {
+    MappedManifest input(options.terminator);
+    if (!input.open(path)) {
+        return false;
+    }
+
+    std::vector<TempFile> runs;
+    std::vector<std::string_view> run;
+    // copies of the run's records, when the input does not keep them
+    std::deque<std::string> copies;
+    std::uint64_t runBytes = 0;
+
+    auto spillRun = [&]() {
+        std::sort(run.begin(), run.end(), recordLess);
+        auto tempPath = makeTempFile(options);
+        if (!tempPath) {
+            return false;
+        }
+        runs.emplace_back(*tempPath);
+        std::FILE* fp = std::fopen(tempPath->c_str(), "wb");
+        if (fp == nullptr) {
+            return false;
+        }
+        bool ok = true;
+        for (std::string_view record : run) {
+            ok = ok && writeRecord(fp, record, options.terminator);
+        }
+        ok = (std::fclose(fp) == 0) && ok;
+        run.clear();
+        copies.clear();
+        runBytes = 0;
+        return ok;
+    };
+
+    std::string_view record;
+    while (input.next(record)) {
+        runBytes += record.size() + sizeof(std::string_view);
+        if (!input.keepsRecords()) {
+            copies.emplace_back(record);
+            record = copies.back();
+            runBytes += sizeof(std::string);
+        }
+        run.push_back(record);
+        if (runBytes >= options.sortMemory && !spillRun()) {
+            return false;
+        }
+    }
+    if (!input.ok()) {
+        return false;
+    }
+
+    if (runs.empty()) {
+        // everything fit in one run
+        std::sort(run.begin(), run.end(), recordLess);
+        for (std::string_view sortedRecord : run) {
+            if (!writeRecord(out, sortedRecord, options.terminator)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (!run.empty() && !spillRun()) {
+        return false;
+    }
+
+    std::vector<std::unique_ptr<MappedManifest>> sources;
+    for (const auto& runFile : runs) {
+        sources.push_back(std::make_unique<MappedManifest>(options.terminator));
+        if (!sources.back()->open(runFile.path().c_str())) {
+            return false;
+        }
+    }
+    bool ok = mergeSources(sources, recordLess, [&](std::string_view merged, std::size_t) {
+        return writeRecord(out, merged, options.terminator);
+    });
+    // unmap before the runs are deleted
+    sources.clear();
+    return ok;
+}
+
+bool diffManifests(const char* oldPath, const char* newPath,
+    const ManifestOpsOptions& options, ManifestDiffReport& report)
+{
+    SortedInput oldInput(options);
+    SortedInput newInput(options);
+    if (!oldInput.open(oldPath) || !newInput.open(newPath)) {
+        return false;
+    }
+
+    MappedManifest& oldManifest = oldInput.manifest();
+    MappedManifest& newManifest = newInput.manifest();
+    std::string_view oldRecord;
+    std::string_view newRecord;
+    bool haveOld = oldManifest.next(oldRecord);
+    bool haveNew = newManifest.next(newRecord);
+
+    auto print = [](const char* label, std::string_view path) {
+        std::printf("%s: %.*s\n", label, static_cast<int>(path.size()), path.data());
+    };
+
+    while (haveOld || haveNew) {
+        if (!oldManifest.ok() || !newManifest.ok()) {
+            return false;
+        }
+        std::string_view oldRecPath = MappedManifest::recordPath(oldRecord);
+        std::string_view newRecPath = MappedManifest::recordPath(newRecord);
+        if (!haveNew || (haveOld && oldRecPath < newRecPath)) {
+            print("removed", oldRecPath);
+            report.removed++;
+            haveOld = oldManifest.next(oldRecord);
+        } else if (!haveOld || newRecPath < oldRecPath) {
+            print("added", newRecPath);
+            report.added++;
+            haveNew = newManifest.next(newRecord);
+        } else {
+            if (recordsDiffer(oldRecord, newRecord)) {
+                print("changed", newRecPath);
+                report.changed++;
+            } else {
+                report.unchanged++;
+            }
+            haveOld = oldManifest.next(oldRecord);
+            haveNew = newManifest.next(newRecord);
+        }
+    }
+    return oldManifest.ok() && newManifest.ok();
+}
+
+bool mergeManifests(const std::vector<std::string>& paths, std::FILE* out,
+    const ManifestOpsOptions& options)
+{
+    // keep the SortedInputs (and their temporary files) alive while merging
+    std::vector<std::unique_ptr<SortedInput>> inputs;
+    std::vector<std::unique_ptr<MappedManifest>> sources;
+    for (const auto& path : paths) {
+        inputs.push_back(std::make_unique<SortedInput>(options));
+        if (!inputs.back()->open(path.c_str())) {
+            return false;
+        }
+        sources.push_back(inputs.back()->release());
+    }
+
+    std::string lastPath;
+    std::string lastRecord;
+    bool haveLast = false;
+    // by path alone, so the earliest input's record for a path comes first
+    bool ok = mergeSources(sources, pathLess, [&](std::string_view record, std::size_t sourceIdx) {
+        std::string_view recPath = MappedManifest::recordPath(record);
+        if (haveLast && recPath == lastPath) {
+            if (record != lastRecord) {
+                std::fprintf(stderr, "%s: conflicting record in \"%s\" ignored\n",
+                    lastPath.c_str(), paths[sourceIdx].c_str());
+            }
+            return true;
+        }
+        lastPath.assign(recPath);
+        lastRecord.assign(record);
+        haveLast = true;
+        return writeRecord(out, record, options.terminator);
+    });
+    sources.clear();
+    return ok;
+}
+
+}  // namespace mji::xmph
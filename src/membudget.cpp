@@ -0,0 +1,59 @@
+#include <algorithm>
+
+#include <xmphash/membudget.hpp>
+
+namespace mji::xmph {
+
+MemoryBudget::MemoryBudget(std::uint64_t limit)
+: limit_(limit),
+  inUse_(0),
+  peak_(0),
+  mutex_(),
+  changed_()
+{}
+
+void MemoryBudget::acquire(std::uint64_t bytes, const std::function<bool()>& mayExceed) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] {
+        return inUse_ + bytes <= limit_ || (mayExceed && mayExceed());
+    });
+    inUse_ += bytes;
+    peak_ = std::max(peak_, inUse_);
+}
+
+bool MemoryBudget::tryAcquire(std::uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (inUse_ + bytes > limit_) {
+        return false;
+    }
+    inUse_ += bytes;
+    peak_ = std::max(peak_, inUse_);
+    return true;
+}
+
+void MemoryBudget::release(std::uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inUse_ -= std::min(inUse_, bytes);
+    }
+    changed_.notify_all();
+}
+
+void MemoryBudget::wake() {
+    {
+        // so that a waiter cannot miss the wakeup between its check and wait
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    changed_.notify_all();
+}
+
+std::uint64_t MemoryBudget::limit() const {
+    return limit_;
+}
+
+std::uint64_t MemoryBudget::peak() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peak_;
+}
+
+}  // namespace mji::xmph
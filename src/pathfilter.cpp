@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <map>
+
+#include <xmphash/hasher.hpp>
+#include <xmphash/pathfilter.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+/// Parses a bracket expression starting just after the '['. Returns the
+/// position just after the closing ']', or 0 if there is none.
+std::size_t parseBracket(std::string_view glob, std::size_t pos, std::bitset<256>& set) {
+    bool negate = pos < glob.size() && (glob[pos] == '!' || glob[pos] == '^');
+    if (negate) {
+        pos++;
+    }
+    bool first = true;
+    while (pos < glob.size() && (first || glob[pos] != ']')) {
+        first = false;
+        auto lo = static_cast<unsigned char>(glob[pos]);
+        if (lo == '\\' && pos + 1 < glob.size()) {
+            lo = static_cast<unsigned char>(glob[++pos]);
+        }
+        pos++;
+        unsigned char hi = lo;
+        if (pos + 1 < glob.size() && glob[pos] == '-' && glob[pos + 1] != ']') {
+            hi = static_cast<unsigned char>(glob[pos + 1]);
+            pos += 2;
+        }
+        for (unsigned int c = lo; c <= hi; c++) {
+            set.set(c);
+        }
+    }
+    if (pos >= glob.size()) {
+        return 0;
+    }
+    if (negate) {
+        set.flip();
+    }
+    return pos + 1;
+}
+
+}  // namespace
+
+PathFilter::PathFilter()
+: globs_(),
+  hasIncludes_(false),
+  minSize_(0),
+  maxSize_(std::numeric_limits<std::uint64_t>::max()),
+  shardIndex_(0),
+  shardCount_(1),
+  positionGlob_(),
+  globBase_(),
+  classOf_(),
+  classByte_(),
+  classCount_(0),
+  dfa_(std::make_unique<Dfa>())
+{
+    compile();
+}
+
+bool PathFilter::addInclude(std::string_view glob) {
+    hasIncludes_ = true;
+    return addGlob(glob, Kind::include);
+}
+
+bool PathFilter::addExclude(std::string_view glob) {
+    return addGlob(glob, Kind::exclude);
+}
+
+void PathFilter::setSizeRange(std::uint64_t minSize, std::uint64_t maxSize) {
+    minSize_ = minSize;
+    maxSize_ = maxSize;
+}
+
+void PathFilter::setShard(std::uint32_t index, std::uint32_t count) {
+    shardIndex_ = index;
+    shardCount_ = count;
+}
+
+bool PathFilter::addGlob(std::string_view glob, Kind kind) {
+    while (!glob.empty() && glob.back() == '/') {
+        glob.remove_suffix(1);
+    }
+    if (glob.empty()) {
+        std::fprintf(stderr, "Empty path pattern\n");
+        return false;
+    }
+    // a glob with no '/' matches the name of an entry: only the star that
+    // anchors it may cross a '/'
+    bool nameGlob = glob.find('/') == std::string_view::npos;
+    std::string anchored;
+    if (nameGlob) {
+        anchored = "*/";
+    } else if (glob.front() != '/' && glob.front() != '*') {
+        anchored = "/";
+    }
+    std::size_t anchorSize = anchored.size();
+    anchored += glob;
+
+    Glob compiled;
+    compiled.kind = kind;
+    for (std::size_t pos = 0; pos < anchored.size();) {
+        char c = anchored[pos];
+        bool inName = nameGlob && pos >= anchorSize;
+        std::bitset<256> set;
+        if (c == '*') {
+            // a run of stars is one star
+            if (compiled.stars.empty() || !compiled.stars.back()) {
+                set.set();
+                if (inName) {
+                    set.reset('/');
+                }
+                compiled.sets.push_back(set);
+                compiled.stars.push_back(true);
+            }
+            pos++;
+            continue;
+        } else if (c == '?') {
+            set.set();
+            pos++;
+        } else if (c == '[') {
+            std::size_t end = parseBracket(anchored, pos + 1, set);
+            if (end == 0) {
+                std::fprintf(stderr, "Unterminated '[' in path pattern \"%.*s\"\n",
+                    static_cast<int>(glob.size()), glob.data());
+                return false;
+            }
+            pos = end;
+        } else if (c == '\\' && pos + 1 < anchored.size()) {
+            set.set(static_cast<unsigned char>(anchored[pos + 1]));
+            pos += 2;
+        } else {
+            set.set(static_cast<unsigned char>(c));
+            pos++;
+        }
+        if (inName) {
+            set.reset('/');
+        }
+        compiled.sets.push_back(set);
+        compiled.stars.push_back(false);
+    }
+    globs_.push_back(std::move(compiled));
+    return true;
+}
+
+void PathFilter::compile() {
+    positionGlob_.clear();
+    globBase_.clear();
+    for (std::size_t g = 0; g < globs_.size(); g++) {
+        globBase_.push_back(static_cast<std::uint32_t>(positionGlob_.size()));
+        positionGlob_.resize(positionGlob_.size() + globs_[g].sets.size() + 1,
+            static_cast<std::uint32_t>(g));
+    }
+
+    // bytes that every set treats alike share a class
+    std::map<std::vector<bool>, unsigned char> signatures;
+    for (unsigned int c = 0; c < 256; c++) {
+        std::vector<bool> signature;
+        for (const auto& glob : globs_) {
+            for (const auto& set : glob.sets) {
+                signature.push_back(set.test(c));
+            }
+        }
+        auto it = signatures.emplace(std::move(signature), signatures.size()).first;
+        classOf_[c] = it->second;
+        classByte_[it->second] = static_cast<unsigned char>(c);
+    }
+    classCount_ = signatures.size();
+
+    dfa_ = std::make_unique<Dfa>();
+    std::vector<std::uint32_t> start(globBase_.begin(), globBase_.end());
+    intern(std::move(start));
+}
+
+std::uint32_t PathFilter::intern(std::vector<std::uint32_t> positions) const {
+    // a star may match nothing, so reaching it also reaches what follows
+    for (std::size_t i = 0; i < positions.size(); i++) {
+        std::uint32_t p = positions[i];
+        const Glob& glob = globs_[positionGlob_[p]];
+        std::size_t elem = p - globBase_[positionGlob_[p]];
+        if (elem < glob.sets.size() && glob.stars[elem]) {
+            positions.push_back(p + 1);
+        }
+    }
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+    auto [it, added] = dfa_->ids.emplace(positions, static_cast<std::uint32_t>(dfa_->states.size()));
+    if (!added) {
+        return it->second;
+    }
+    State state;
+    for (std::uint32_t p : positions) {
+        const Glob& glob = globs_[positionGlob_[p]];
+        std::size_t elem = p - globBase_[positionGlob_[p]];
+        bool include = glob.kind == Kind::include;
+        if (elem == glob.sets.size()) {
+            (include ? state.acceptsInclude : state.acceptsExclude) = true;
+        } else if (include) {
+            state.mayInclude = true;
+        } else if (glob.stars[elem] && glob.sets[elem].all() && elem + 1 == glob.sets.size()) {
+            state.excludesAll = true;
+        }
+    }
+    state.positions = std::move(positions);
+    dfa_->states.push_back(std::move(state));
+    dfa_->transitions.resize(dfa_->states.size() * classCount_, unknown_state);
+    return it->second;
+}
+
+std::uint32_t PathFilter::step(std::uint32_t state, unsigned char c) const {
+    std::size_t k = classOf_[c];
+    std::uint32_t& known = dfa_->transitions[state * classCount_ + k];
+    if (known != unknown_state) {
+        return known;
+    }
+    std::vector<std::uint32_t> next;
+    for (std::uint32_t p : dfa_->states[state].positions) {
+        const Glob& glob = globs_[positionGlob_[p]];
+        std::size_t elem = p - globBase_[positionGlob_[p]];
+        if (elem == glob.sets.size()) {
+            continue;
+        } else if (glob.stars[elem]) {
+            if (glob.sets[elem].test(classByte_[k])) {
+                next.push_back(p);
+            }
+        } else if (glob.sets[elem].test(classByte_[k])) {
+            next.push_back(p + 1);
+        }
+    }
+    // interning may grow the table, so the reference cannot be reused
+    std::uint32_t target = intern(std::move(next));
+    dfa_->transitions[state * classCount_ + k] = target;
+    return target;
+}
+
+PathFilter::State PathFilter::flags(std::uint32_t state) const {
+    std::lock_guard<std::mutex> lock(dfa_->mutex);
+    const State& s = dfa_->states[state];
+    State copy;
+    copy.acceptsInclude = s.acceptsInclude;
+    copy.acceptsExclude = s.acceptsExclude;
+    copy.excludesAll = s.excludesAll;
+    copy.mayInclude = s.mayInclude;
+    return copy;
+}
+
+bool PathFilter::empty() const {
+    return globs_.empty() && minSize_ == 0
+        && maxSize_ == std::numeric_limits<std::uint64_t>::max() && !sharded();
+}
+
+bool PathFilter::sharded() const {
+    return shardCount_ > 1;
+}
+
+bool PathFilter::inShard(std::string_view key) const {
+    return mix64(stableHash64(key)) % shardCount_ == shardIndex_;
+}
+
+PathFilter::Cursor PathFilter::root() const {
+    return {0, false, false, false};
+}
+
+PathFilter::Cursor PathFilter::child(Cursor dir, std::string_view name) const {
+    bool otherShard = dir.otherShard || (!dir.belowRoot && !inShard(name));
+    std::lock_guard<std::mutex> lock(dfa_->mutex);
+    Cursor cursor{step(dir.state, '/'), dir.included || dfa_->states[dir.state].acceptsInclude,
+        true, otherShard};
+    for (char c : name) {
+        cursor.state = step(cursor.state, static_cast<unsigned char>(c));
+    }
+    return cursor;
+}
+
+bool PathFilter::prunesDir(Cursor dir) const {
+    if (dir.otherShard) {
+        return true;
+    }
+    std::uint32_t insideState;
+    {
+        std::lock_guard<std::mutex> lock(dfa_->mutex);
+        insideState = step(dir.state, '/');
+    }
+    State here = flags(dir.state);
+    State inside = flags(insideState);
+    if (here.acceptsExclude || inside.excludesAll) {
+        return true;
+    }
+    bool included = dir.included || here.acceptsInclude;
+    return hasIncludes_ && !included && !inside.mayInclude;
+}
+
+bool PathFilter::keepsEntry(Cursor entry) const {
+    if (entry.otherShard) {
+        return false;
+    }
+    State s = flags(entry.state);
+    return !s.acceptsExclude && (!hasIncludes_ || entry.included || s.acceptsInclude);
+}
+
+bool PathFilter::keepsFile(Cursor file, std::uint64_t size) const {
+    return keepsEntry(file) && size >= minSize_ && size <= maxSize_;
+}
+
+bool PathFilter::keepsPath(std::string_view relPath, std::uint64_t size) const {
+    Cursor cursor = root();
+    for (;;) {
+        std::size_t slash = relPath.find('/');
+        cursor = child(cursor, relPath.substr(0, slash));
+        if (slash == std::string_view::npos) {
+            return keepsFile(cursor, size);
+        } else if (prunesDir(cursor)) {
+            return false;
+        }
+        relPath.remove_prefix(slash + 1);
+    }
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+#include <xmphash/hasher.hpp>
+#include <xmphash/pathindex.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr std::size_t bucket_load = 4;
+constexpr std::uint32_t max_pilot = 1u << 20;
+constexpr unsigned int max_build_attempts = 16;
+
+}  // namespace
+
+PathIndex::PathIndex()
+: paths_(),
+  pilots_(),
+  slots_(),
+  seed_(0)
+{}
+
+std::uint64_t PathIndex::keyHash(std::string_view path) const {
+    return mix64(stableHash64(path) ^ seed_);
+}
+
+std::size_t PathIndex::bucketOf(std::uint64_t hash) const {
+    return static_cast<std::size_t>(hash % pilots_.size());
+}
+
+std::size_t PathIndex::slotOf(std::uint64_t hash, std::uint32_t pilot) const {
+    if (pilot & direct_flag) {
+        return pilot & ~direct_flag;
+    }
+    return static_cast<std::size_t>(
+        mix64(hash + pilot * 0x9e3779b97f4a7c15u) % slots_.size());
+}
+
+PathIndex::BuildResult PathIndex::build(std::vector<std::string> paths, std::string* duplicate) {
+    paths_.clear();
+    pilots_.clear();
+    slots_.clear();
+    std::size_t n = paths.size();
+    if (n == 0) {
+        return BuildResult::ok;
+    }
+    if (n >= direct_flag) {
+        return BuildResult::tooManyPaths;
+    }
+
+    std::vector<std::uint64_t> hashes(n);
+    for (unsigned int attempt = 0; attempt < max_build_attempts; attempt++) {
+        seed_ = mix64(attempt + 1);
+        pilots_.assign(n / bucket_load + 1, 0);
+        slots_.assign(n, 0);
+        for (std::size_t i = 0; i < n; i++) {
+            hashes[i] = keyHash(paths[i]);
+        }
+
+        // group keys by bucket, largest buckets first
+        std::vector<std::vector<std::uint32_t>> buckets(pilots_.size());
+        for (std::size_t i = 0; i < n; i++) {
+            buckets[bucketOf(hashes[i])].push_back(static_cast<std::uint32_t>(i));
+        }
+        std::vector<std::uint32_t> order(buckets.size());
+        for (std::size_t b = 0; b < order.size(); b++) {
+            order[b] = static_cast<std::uint32_t>(b);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::vector<bool> taken(n, false);
+        std::vector<std::size_t> positions;
+        bool placedAll = true;
+        std::optional<std::uint32_t> duplicateKey;
+        std::size_t nextFree = 0;
+        for (std::uint32_t b : order) {
+            const auto& keys = buckets[b];
+            if (keys.empty()) {
+                break;
+            } else if (keys.size() == 1) {
+                while (taken[nextFree]) {
+                    nextFree++;
+                }
+                taken[nextFree] = true;
+                pilots_[b] = direct_flag | static_cast<std::uint32_t>(nextFree);
+                slots_[nextFree] = keys[0];
+                continue;
+            }
+
+            // keys with equal hashes can never be separated by a pilot
+            for (std::size_t i = 0; i < keys.size() && !duplicateKey; i++) {
+                for (std::size_t j = i + 1; j < keys.size(); j++) {
+                    if (hashes[keys[i]] == hashes[keys[j]]) {
+                        if (paths[keys[i]] == paths[keys[j]]) {
+                            duplicateKey = keys[i];
+                        }
+                        placedAll = false;
+                    }
+                }
+            }
+            if (!placedAll) {
+                break;
+            }
+
+            bool placed = false;
+            for (std::uint32_t pilot = 0; pilot < max_pilot && !placed; pilot++) {
+                positions.clear();
+                placed = true;
+                for (std::uint32_t key : keys) {
+                    std::size_t pos = slotOf(hashes[key], pilot);
+                    if (taken[pos] || std::find(positions.begin(), positions.end(), pos) != positions.end()) {
+                        placed = false;
+                        break;
+                    }
+                    positions.push_back(pos);
+                }
+                if (placed) {
+                    pilots_[b] = pilot;
+                    for (std::size_t k = 0; k < keys.size(); k++) {
+                        taken[positions[k]] = true;
+                        slots_[positions[k]] = keys[k];
+                    }
+                }
+            }
+            if (!placed) {
+                placedAll = false;
+                break;
+            }
+        }
+
+        if (duplicateKey) {
+            pilots_.clear();
+            slots_.clear();
+            if (duplicate != nullptr) {
+                *duplicate = std::move(paths[*duplicateKey]);
+            }
+            return BuildResult::duplicatePath;
+        } else if (placedAll) {
+            paths_ = std::move(paths);
+            return BuildResult::ok;
+        }
+    }
+
+    // a failed placement may have stopped short of the bucket holding a
+    // duplicate, so look for one before blaming the placement
+    std::sort(paths.begin(), paths.end());
+    auto repeated = std::adjacent_find(paths.begin(), paths.end());
+    pilots_.clear();
+    slots_.clear();
+    if (repeated != paths.end()) {
+        if (duplicate != nullptr) {
+            *duplicate = std::move(*repeated);
+        }
+        return BuildResult::duplicatePath;
+    }
+    return BuildResult::unplaceable;
+}
+
+std::size_t PathIndex::find(std::string_view path) const {
+    if (paths_.empty()) {
+        return npos;
+    }
+    std::uint64_t hash = keyHash(path);
+    std::uint32_t idx = slots_[slotOf(hash, pilots_[bucketOf(hash)])];
+    return (paths_[idx] == path) ? idx : npos;
+}
+
+std::size_t PathIndex::size() const {
+    return paths_.size();
+}
+
+const std::string& PathIndex::path(std::size_t idx) const {
+    assert(idx < paths_.size());
+    return paths_[idx];
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <utility>
+
+#include <xmphash/prefetch.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+/// Prefetching less than this of a file is hardly worth the system calls
+constexpr std::uint64_t min_prefetch_length = 128 << 10;
+
+}  // namespace
+
+Prefetcher::Prefetcher(const std::vector<std::string>& paths, std::vector<std::size_t> order,
+    const PrefetchOptions& options)
+: paths_(paths),
+  order_(std::move(order)),
+  options_(options),
+  thread_(),
+  mutex_(),
+  changed_(),
+  stopping_(false),
+  started_(0),
+  ahead_(0),
+  outstanding_(),
+  outstandingBytes_(0)
+{
+    if (options_.depth != 0 && order_.size() > 1) {
+        thread_ = std::thread([this] { run(); });
+    }
+}
+
+Prefetcher::~Prefetcher() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+}
+
+void Prefetcher::started(std::size_t pos) {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        started_ = std::max(started_, pos + 1);
+        retireStarted();
+    }
+    changed_.notify_all();
+}
+
+void Prefetcher::retireStarted() {
+    while (!outstanding_.empty() && outstanding_.front().first < started_) {
+        outstandingBytes_ -= outstanding_.front().second;
+        outstanding_.pop_front();
+    }
+    // never prefetch a file a worker already has
+    ahead_ = std::max(ahead_, started_);
+}
+
+void Prefetcher::run() {
+    std::uint64_t share = std::max(min_prefetch_length, options_.byteBudget / options_.depth);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        changed_.wait(lock, [&] {
+            return stopping_ || (ahead_ < order_.size() && ahead_ < started_ + options_.depth
+                && outstandingBytes_ + share <= std::max(share, options_.byteBudget));
+        });
+        if (stopping_) {
+            return;
+        }
+        std::size_t pos = ahead_++;
+        lock.unlock();
+        // opening a cold file may itself block, which is the point of doing
+        // it here rather than in a worker
+        std::uint64_t bytes = mji::xplat::prefetchFile(paths_[order_[pos]].c_str(), share);
+        lock.lock();
+        if (pos >= started_) {
+            outstanding_.emplace_back(pos, bytes);
+            outstandingBytes_ += bytes;
+        }
+        if (ahead_ >= order_.size()) {
+            return;
+        }
+    }
+}
+
+}  // namespace mji::xmph
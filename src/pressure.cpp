@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <optional>
+
+#include <xmphash/pressure.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr unsigned int max_read_shift = 3;
+
+/// What workers currently may do. Effectively unlimited unless a monitor
+/// is running.
+std::atomic<unsigned int> allowedWorkers{~0u};
+std::atomic<unsigned int> readShift{0};
+
+std::mutex gateMutex;
+std::condition_variable gateChanged;
+
+void setAllowedWorkers(unsigned int count) {
+    {
+        std::lock_guard<std::mutex> lock(gateMutex);
+        allowedWorkers.store(count);
+    }
+    gateChanged.notify_all();
+}
+
+/// Fraction of wall time stalled on a resource since the previous sample
+struct StallSampler {
+    const char* resource;
+    std::optional<std::uint64_t> lastTotal;
+
+    double sample(std::chrono::steady_clock::duration elapsed) {
+        auto total = mji::xplat::pressureStallTotal(resource);
+        double fraction = 0.0;
+        auto elapsedMicros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        if (total && lastTotal && elapsedMicros > 0) {
+            fraction = static_cast<double>(*total - *lastTotal) / static_cast<double>(elapsedMicros);
+        }
+        lastTotal = total;
+        return fraction;
+    }
+};
+
+}  // namespace
+
+PressureMonitor::PressureMonitor()
+: options_(),
+  thread_(),
+  mutex_(),
+  stopRequested_(),
+  stopping_(false)
+{}
+
+PressureMonitor::~PressureMonitor() {
+    stop();
+}
+
+bool PressureMonitor::start(const PressureOptions& options) {
+    if (!mji::xplat::pressureStallTotal("io") || !mji::xplat::pressureStallTotal("cpu")) {
+        return false;
+    }
+    stop();
+    options_ = options;
+    options_.maxWorkers = std::max(1u, options_.maxWorkers);
+    stopping_ = false;
+    setAllowedWorkers(options_.maxWorkers);
+    readShift.store(0);
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+void PressureMonitor::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stopRequested_.notify_all();
+    thread_.join();
+    setAllowedWorkers(~0u);
+    readShift.store(0);
+}
+
+void PressureMonitor::run() {
+    StallSampler io{"io", {}};
+    StallSampler cpu{"cpu", {}};
+    auto last = std::chrono::steady_clock::now();
+    io.sample(std::chrono::steady_clock::duration::zero());
+    cpu.sample(std::chrono::steady_clock::duration::zero());
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_.wait_for(lock, options_.interval, [this] { return stopping_; })) {
+        auto now = std::chrono::steady_clock::now();
+        double ioStall = io.sample(now - last);
+        double cpuStall = cpu.sample(now - last);
+        last = now;
+
+        unsigned int workers = allowedWorkers.load();
+        unsigned int shift = readShift.load();
+        double stall = std::max(ioStall, cpuStall);
+        if (stall > options_.threshold) {
+            workers = std::max(1u, workers / 2);
+            shift = std::min(max_read_shift, shift + 1);
+        } else if (stall < options_.threshold / 2) {
+            if (shift > 0) {
+                shift--;
+            } else if (workers < options_.maxWorkers) {
+                workers++;
+            }
+        }
+
+        if (workers != allowedWorkers.load() || shift != readShift.load()) {
+            std::fprintf(stderr, "Pressure: io %.1f%%, cpu %.1f%% stalled; %u workers, reads 1/%u size\n",
+                100.0 * ioStall, 100.0 * cpuStall, workers, 1u << shift);
+            readShift.store(shift);
+            setAllowedWorkers(workers);
+        }
+    }
+}
+
+void waitForWorkerSlot(unsigned int worker) {
+    if (worker < allowedWorkers.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(gateMutex);
+    gateChanged.wait(lock, [worker] { return worker < allowedWorkers.load(); });
+}
+
+std::size_t pressureReadSize(std::size_t maxSize, std::size_t minSize) {
+    return std::max(std::min(minSize, maxSize), maxSize >> readShift.load(std::memory_order_relaxed));
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <xmphash/latency.hpp>
+#include <xmphash/throttle.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct TokenBucket {
+    std::mutex mutex;
+    // checked without the lock, so unthrottled reads never contend
+    std::atomic<bool> enabled{false};
+    double rate = 0.0;
+    double burst = 0.0;
+    /// Negative while in debt
+    double tokens = 0.0;
+    Clock::time_point lastRefill;
+
+    void refill(Clock::time_point now) {
+        std::chrono::duration<double> elapsed = now - lastRefill;
+        tokens = std::min(burst, tokens + elapsed.count() * rate);
+        lastRefill = now;
+    }
+};
+
+TokenBucket bucket;
+
+}  // namespace
+
+void setReadRateLimit(std::uint64_t bytesPerSecond, std::uint64_t burst) {
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    bucket.enabled = bytesPerSecond != 0;
+    bucket.rate = static_cast<double>(bytesPerSecond);
+    bucket.burst = static_cast<double>(std::max<std::uint64_t>(burst, 1));
+    bucket.tokens = bucket.burst;
+    bucket.lastRefill = Clock::now();
+}
+
+void throttleRead(std::uint64_t count) {
+    if (!bucket.enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    double wait;
+    {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        bucket.refill(Clock::now());
+        bucket.tokens -= static_cast<double>(count);
+        if (bucket.tokens >= 0.0) {
+            return;
+        }
+        // everyone after us queues behind this debt as well
+        wait = -bucket.tokens / bucket.rate;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+}
+
+void refundRead(std::uint64_t count) {
+    if (count == 0 || !bucket.enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    bucket.tokens = std::min(bucket.burst, bucket.tokens + static_cast<double>(count));
+}
+
+std::int64_t throttledReadAt(const mji::xplat::InFile& file, void* buf, std::size_t count,
+    std::uint64_t offset)
+{
+    throttleRead(count);
+    std::uint64_t readStart = latencyStart();
+    std::int64_t got = file.readAt(buf, count, offset);
+    recordReadLatency(readStart);
+    refundRead(got < 0 ? count : count - static_cast<std::size_t>(got));
+    return got;
+}
+
+}  // namespace mji::xmph
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <xmphash/engine.hpp>
+#include <xmphash/pressure.hpp>
+#include <xmphash/throttle.hpp>
+#include <xmphash/treediff.hpp>
+#include <xmphash/walk.hpp>
+#include <xmphash/xplat.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr std::size_t diffChunkSize = 1 << 20;
+/// Smallest chunk a memory budget may shrink the reads to
+constexpr std::size_t minDiffChunkSize = 64 << 10;
+
+enum class PairState : unsigned char {
+    ADDED,
+    REMOVED,
+    CHANGED,
+    IDENTICAL,
+    // same size, content not yet compared
+    PENDING,
+    ERROR
+};
+
+struct DiffPair {
+    std::string path;
+    std::uint64_t size;
+    PairState state;
+};
+
+/// Reads both files in lockstep, stopping at the first differing chunk
+PairState compareContent(const std::string& pathA, const std::string& pathB,
+    std::uint64_t size, unsigned char* bufA, unsigned char* bufB, std::size_t chunkSize,
+    std::uint64_t& bytesRead)
+{
+    mji::xplat::InFile fileA;
+    mji::xplat::InFile fileB;
+    if (!fileA.open(pathA.c_str())) {
+        std::fprintf(stderr, "%s: unable to open file\n", pathA.c_str());
+        return PairState::ERROR;
+    }
+    if (!fileB.open(pathB.c_str())) {
+        std::fprintf(stderr, "%s: unable to open file\n", pathB.c_str());
+        return PairState::ERROR;
+    }
+
+    for (std::uint64_t offset = 0; offset < size; ) {
+        auto want = static_cast<std::size_t>(
+            std::min<std::uint64_t>(size - offset, pressureReadSize(chunkSize)));
+        std::int64_t gotA = throttledReadAt(fileA, bufA, want, offset);
+        std::int64_t gotB = throttledReadAt(fileB, bufB, want, offset);
+        if (gotA < 0 || gotB < 0) {
+            std::fprintf(stderr, "%s: read failed\n", (gotA < 0 ? pathA : pathB).c_str());
+            return PairState::ERROR;
+        }
+        bytesRead += static_cast<std::uint64_t>(gotA + gotB);
+        fileA.dropCache(offset, static_cast<std::uint64_t>(gotA));
+        fileB.dropCache(offset, static_cast<std::uint64_t>(gotB));
+        if (gotA != gotB || std::memcmp(bufA, bufB, static_cast<std::size_t>(gotA)) != 0) {
+            return PairState::CHANGED;
+        }
+        if (static_cast<std::size_t>(gotA) < want) {
+            // both shrank identically since the walk
+            break;
+        }
+        offset += want;
+    }
+    return PairState::IDENTICAL;
+}
+
+}  // namespace
+
+bool runTreeDiff(const std::string& oldRoot, const std::string& newRoot,
+    const TreeDiffOptions& options, TreeDiffReport& report)
+{
+    std::vector<WalkEntry> oldFiles;
+    std::vector<WalkEntry> newFiles;
+    bool newOk = false;
+    std::thread newWalker([&] { newOk = walkTree(newRoot, newFiles, options.filter); });
+    bool oldOk = walkTree(oldRoot, oldFiles, options.filter);
+    newWalker.join();
+    if (!oldOk || !newOk) {
+        return false;
+    }
+
+    // merge join of the two sorted listings
+    std::vector<DiffPair> pairs;
+    std::vector<std::size_t> pending;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < oldFiles.size() || j < newFiles.size()) {
+        if (j == newFiles.size() || (i < oldFiles.size() && oldFiles[i].path < newFiles[j].path)) {
+            pairs.push_back({std::move(oldFiles[i].path), 0, PairState::REMOVED});
+            i++;
+        } else if (i == oldFiles.size() || newFiles[j].path < oldFiles[i].path) {
+            pairs.push_back({std::move(newFiles[j].path), 0, PairState::ADDED});
+            j++;
+        } else {
+            if (oldFiles[i].size != newFiles[j].size) {
+                pairs.push_back({std::move(oldFiles[i].path), 0, PairState::CHANGED});
+            } else {
+                pending.push_back(pairs.size());
+                pairs.push_back({std::move(oldFiles[i].path), oldFiles[i].size, PairState::PENDING});
+            }
+            i++;
+            j++;
+        }
+    }
+
+    // each worker holds two chunk buffers; under a memory budget, use fewer
+    // workers and then smaller chunks until they fit
+    unsigned int jobs = std::max(1u, options.jobs);
+    std::size_t chunkSize = diffChunkSize;
+    std::uint64_t bufferBytes = 0;
+    if (options.memoryBudget) {
+        std::uint64_t limit = options.memoryBudget->limit();
+        while (2ull * chunkSize * jobs > limit) {
+            if (jobs > 1) {
+                jobs--;
+            } else if (chunkSize > minDiffChunkSize) {
+                chunkSize /= 2;
+            } else {
+                break;
+            }
+        }
+        bufferBytes = 2ull * chunkSize * jobs;
+        if (!options.memoryBudget->tryAcquire(bufferBytes)) {
+            std::fprintf(stderr, "Comparing needs at least %llu bytes of buffers, more than the %llu byte memory limit\n",
+                static_cast<unsigned long long>(bufferBytes),
+                static_cast<unsigned long long>(limit));
+            return false;
+        }
+    }
+    std::vector<std::unique_ptr<unsigned char[]>> buffers;
+    for (unsigned int w = 0; w < 2 * jobs; w++) {
+        buffers.push_back(std::make_unique<unsigned char[]>(chunkSize));
+    }
+    std::atomic<std::uint64_t> bytesRead{0};
+    runParallel(pending.size(), jobs, [&](std::size_t idx, unsigned int worker) {
+        DiffPair& pair = pairs[pending[idx]];
+        std::uint64_t pairBytes = 0;
+        pair.state = compareContent(
+            joinWalkPath(oldRoot, pair.path), joinWalkPath(newRoot, pair.path), pair.size,
+            buffers[2 * worker].get(), buffers[2 * worker + 1].get(), chunkSize, pairBytes);
+        bytesRead += pairBytes;
+    });
+    report.bytesRead = bytesRead.load();
+    buffers.clear();
+    if (options.memoryBudget) {
+        options.memoryBudget->release(bufferBytes);
+    }
+
+    for (const DiffPair& pair : pairs) {
+        const char* label = nullptr;
+        switch (pair.state) {
+        case PairState::ADDED:
+            label = "added";
+            report.added++;
+            break;
+        case PairState::REMOVED:
+            label = "removed";
+            report.removed++;
+            break;
+        case PairState::CHANGED:
+            label = "changed";
+            report.changed++;
+            break;
+        case PairState::IDENTICAL:
+            report.identical++;
+            break;
+        case PairState::PENDING:
+        case PairState::ERROR:
+            report.errors++;
+            break;
+        }
+        if (label != nullptr) {
+            std::printf("%s: %s\n", label, pair.path.empty() ? "." : pair.path.c_str());
+        }
+    }
+
+    return true;
+}
+
+}  // namespace mji::xmph
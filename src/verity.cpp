@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <xmphash/bufpool.hpp>
+#include <xmphash/engine.hpp>
+#include <xmphash/hasher.hpp>
+#include <xmphash/throttle.hpp>
+#include <xmphash/verity.hpp>
+
+namespace mji::xmph {
+
+namespace {
+
+constexpr std::size_t verity_block_size = 4096;
+constexpr unsigned int verity_log_block_size = 12;
+constexpr std::size_t verity_digest_size = 32;
+constexpr unsigned int verity_sha256 = 1;
+constexpr std::size_t hashes_per_block = verity_block_size / verity_digest_size;
+/// Data whose block hashes fill one block of the first level
+constexpr std::uint64_t run_size = verity_block_size * hashes_per_block;
+constexpr std::size_t descriptor_size = 256;
+
+/// What each thread beyond the first holds: a pool buffer and a hasher
+constexpr std::uint64_t thread_bytes = pool_buffer_size + 1024;
+
+static_assert(run_size <= pool_buffer_size, "a run must fit in a pool buffer");
+
+/// Hashes up to one block, zero padded to a whole block
+bool hashBlock(Hasher& sha256, const unsigned char* data, std::size_t count, unsigned char* out) {
+    static const unsigned char zeros[verity_block_size] = {};
+    return sha256.reset()
+        && sha256.consume(data, count)
+        && (count == verity_block_size || sha256.consume(zeros, verity_block_size - count))
+        && sha256.finalize(out, verity_digest_size);
+}
+
+/// Reads one run of the file and hashes its data blocks, then the block of
+/// their hashes. A file of one block has no tree, so its root hash is the hash
+/// of that block.
+bool hashRun(const mji::xplat::InFile& file, std::uint64_t size, std::uint64_t run,
+    Hasher& sha256, unsigned char* buf, unsigned char* out)
+{
+    std::uint64_t offset = run * run_size;
+    auto length = static_cast<std::size_t>(std::min(run_size, size - offset));
+    if (throttledReadAt(file, buf, length, offset) != static_cast<std::int64_t>(length)) {
+        return false;
+    }
+    unsigned char level[verity_block_size];
+    std::size_t blocks = (length + verity_block_size - 1) / verity_block_size;
+    for (std::size_t b = 0; b < blocks; b++) {
+        std::size_t pos = b * verity_block_size;
+        if (!hashBlock(sha256, buf + pos, std::min(verity_block_size, length - pos),
+            level + b * verity_digest_size))
+        {
+            return false;
+        }
+    }
+    if (size <= verity_block_size) {
+        std::copy(level, level + verity_digest_size, out);
+        return true;
+    }
+    return hashBlock(sha256, level, blocks * verity_digest_size, out);
+}
+
+}  // namespace
+
+std::optional<std::string> computeFsVerityDigest(const mji::xplat::InFile& file,
+    std::uint64_t size, unsigned int threads, MemoryBudget* budget)
+{
+    auto measured = mji::xplat::measureVerity(file);
+    if (measured && measured->hashAlgorithm == verity_sha256
+        && measured->logBlockSize == verity_log_block_size && measured->saltSize == 0
+        && measured->digest.size() == verity_digest_size)
+    {
+        return bytesToStr(measured->digest.data(), measured->digest.size());
+    }
+
+    std::vector<unsigned char> level(verity_digest_size);
+    if (size != 0) {
+        std::uint64_t runs = (size + run_size - 1) / run_size;
+        auto threadCount = static_cast<unsigned int>(
+            std::min<std::uint64_t>(std::max(1u, threads), runs));
+        // the first thread reads into what the caller has already allowed
+        // for; the others only start if their buffers fit in the budget
+        std::uint64_t chargedBytes = 0;
+        if (budget) {
+            for (unsigned int w = 1; w < threadCount; w++) {
+                if (!budget->tryAcquire(thread_bytes)) {
+                    threadCount = w;
+                    break;
+                }
+                chargedBytes += thread_bytes;
+            }
+        }
+        std::vector<std::unique_ptr<Hasher>> hashers;
+        std::vector<PooledBuffer> buffers;
+        for (unsigned int w = 0; w < threadCount; w++) {
+            PooledBuffer buffer = PooledBuffer::acquire();
+            if (buffer.data() == nullptr) {
+                // run with the threads that did get a buffer
+                threadCount = w;
+                break;
+            }
+            hashers.push_back(makeHasher("sha256"));
+            buffers.push_back(std::move(buffer));
+        }
+        if (threadCount == 0) {
+            if (budget) {
+                budget->release(chargedBytes);
+            }
+            return {};
+        }
+
+        level.resize(static_cast<std::size_t>(runs) * verity_digest_size);
+        std::atomic<bool> failed{false};
+        runParallel(static_cast<std::size_t>(runs), threadCount, [&](std::size_t run, unsigned int worker) {
+            if (!failed.load(std::memory_order_relaxed) && !hashRun(file, size, run, *hashers[worker],
+                buffers[worker].data(), level.data() + run * verity_digest_size))
+            {
+                failed.store(true);
+            }
+        });
+        buffers.clear();
+        if (budget) {
+            budget->release(chargedBytes);
+        }
+        if (failed.load()) {
+            return {};
+        }
+
+        // the levels above are small enough to hash on this thread
+        Hasher& sha256 = *hashers[0];
+        while (level.size() > verity_digest_size) {
+            std::size_t blocks = (level.size() + verity_block_size - 1) / verity_block_size;
+            std::vector<unsigned char> next(blocks * verity_digest_size);
+            for (std::size_t b = 0; b < blocks; b++) {
+                std::size_t pos = b * verity_block_size;
+                if (!hashBlock(sha256, level.data() + pos, std::min(verity_block_size, level.size() - pos),
+                    next.data() + b * verity_digest_size))
+                {
+                    return {};
+                }
+            }
+            level.swap(next);
+        }
+    }
+
+    unsigned char descriptor[descriptor_size] = {};
+    descriptor[0] = 1;
+    descriptor[1] = verity_sha256;
+    descriptor[2] = verity_log_block_size;
+    for (int i = 0; i < 8; i++) {
+        descriptor[8 + i] = static_cast<unsigned char>(size >> (8 * i));
+    }
+    std::copy(level.begin(), level.end(), descriptor + 16);
+
+    auto sha256 = makeHasher("sha256");
+    unsigned char digest[verity_digest_size];
+    if (!sha256->consume(descriptor, sizeof(descriptor)) || !sha256->finalize(digest, sizeof(digest))) {
+        return {};
+    }
+    return bytesToStr(digest, sizeof(digest));
+}
+
+}  // namespace mji::xmph
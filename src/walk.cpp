@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+#include <xmphash/walk.hpp>
+
+namespace fs = std::filesystem;
+
+namespace mji::xmph {
+
+namespace {
+
+void walkDir(const fs::path& dir, const std::string& relDir, std::vector<WalkEntry>& out,
+    const PathFilter* filter, PathFilter::Cursor cursor)
+{
+    std::error_code ec;
+    fs::directory_iterator it(dir, ec);
+    if (ec) {
+        std::fprintf(stderr, "%s: unable to read directory: %s\n",
+            dir.string().c_str(), ec.message().c_str());
+        return;
+    }
+
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            std::fprintf(stderr, "%s: error while reading directory: %s\n",
+                dir.string().c_str(), ec.message().c_str());
+            return;
+        }
+
+        const fs::directory_entry& dirEntry = *it;
+        std::string name = dirEntry.path().filename().generic_string();
+        std::string relPath = relDir.empty() ? name : relDir + "/" + name;
+
+        fs::file_status status = dirEntry.symlink_status(ec);
+        if (ec) {
+            std::fprintf(stderr, "%s: unable to stat: %s\n",
+                dirEntry.path().string().c_str(), ec.message().c_str());
+            continue;
+        }
+
+        PathFilter::Cursor entryCursor = cursor;
+        if (filter != nullptr && (fs::is_directory(status) || fs::is_regular_file(status))) {
+            entryCursor = filter->child(cursor, name);
+        }
+        if (fs::is_directory(status)) {
+            if (filter == nullptr || !filter->prunesDir(entryCursor)) {
+                walkDir(dirEntry.path(), relPath, out, filter, entryCursor);
+            }
+        } else if (fs::is_regular_file(status)) {
+            std::uintmax_t size = dirEntry.file_size(ec);
+            if (ec) {
+                std::fprintf(stderr, "%s: unable to stat: %s\n",
+                    dirEntry.path().string().c_str(), ec.message().c_str());
+                continue;
+            }
+            if (filter != nullptr && !filter->keepsFile(entryCursor, size)) {
+                continue;
+            }
+            out.push_back({std::move(relPath), static_cast<std::uint64_t>(size)});
+        }
+    }
+}
+
+}  // namespace
+
+bool walkTree(const std::string& root, std::vector<WalkEntry>& out, const PathFilter* filter) {
+    std::error_code ec;
+    fs::file_status status = fs::status(root, ec);
+    if (ec) {
+        std::fprintf(stderr, "%s: %s\n", root.c_str(), ec.message().c_str());
+        return false;
+    }
+
+    if (fs::is_regular_file(status)) {
+        std::uintmax_t size = fs::file_size(root, ec);
+        if (ec) {
+            std::fprintf(stderr, "%s: %s\n", root.c_str(), ec.message().c_str());
+            return false;
+        }
+        out.push_back({"", static_cast<std::uint64_t>(size)});
+        return true;
+    } else if (!fs::is_directory(status)) {
+        std::fprintf(stderr, "%s: not a regular file or directory\n", root.c_str());
+        return false;
+    }
+
+    std::size_t first = out.size();
+    if (filter != nullptr && filter->empty()) {
+        filter = nullptr;
+    }
+    walkDir(root, "", out, filter, filter != nullptr ? filter->root() : PathFilter::Cursor{});
+    std::sort(out.begin() + first, out.end(),
+        [](const WalkEntry& a, const WalkEntry& b) { return a.path < b.path; });
+    return true;
+}
+
+std::string joinWalkPath(const std::string& root, const std::string& relPath) {
+    if (relPath.empty()) {
+        return root;
+    } else if (!root.empty() && root.back() == '/') {
+        return root + relPath;
+    } else {
+        return root + "/" + relPath;
+    }
+}
+
+}  // namespace mji::xmph
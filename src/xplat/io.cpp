@@ -1,5 +1,24 @@
 #include <xmphash/xplat.hpp>
 
+#include <algorithm>
+#include <utility>
+
+namespace mji::xplat {
+
+namespace {
+
+// set before any input is opened, so it needs no synchronization
+bool lowImpactIo = false;
+
+}
+
+void setLowImpactIo(bool enabled)
+{
+    lowImpactIo = enabled;
+}
+
+}
+
 #ifdef _WIN32
 ///////////////////////////////////////////////////////////////////////////////
 // Windows
@@ -12,6 +31,7 @@
 
 #include <fcntl.h>
 #include <io.h>
+#include <windows.h>
 
 namespace mji::xplat {
 
@@ -25,6 +45,206 @@ bool reopenStdinAsBinary()
     return _setmode(fno, _O_BINARY) != -1;
 }
 
+bool syncFile(std::FILE* fp)
+{
+    return std::fflush(fp) == 0 && _commit(_fileno(fp)) == 0;
+}
+
+std::FILE* openInputStream(const char* path, bool binaryMode)
+{
+    return std::fopen(path, binaryMode ? "rb" : "r");
+}
+
+std::optional<double> cachedFraction(const char*)
+{
+    return {};
+}
+
+std::optional<std::uint64_t> kernelHashFile(const InFile&, const std::vector<std::string>&,
+    std::vector<std::vector<unsigned char>>&, const std::function<void(std::size_t)>&,
+    const std::function<void(std::uint64_t, std::uint64_t)>&)
+{
+    return {};
+}
+
+bool kernelHashSupported(const std::string&)
+{
+    return false;
+}
+
+std::optional<FileLayout> sharedLayout(const char*, std::size_t)
+{
+    return {};
+}
+
+std::uint64_t prefetchFile(const char*, std::uint64_t)
+{
+    // there is no asynchronous equivalent for ordinary file handles
+    return 0;
+}
+
+void dropCache(std::FILE*, std::uint64_t, std::uint64_t)
+{
+    // there is no per-range equivalent; FILE_FLAG_NO_BUFFERING would need
+    // sector-aligned reads
+}
+
+bool seekFile(std::FILE* fp, std::uint64_t offset)
+{
+    return _fseeki64(fp, static_cast<__int64>(offset), SEEK_SET) == 0;
+}
+
+std::optional<VerityMeasurement> measureVerity(const InFile&)
+{
+    return {};
+}
+
+InFile::InFile()
+: handle_(INVALID_HANDLE_VALUE)
+{}
+
+InFile::~InFile()
+{
+    close();
+}
+
+InFile::InFile(InFile&& other)
+: handle_(INVALID_HANDLE_VALUE)
+{
+    std::swap(handle_, other.handle_);
+}
+
+InFile& InFile::operator=(InFile&& other)
+{
+    std::swap(handle_, other.handle_);
+    return *this;
+}
+
+bool InFile::open(const char* path)
+{
+    close();
+    handle_ = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return handle_ != INVALID_HANDLE_VALUE;
+}
+
+bool InFile::isOpen() const
+{
+    return handle_ != INVALID_HANDLE_VALUE;
+}
+
+void InFile::close()
+{
+    if (handle_ != INVALID_HANDLE_VALUE) {
+        ::CloseHandle(handle_);
+        handle_ = INVALID_HANDLE_VALUE;
+    }
+}
+
+void* InFile::nativeHandle() const
+{
+    return handle_;
+}
+
+void InFile::dropCache(std::uint64_t, std::uint64_t) const
+{}
+
+std::optional<std::uint64_t> InFile::size() const
+{
+    LARGE_INTEGER sz;
+    if (!::GetFileSizeEx(handle_, &sz)) {
+        return {};
+    }
+    return static_cast<std::uint64_t>(sz.QuadPart);
+}
+
+std::int64_t InFile::readAt(void* buf, std::size_t count, std::uint64_t offset) const
+{
+    auto ucbuf = static_cast<unsigned char*>(buf);
+    std::size_t total = 0;
+    while (total < count) {
+        OVERLAPPED ov = {};
+        std::uint64_t pos = offset + total;
+        ov.Offset = static_cast<DWORD>(pos & 0xffffffffu);
+        ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+        DWORD want = static_cast<DWORD>(std::min<std::size_t>(count - total, 1u << 30));
+        DWORD got = 0;
+        if (!::ReadFile(handle_, ucbuf + total, want, &got, &ov)) {
+            if (::GetLastError() == ERROR_HANDLE_EOF) {
+                break;
+            }
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        total += got;
+    }
+    return static_cast<std::int64_t>(total);
+}
+
+MappedFile::MappedFile()
+: data_(nullptr),
+  size_(0)
+{}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path)
+{
+    close();
+    HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER sz;
+    if (!::GetFileSizeEx(file, &sz)) {
+        ::CloseHandle(file);
+        return false;
+    }
+    if (sz.QuadPart == 0) {
+        ::CloseHandle(file);
+        return true;
+    }
+    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+    void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    // the view keeps the mapping alive
+    ::CloseHandle(mapping);
+    if (view == nullptr) {
+        return false;
+    }
+    data_ = static_cast<const char*>(view);
+    size_ = static_cast<std::size_t>(sz.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_ != nullptr) {
+        ::UnmapViewOfFile(data_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+const char* MappedFile::data() const
+{
+    return data_;
+}
+
+std::size_t MappedFile::size() const
+{
+    return size_;
+}
+
 }
 
 #else
@@ -32,7 +252,23 @@ bool reopenStdinAsBinary()
 // Linux
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <atomic>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <linux/fsverity.h>
+#include <linux/if_alg.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace mji::xplat {
 
@@ -41,6 +277,544 @@ bool reopenStdinAsBinary()
     return std::freopen(nullptr, "rb", stdin) != nullptr;
 }
 
+bool syncFile(std::FILE* fp)
+{
+    return std::fflush(fp) == 0 && ::fsync(::fileno(fp)) == 0;
+}
+
+namespace {
+
+int openInput(const char* path)
+{
+    int flags = O_RDONLY | O_CLOEXEC;
+    if (lowImpactIo) {
+        flags |= O_NOATIME;
+    }
+    for (;;) {
+        int fd = ::open(path, flags);
+        if (fd != -1) {
+            return fd;
+        } else if (errno == EPERM && (flags & O_NOATIME)) {
+            // only the owner (or CAP_FOWNER) may use O_NOATIME
+            flags &= ~O_NOATIME;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+// cachestat(2) arrived in Linux 6.5, after the headers we may build against
+#ifdef __NR_cachestat
+constexpr long sys_cachestat = __NR_cachestat;
+#else
+constexpr long sys_cachestat = 451;
+#endif
+
+struct CachestatRange {
+    std::uint64_t offset;
+    std::uint64_t length;
+};
+
+struct Cachestat {
+    std::uint64_t nrCache;
+    std::uint64_t nrDirty;
+    std::uint64_t nrWriteback;
+    std::uint64_t nrEvicted;
+    std::uint64_t nrRecentlyEvicted;
+};
+
+/// Cleared the first time the kernel turns out not to have cachestat
+std::atomic<bool> haveCachestat{true};
+
+/// Counts the resident pages of a file by mapping it a window at a time
+std::optional<std::uint64_t> mincorePages(int fd, std::uint64_t size, std::uint64_t pageSize)
+{
+    constexpr std::uint64_t window = 64 << 20;
+    std::vector<unsigned char> vec;
+    std::uint64_t resident = 0;
+    for (std::uint64_t offset = 0; offset < size; offset += window) {
+        std::size_t length = static_cast<std::size_t>(std::min(window, size - offset));
+        void* p = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(offset));
+        if (p == MAP_FAILED) {
+            return {};
+        }
+        vec.resize((length + pageSize - 1) / pageSize);
+        bool ok = ::mincore(p, length, vec.data()) == 0;
+        ::munmap(p, length);
+        if (!ok) {
+            return {};
+        }
+        for (unsigned char page : vec) {
+            resident += page & 1;
+        }
+    }
+    return resident;
+}
+
+void adviseDontNeed(int fd, std::uint64_t offset, std::uint64_t length)
+{
+    if (lowImpactIo && fd != -1 && length != 0) {
+        ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+            POSIX_FADV_DONTNEED);
+    }
+}
+
+}
+
+std::FILE* openInputStream(const char* path, bool)
+{
+    // text and binary mode are the same here
+    int fd = openInput(path);
+    if (fd == -1) {
+        return nullptr;
+    }
+    std::FILE* fp = ::fdopen(fd, "rb");
+    if (fp == nullptr) {
+        int savedErrno = errno;
+        ::close(fd);
+        errno = savedErrno;
+    }
+    return fp;
+}
+
+std::uint64_t prefetchFile(const char* path, std::uint64_t maxLength)
+{
+    int fd = openInput(path);
+    if (fd == -1) {
+        return 0;
+    }
+    struct stat st;
+    std::uint64_t length = 0;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        length = std::min<std::uint64_t>(static_cast<std::uint64_t>(st.st_size), maxLength);
+        // starts asynchronous readahead; the pages stay cached after closing
+        if (length != 0 && ::posix_fadvise(fd, 0, static_cast<off_t>(length), POSIX_FADV_WILLNEED) != 0) {
+            length = 0;
+        }
+    }
+    ::close(fd);
+    return length;
+}
+
+std::optional<VerityMeasurement> measureVerity(const InFile& file)
+{
+    int fd = file.nativeHandle();
+    std::uint64_t storage[(sizeof(struct fsverity_digest) + 64 + 7) / 8] = {};
+    auto* digest = reinterpret_cast<struct fsverity_digest*>(storage);
+    digest->digest_size = 64;
+    if (::ioctl(fd, FS_IOC_MEASURE_VERITY, digest) != 0) {
+        // ENODATA: verity is not enabled; ENOTTY or EOPNOTSUPP: unsupported
+        return {};
+    }
+
+    // the descriptor starts with version, hash algorithm, log2 of the block
+    // size and salt size, one byte each
+    unsigned char descriptor[256];
+    struct fsverity_read_metadata_arg arg = {};
+    arg.metadata_type = FS_VERITY_METADATA_TYPE_DESCRIPTOR;
+    arg.length = sizeof(descriptor);
+    arg.buf_ptr = reinterpret_cast<std::uintptr_t>(descriptor);
+    if (::ioctl(fd, FS_IOC_READ_VERITY_METADATA, &arg) < 4) {
+        return {};
+    }
+
+    VerityMeasurement measurement;
+    measurement.hashAlgorithm = descriptor[1];
+    measurement.logBlockSize = descriptor[2];
+    measurement.saltSize = descriptor[3];
+    measurement.digest.assign(digest->digest,
+        digest->digest + std::min<unsigned int>(digest->digest_size, 64));
+    return measurement;
+}
+
+namespace {
+
+constexpr int kernel_hash_pipe_size = 1 << 20;
+
+/// Closes a descriptor when it goes out of scope
+struct ScopedFd {
+    int fd = -1;
+
+    ScopedFd() = default;
+    ScopedFd(const ScopedFd&) = delete;
+    ScopedFd& operator=(const ScopedFd&) = delete;
+    ScopedFd(ScopedFd&& other)
+    : fd(other.fd)
+    {
+        other.fd = -1;
+    }
+
+    ~ScopedFd() {
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+};
+
+/// One algorithm's hash socket, and the pipe that feeds it
+struct KernelHashSink {
+    ScopedFd op;
+    ScopedFd pipeRead;
+    ScopedFd pipeWrite;
+};
+
+bool openKernelHash(const std::string& name, KernelHashSink& sink)
+{
+    struct sockaddr_alg sa = {};
+    sa.salg_family = AF_ALG;
+    std::strncpy(reinterpret_cast<char*>(sa.salg_type), "hash", sizeof(sa.salg_type) - 1);
+    if (name.size() >= sizeof(sa.salg_name)) {
+        return false;
+    }
+    std::strncpy(reinterpret_cast<char*>(sa.salg_name), name.c_str(), sizeof(sa.salg_name) - 1);
+
+    ScopedFd tfm;
+    tfm.fd = ::socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (tfm.fd == -1 || ::bind(tfm.fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) != 0) {
+        return false;
+    }
+    sink.op.fd = ::accept4(tfm.fd, nullptr, nullptr, SOCK_CLOEXEC);
+    int fds[2];
+    if (sink.op.fd == -1 || ::pipe2(fds, O_CLOEXEC) != 0) {
+        return false;
+    }
+    sink.pipeRead.fd = fds[0];
+    sink.pipeWrite.fd = fds[1];
+    // a bigger pipe means fewer system calls; the default is 64 KiB
+    ::fcntl(sink.pipeWrite.fd, F_SETPIPE_SZ, kernel_hash_pipe_size);
+    return true;
+}
+
+/// Moves exactly count bytes from a pipe into a socket
+bool spliceAll(int from, int to, std::size_t count)
+{
+    while (count != 0) {
+        ssize_t moved = ::splice(from, nullptr, to, nullptr, count, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved <= 0) {
+            if (moved == -1 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        count -= static_cast<std::size_t>(moved);
+    }
+    return true;
+}
+
+}
+
+std::optional<std::uint64_t> kernelHashFile(const InFile& file,
+    const std::vector<std::string>& kernelNames,
+    std::vector<std::vector<unsigned char>>& digests,
+    const std::function<void(std::size_t)>& beforeChunk,
+    const std::function<void(std::uint64_t, std::uint64_t)>& onChunk)
+{
+    if (kernelNames.empty()) {
+        return {};
+    }
+    std::vector<KernelHashSink> sinks(kernelNames.size());
+    for (std::size_t i = 0; i < kernelNames.size(); i++) {
+        if (!openKernelHash(kernelNames[i], sinks[i])) {
+            return {};
+        }
+    }
+    // the pipes may have been given different sizes
+    int pipeSize = ::fcntl(sinks[0].pipeWrite.fd, F_GETPIPE_SZ);
+    for (const auto& sink : sinks) {
+        pipeSize = std::min(pipeSize, ::fcntl(sink.pipeWrite.fd, F_GETPIPE_SZ));
+    }
+    if (pipeSize <= 0) {
+        return {};
+    }
+
+    int fd = file.nativeHandle();
+    loff_t offset = 0;
+    for (;;) {
+        std::uint64_t chunkStart = static_cast<std::uint64_t>(offset);
+        beforeChunk(static_cast<std::size_t>(pipeSize));
+        ssize_t got = ::splice(fd, &offset, sinks[0].pipeWrite.fd, nullptr,
+            static_cast<std::size_t>(pipeSize), SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (got == -1 && errno == EINTR) {
+            continue;
+        } else if (got == -1) {
+            return {};
+        } else if (got == 0) {
+            break;
+        }
+        auto count = static_cast<std::size_t>(got);
+        // tee duplicates the pipe's pages without consuming them, so it
+        // cannot resume part way; the other pipes are empty and at least as
+        // large, so it copies the whole chunk at once
+        for (std::size_t i = 1; i < sinks.size(); i++) {
+            ssize_t teed;
+            do {
+                teed = ::tee(sinks[0].pipeRead.fd, sinks[i].pipeWrite.fd, count, 0);
+            } while (teed == -1 && errno == EINTR);
+            if (teed != got) {
+                return {};
+            }
+        }
+        for (const auto& sink : sinks) {
+            if (!spliceAll(sink.pipeRead.fd, sink.op.fd, count)) {
+                return {};
+            }
+        }
+        onChunk(chunkStart, count);
+    }
+
+    // reading finalizes the hash
+    digests.assign(sinks.size(), {});
+    for (std::size_t i = 0; i < sinks.size(); i++) {
+        unsigned char buf[64];
+        ssize_t n = ::read(sinks[i].op.fd, buf, sizeof(buf));
+        if (n <= 0) {
+            return {};
+        }
+        digests[i].assign(buf, buf + n);
+    }
+    return static_cast<std::uint64_t>(offset);
+}
+
+bool kernelHashSupported(const std::string& kernelName)
+{
+    KernelHashSink sink;
+    return openKernelHash(kernelName, sink);
+}
+
+std::optional<FileLayout> sharedLayout(const char* path, std::size_t maxExtents)
+{
+    // an encoded (compressed) extent reports the same address for every
+    // offset within it, and an unwritten one has no data to identify
+    constexpr std::uint32_t unstable = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC
+        | FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED
+        | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL | FIEMAP_EXTENT_UNWRITTEN;
+
+    int fd = openInput(path);
+    if (fd == -1) {
+        return {};
+    }
+    FileLayout layout;
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+    if (ok) {
+        layout.device = static_cast<std::uint64_t>(st.st_dev);
+        layout.size = static_cast<std::uint64_t>(st.st_size);
+        // one call to count the extents, one to fetch them
+        std::vector<std::uint64_t> storage(
+            (sizeof(struct fiemap) + maxExtents * sizeof(struct fiemap_extent) + 7) / 8);
+        auto* fm = reinterpret_cast<struct fiemap*>(storage.data());
+        fm->fm_start = 0;
+        fm->fm_length = FIEMAP_MAX_OFFSET;
+        fm->fm_flags = FIEMAP_FLAG_SYNC;
+        fm->fm_extent_count = 0;
+        ok = ::ioctl(fd, FS_IOC_FIEMAP, fm) == 0 && fm->fm_mapped_extents != 0
+            && fm->fm_mapped_extents <= maxExtents;
+        if (ok) {
+            fm->fm_extent_count = fm->fm_mapped_extents;
+            fm->fm_mapped_extents = 0;
+            ok = ::ioctl(fd, FS_IOC_FIEMAP, fm) == 0;
+        }
+        for (std::uint32_t i = 0; ok && i < fm->fm_mapped_extents; i++) {
+            const struct fiemap_extent& fe = fm->fm_extents[i];
+            ok = (fe.fe_flags & FIEMAP_EXTENT_SHARED) && !(fe.fe_flags & unstable);
+            layout.extents.push_back({fe.fe_logical, fe.fe_physical, fe.fe_length});
+        }
+        // the extents fetched must reach the end of the file
+        ok = ok && !layout.extents.empty()
+            && (fm->fm_extents[fm->fm_mapped_extents - 1].fe_flags & FIEMAP_EXTENT_LAST);
+    }
+    ::close(fd);
+    if (!ok) {
+        return {};
+    }
+    return layout;
+}
+
+std::optional<double> cachedFraction(const char* path)
+{
+    int fd = openInput(path);
+    if (fd == -1) {
+        return {};
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return {};
+    }
+    auto size = static_cast<std::uint64_t>(st.st_size);
+    auto pageSize = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+    std::uint64_t pages = (size + pageSize - 1) / pageSize;
+    if (pages == 0) {
+        ::close(fd);
+        return 1.0;
+    }
+
+    std::optional<std::uint64_t> resident;
+    if (haveCachestat.load(std::memory_order_relaxed)) {
+        // a length of 0 means to the end of the file
+        CachestatRange range{0, 0};
+        Cachestat cs{};
+        if (::syscall(sys_cachestat, fd, &range, &cs, 0) == 0) {
+            resident = cs.nrCache;
+        } else if (errno == ENOSYS) {
+            haveCachestat.store(false, std::memory_order_relaxed);
+        }
+    }
+    if (!resident) {
+        resident = mincorePages(fd, size, pageSize);
+    }
+    ::close(fd);
+    if (!resident) {
+        return {};
+    }
+    return std::min(1.0, static_cast<double>(*resident) / static_cast<double>(pages));
+}
+
+void dropCache(std::FILE* fp, std::uint64_t offset, std::uint64_t length)
+{
+    adviseDontNeed(::fileno(fp), offset, length);
+}
+
+bool seekFile(std::FILE* fp, std::uint64_t offset)
+{
+    return ::fseeko(fp, static_cast<off_t>(offset), SEEK_SET) == 0;
+}
+
+InFile::InFile()
+: fd_(-1)
+{}
+
+InFile::~InFile()
+{
+    close();
+}
+
+InFile::InFile(InFile&& other)
+: fd_(-1)
+{
+    std::swap(fd_, other.fd_);
+}
+
+InFile& InFile::operator=(InFile&& other)
+{
+    std::swap(fd_, other.fd_);
+    return *this;
+}
+
+bool InFile::open(const char* path)
+{
+    close();
+    fd_ = openInput(path);
+    return fd_ != -1;
+}
+
+bool InFile::isOpen() const
+{
+    return fd_ != -1;
+}
+
+void InFile::close()
+{
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+int InFile::nativeHandle() const
+{
+    return fd_;
+}
+
+void InFile::dropCache(std::uint64_t offset, std::uint64_t length) const
+{
+    adviseDontNeed(fd_, offset, length);
+}
+
+std::optional<std::uint64_t> InFile::size() const
+{
+    struct ::stat st;
+    if (::fstat(fd_, &st) != 0) {
+        return {};
+    }
+    return static_cast<std::uint64_t>(st.st_size);
+}
+
+std::int64_t InFile::readAt(void* buf, std::size_t count, std::uint64_t offset) const
+{
+    auto ucbuf = static_cast<unsigned char*>(buf);
+    std::size_t total = 0;
+    while (total < count) {
+        ::ssize_t got = ::pread(fd_, ucbuf + total, count - total,
+            static_cast<::off_t>(offset + total));
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        total += static_cast<std::size_t>(got);
+    }
+    return static_cast<std::int64_t>(total);
+}
+
+MappedFile::MappedFile()
+: data_(nullptr),
+  size_(0)
+{}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path)
+{
+    close();
+    InFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    auto sz = file.size();
+    if (!sz) {
+        return false;
+    }
+    if (*sz == 0) {
+        return true;
+    }
+    void* addr = ::mmap(nullptr, static_cast<std::size_t>(*sz), PROT_READ, MAP_PRIVATE,
+        file.nativeHandle(), 0);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    ::madvise(addr, static_cast<std::size_t>(*sz), MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(addr);
+    size_ = static_cast<std::size_t>(*sz);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+const char* MappedFile::data() const
+{
+    return data_;
+}
+
+std::size_t MappedFile::size() const
+{
+    return size_;
+}
+
 }
 
 #endif
@@ -0,0 +1,273 @@
+#include <xmphash/xplat.hpp>
+
+#ifdef _WIN32
+///////////////////////////////////////////////////////////////////////////////
+// Windows
+///////////////////////////////////////////////////////////////////////////////
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+
+#include <cerrno>
+#include <cstdio>
+#include <malloc.h>
+
+#include <windows.h>
+
+namespace mji::xplat {
+
+void* allocateLargePages(std::size_t size)
+{
+    // large pages need SeLockMemoryPrivilege, which is rarely granted, so
+    // settle for the alignment
+    size = (size + large_page_size - 1) / large_page_size * large_page_size;
+    return ::_aligned_malloc(size, large_page_size);
+}
+
+void freeLargePages(void* p, std::size_t)
+{
+    ::_aligned_free(p);
+}
+
+bool lowerProcessPriority()
+{
+    // background mode lowers CPU, I/O and memory priority together
+    if (!::SetPriorityClass(::GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN)) {
+        std::fprintf(stderr, "Unable to enter background processing mode\n");
+        return false;
+    }
+    return true;
+}
+
+std::optional<std::uint64_t> pressureStallTotal(const char*)
+{
+    return {};
+}
+
+PerfCounters::PerfCounters()
+: fds_{-1, -1, -1, -1},
+  order_(),
+  opened_(0)
+{}
+
+PerfCounters::~PerfCounters() = default;
+
+bool PerfCounters::open()
+{
+    errno = ENOSYS;
+    return false;
+}
+
+bool PerfCounters::counts(PerfEvent) const
+{
+    return false;
+}
+
+bool PerfCounters::read(std::uint64_t (&)[perf_event_count]) const
+{
+    return false;
+}
+
+}
+
+#else
+///////////////////////////////////////////////////////////////////////////////
+// Linux
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <linux/ioprio.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace mji::xplat {
+
+void* allocateLargePages(std::size_t size)
+{
+    size = (size + large_page_size - 1) / large_page_size * large_page_size;
+    // hugetlbfs pages are naturally aligned, but usually none are reserved
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        return p;
+    }
+
+    // over-allocate and trim to alignment, then ask for transparent huge pages
+    std::size_t span = size + large_page_size;
+    p = ::mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+    auto base = reinterpret_cast<std::uintptr_t>(p);
+    std::uintptr_t aligned = (base + large_page_size - 1) & ~(std::uintptr_t(large_page_size) - 1);
+    if (aligned != base) {
+        ::munmap(p, aligned - base);
+    }
+    std::size_t tail = base + span - (aligned + size);
+    if (tail != 0) {
+        ::munmap(reinterpret_cast<void*>(aligned + size), tail);
+    }
+    // failure only means small pages
+    ::madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+    return reinterpret_cast<void*>(aligned);
+}
+
+void freeLargePages(void* p, std::size_t size)
+{
+    if (p != nullptr) {
+        size = (size + large_page_size - 1) / large_page_size * large_page_size;
+        ::munmap(p, size);
+    }
+}
+
+bool lowerProcessPriority()
+{
+    bool ok = true;
+    // applies to the calling thread, and is inherited by threads it creates
+    if (::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+        IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)) == -1)
+    {
+        std::fprintf(stderr, "Unable to set idle I/O priority: %s\n", std::strerror(errno));
+        ok = false;
+    }
+    ::sched_param param{};
+    if (::sched_setscheduler(0, SCHED_IDLE, &param) == -1) {
+        std::fprintf(stderr, "Unable to set idle scheduling policy: %s\n", std::strerror(errno));
+        ok = false;
+    }
+    // still lowers priority if SCHED_IDLE was refused
+    errno = 0;
+    if (::setpriority(PRIO_PROCESS, 0, 19) == -1 && errno != 0) {
+        std::fprintf(stderr, "Unable to lower CPU priority: %s\n", std::strerror(errno));
+        ok = false;
+    }
+    return ok;
+}
+
+std::optional<std::uint64_t> pressureStallTotal(const char* resource)
+{
+    std::string path = std::string("/proc/pressure/") + resource;
+    std::FILE* fp = std::fopen(path.c_str(), "r");
+    if (fp == nullptr) {
+        return {};
+    }
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=12345
+    char line[256];
+    std::optional<std::uint64_t> total;
+    while (std::fgets(line, sizeof(line), fp) != nullptr) {
+        unsigned long long value = 0;
+        const char* field = std::strstr(line, "total=");
+        if (std::strncmp(line, "some ", 5) == 0 && field != nullptr
+            && std::sscanf(field, "total=%llu", &value) == 1)
+        {
+            total = value;
+            break;
+        }
+    }
+    std::fclose(fp);
+    return total;
+}
+
+// PerfCounters
+
+namespace {
+
+int openPerfEvent(std::uint64_t config, int groupFd)
+{
+    ::perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // counting user space only is permitted at perf_event_paranoid 2, the
+    // usual default, and is where the hashing happens anyway
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, groupFd,
+        PERF_FLAG_FD_CLOEXEC));
+}
+
+}
+
+PerfCounters::PerfCounters()
+: fds_{-1, -1, -1, -1},
+  order_(),
+  opened_(0)
+{}
+
+PerfCounters::~PerfCounters()
+{
+    // members first, then the leader
+    for (std::size_t i = perf_event_count; i-- > 0;) {
+        if (fds_[i] != -1) {
+            ::close(fds_[i]);
+        }
+    }
+}
+
+bool PerfCounters::open()
+{
+    static constexpr std::uint64_t configs[perf_event_count] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    if (opened_ != 0) {
+        return true;
+    }
+    fds_[0] = openPerfEvent(configs[0], -1);
+    if (fds_[0] == -1) {
+        return false;
+    }
+    order_[opened_++] = PerfEvent::cycles;
+    for (std::size_t i = 1; i < perf_event_count; i++) {
+        fds_[i] = openPerfEvent(configs[i], fds_[0]);
+        if (fds_[i] != -1) {
+            order_[opened_++] = static_cast<PerfEvent>(i);
+        }
+    }
+    return true;
+}
+
+bool PerfCounters::counts(PerfEvent event) const
+{
+    return fds_[static_cast<std::size_t>(event)] != -1;
+}
+
+bool PerfCounters::read(std::uint64_t (&values)[perf_event_count]) const
+{
+    // nr, time enabled, time running, then a value per event
+    std::uint64_t buf[3 + perf_event_count];
+    for (auto& value : values) {
+        value = 0;
+    }
+    if (opened_ == 0) {
+        return false;
+    }
+    auto want = static_cast<::ssize_t>((3 + opened_) * sizeof(std::uint64_t));
+    if (::read(fds_[0], buf, sizeof(buf)) != want || buf[0] != opened_) {
+        return false;
+    }
+    std::uint64_t enabled = buf[1];
+    std::uint64_t running = buf[2];
+    for (std::size_t i = 0; i < opened_; i++) {
+        std::uint64_t value = buf[3 + i];
+        if (running != 0 && running < enabled) {
+            value = static_cast<std::uint64_t>(
+                static_cast<double>(value) * static_cast<double>(enabled) / static_cast<double>(running));
+        }
+        values[static_cast<std::size_t>(order_[i])] = value;
+    }
+    return true;
+}
+
+}
+
+#endif
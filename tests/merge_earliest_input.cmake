@@ -0,0 +1,25 @@
+# --merge keeps the record from the earliest input when a path is in several
+# inputs, even if a later input's record sorts first.
+# Run with -DXMPHASH=<path to xmphash> -DWORK_DIR=<scratch directory>
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+file(WRITE "${WORK_DIR}/m1" "size=1,sha256=ff p\n")
+file(WRITE "${WORK_DIR}/m2" "size=1,sha256=00 p\nsize=1,sha256=11 q\n")
+
+execute_process(
+    COMMAND "${XMPHASH}" --merge "${WORK_DIR}/m1" "${WORK_DIR}/m2"
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "xmphash --merge failed (${result}): ${errors}")
+endif()
+
+set(expected "size=1,sha256=ff p\nsize=1,sha256=11 q\n")
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "expected:\n${expected}got:\n${output}")
+endif()
+if(NOT errors MATCHES "p: conflicting record in \"[^\"]*m2\" ignored")
+    message(FATAL_ERROR "expected a conflict warning naming m2, got:\n${errors}")
+endif()